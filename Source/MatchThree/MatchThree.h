@@ -2,6 +2,4 @@
 
 #pragma once
 
-#include "CoreMinimal.h"
-
-#define ECC_Gem ECollisionChannel::ECC_GameTraceChannel1
\ No newline at end of file
+#include "CoreMinimal.h"
\ No newline at end of file
@@ -0,0 +1,247 @@
+// Copyright Peter Carsten Collins (2024)
+
+
+#include "Analytics/MoveAnalytics.h"
+
+#include "Board/Match.h"
+#include "HAL/Event.h"
+#include "HAL/PlatformFileManager.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/DateTime.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace
+{
+	constexpr uint32 AnalyticsFileMagic = 0x4E41334D; // "M3AN"
+
+	// Bumped whenever the record layout changes
+	constexpr uint32 AnalyticsFileVersion = 1;
+
+	constexpr int64 MaxFileBytes = 1024 * 1024;
+	constexpr uint32 FlushIntervalMs = 500;
+}
+
+void FMoveRecord::AddShape(EMatchShape Shape)
+{
+	if (NumShapes < MaxShapes)
+	{
+		Shapes[NumShapes++] = Shape;
+	}
+}
+
+EMatchShape FMoveRecord::GetShape(const FMatch& Match)
+{
+	const TConstArrayView<FBoardLocation> Locations = Match.GetLocations();
+	FBoardLocation Min = Locations.IsEmpty() ? FBoardLocation() : Locations[0];
+	FBoardLocation Max = Min;
+	for (const FBoardLocation& Location : Locations)
+	{
+		Min.X = FMath::Min(Min.X, Location.X);
+		Min.Y = FMath::Min(Min.Y, Location.Y);
+		Max.X = FMath::Max(Max.X, Location.X);
+		Max.Y = FMath::Max(Max.Y, Location.Y);
+	}
+
+	if (Max.X > Min.X && Max.Y > Min.Y)
+	{
+		return EMatchShape::Cross;
+	}
+	if (Locations.Num() >= 5)
+	{
+		return EMatchShape::Line5;
+	}
+	return Locations.Num() == 4 ? EMatchShape::Line4 : EMatchShape::Line3;
+}
+
+FMoveAnalyticsWriter::FMoveAnalyticsWriter()
+{
+	WakeEvent = FPlatformProcess::GetSynchEventFromPool();
+}
+
+FMoveAnalyticsWriter::~FMoveAnalyticsWriter()
+{
+	Shutdown();
+	FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+}
+
+void FMoveAnalyticsWriter::Start(int64 InMaxTotalBytes)
+{
+	if (!Thread)
+	{
+		// Always room for the file being written
+		MaxTotalBytes = FMath::Max(InMaxTotalBytes, MaxFileBytes);
+		bStopping = false;
+		Thread = FRunnableThread::Create(this, TEXT("MatchThreeAnalytics"), 0, TPri_BelowNormal);
+	}
+}
+
+void FMoveAnalyticsWriter::Shutdown()
+{
+	if (Thread)
+	{
+		Stop();
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+}
+
+void FMoveAnalyticsWriter::Emit(const FMoveRecord& Record)
+{
+	const uint32 Write = WriteIndex.load(std::memory_order_relaxed);
+	const uint32 Read = ReadIndex.load(std::memory_order_acquire);
+	if (Write - Read >= Capacity)
+	{
+		NumDropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	Slots[Write & Mask] = Record;
+	WriteIndex.store(Write + 1, std::memory_order_release);
+}
+
+uint32 FMoveAnalyticsWriter::Run()
+{
+	while (!bStopping)
+	{
+		WakeEvent->Wait(FlushIntervalMs);
+		Flush();
+	}
+
+	// Pick up anything emitted while stopping
+	Flush();
+	File.Reset();
+	return 0;
+}
+
+void FMoveAnalyticsWriter::Stop()
+{
+	bStopping = true;
+	WakeEvent->Trigger();
+}
+
+void FMoveAnalyticsWriter::Flush()
+{
+	const uint32 Read = ReadIndex.load(std::memory_order_relaxed);
+	const uint32 Write = WriteIndex.load(std::memory_order_acquire);
+	if (Read == Write)
+	{
+		return;
+	}
+
+	Scratch.Reset();
+	FMemoryWriter Writer(Scratch);
+	for (uint32 Index = Read; Index != Write; Index++)
+	{
+		const FMoveRecord& Record = Slots[Index & Mask];
+
+		// Each record is prefixed with its length so readers can skip records from newer versions
+		const int64 LengthOffset = Writer.Tell();
+		uint16 Length = 0;
+		Writer << Length;
+
+		double Time = Record.Time;
+		uint32 MoveId = Record.MoveId;
+		int16 LocationAX = Record.LocationAX;
+		int16 LocationAY = Record.LocationAY;
+		int16 LocationBX = Record.LocationBX;
+		int16 LocationBY = Record.LocationBY;
+		int32 ScoreDelta = Record.ScoreDelta;
+		float SettleMilliseconds = Record.SettleMilliseconds;
+		uint8 bMatched = Record.bMatched ? 1 : 0;
+		uint8 CascadeDepth = Record.CascadeDepth;
+		uint8 NumShapes = Record.NumShapes;
+		Writer << Time << MoveId << LocationAX << LocationAY << LocationBX << LocationBY << ScoreDelta << SettleMilliseconds << bMatched << CascadeDepth << NumShapes;
+		Writer.Serialize(const_cast<EMatchShape*>(Record.Shapes), NumShapes);
+
+		const int64 EndOffset = Writer.Tell();
+		Length = static_cast<uint16>(EndOffset - LengthOffset - sizeof(uint16));
+		Writer.Seek(LengthOffset);
+		Writer << Length;
+		Writer.Seek(EndOffset);
+	}
+
+	// The slots can be reused as soon as they are serialized
+	ReadIndex.store(Write, std::memory_order_release);
+
+	if (!File || BytesInFile + Scratch.Num() > MaxFileBytes)
+	{
+		Rotate();
+	}
+	if (File)
+	{
+		File->Write(Scratch.GetData(), Scratch.Num());
+		File->Flush();
+		BytesInFile += Scratch.Num();
+	}
+}
+
+void FMoveAnalyticsWriter::Rotate()
+{
+	File.Reset();
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	const FString Directory = FPaths::ProjectSavedDir() / TEXT("Analytics");
+	PlatformFile.CreateDirectoryTree(*Directory);
+
+	FileName = Directory / FString::Printf(TEXT("Moves_%s.m3an"), *FDateTime::Now().ToString(TEXT("%Y%m%d_%H%M%S_%s")));
+	File.Reset(PlatformFile.OpenWrite(*FileName));
+	if (!File)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to open analytics file [%s]"), *FileName);
+		return;
+	}
+
+	uint32 Header[2] = { AnalyticsFileMagic, AnalyticsFileVersion };
+	File->Write(reinterpret_cast<const uint8*>(Header), sizeof(Header));
+	BytesInFile = sizeof(Header);
+
+	Prune(PlatformFile, Directory);
+}
+
+void FMoveAnalyticsWriter::Prune(IPlatformFile& PlatformFile, const FString& Directory)
+{
+	struct FAnalyticsFile
+	{
+		FString Path;
+		int64 Size = 0;
+	};
+
+	TArray<FAnalyticsFile> Files;
+	int64 TotalBytes = 0;
+	PlatformFile.IterateDirectoryStat(*Directory, [&](const TCHAR* Path, const FFileStatData& StatData)
+		{
+			if (!StatData.bIsDirectory && FPaths::GetExtension(Path) == TEXT("m3an") && FileName != Path)
+			{
+				Files.Add({ Path, StatData.FileSize });
+				TotalBytes += StatData.FileSize;
+			}
+			return true;
+		});
+
+	// The names are timestamps, so they sort oldest first
+	Files.Sort([](const FAnalyticsFile& A, const FAnalyticsFile& B) { return A.Path < B.Path; });
+
+	// The new file grows to at most MaxFileBytes
+	int32 NumDeleted = 0;
+	int64 BytesDeleted = 0;
+	for (const FAnalyticsFile& OldFile : Files)
+	{
+		if (TotalBytes + MaxFileBytes <= MaxTotalBytes)
+		{
+			break;
+		}
+		if (PlatformFile.DeleteFile(*OldFile.Path))
+		{
+			TotalBytes -= OldFile.Size;
+			BytesDeleted += OldFile.Size;
+			NumDeleted++;
+		}
+	}
+
+	if (NumDeleted > 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Dropped the [%d] oldest analytics files, [%lld] bytes of moves, to stay within [%lld] bytes"), NumDeleted, BytesDeleted, MaxTotalBytes);
+	}
+}
@@ -52,18 +52,31 @@ int32 FBoardColumn::GetIndex(const AGemBase* Gem) const
 	return -1;
 }
 
-void FBoardColumn::QueueGemToSpawn(EGemType GemType)
+void FBoardColumn::QueueGemToSpawn(uint8 TypeId)
 {
-	GemsToSpawn.Add(GemType);
+	GemsToSpawn.Add(TypeId);
 }
 
-EGemType FBoardColumn::DequeueGemToSpawn()
+uint8 FBoardColumn::DequeueGemToSpawn()
 {
 	if (GemsToSpawn.IsEmpty())
 	{
 		UE_LOG(LogTemp, Fatal, TEXT("Tried to dequeue gem from empty queue"));
 	}
-	return GemsToSpawn.Pop();
+	// First in, first out so the gems arrive in the order they were queued
+	const uint8 TypeId = GemsToSpawn[0];
+	GemsToSpawn.RemoveAt(0);
+	return TypeId;
+}
+
+void FBoardColumn::RequeueGemToSpawn(uint8 TypeId)
+{
+	GemsToSpawn.Insert(TypeId, 0);
+}
+
+uint8 FBoardColumn::GetGemToSpawn(int32 Index) const
+{
+	return GemsToSpawn[Index];
 }
 
 int32 FBoardColumn::GetEmptySpaceUnder(int32 Index) const
@@ -0,0 +1,38 @@
+// Copyright Peter Carsten Collins (2024)
+
+
+#include "Board/BoardDirtyRegion.h"
+
+void FBoardDirtyRegion::Init(int32 Width, int32 Height)
+{
+	DirtyColumns.Init(false, Width);
+	DirtyRows.Init(false, Height);
+	NumDirtyColumns = 0;
+}
+
+void FBoardDirtyRegion::Reset()
+{
+	if (NumDirtyColumns > 0)
+	{
+		DirtyColumns.SetRange(0, DirtyColumns.Num(), false);
+		DirtyRows.SetRange(0, DirtyRows.Num(), false);
+		NumDirtyColumns = 0;
+	}
+}
+
+void FBoardDirtyRegion::MarkCell(const FBoardLocation& Location)
+{
+	if (!DirtyColumns[Location.X])
+	{
+		DirtyColumns[Location.X] = true;
+		NumDirtyColumns++;
+	}
+	DirtyRows[Location.Y] = true;
+}
+
+void FBoardDirtyRegion::MarkAll()
+{
+	DirtyColumns.SetRange(0, DirtyColumns.Num(), true);
+	DirtyRows.SetRange(0, DirtyRows.Num(), true);
+	NumDirtyColumns = DirtyColumns.Num();
+}
@@ -0,0 +1,313 @@
+// Copyright Peter Carsten Collins (2024)
+
+
+#include "Board/BoardGenerator.h"
+
+FBoardGenerator::FBoardGenerator(int32 InWidth, int32 InHeight, int32 InNumTypes)
+	: Width(InWidth)
+	, Height(InHeight)
+	, NumTypes(FMath::Clamp(InNumTypes, 1, MaxTypes))
+{
+}
+
+bool FBoardGenerator::Generate(FRandomStream& Random, int32 MinMoves, TArray<uint8>& OutTypes) const
+{
+	OutTypes.SetNumUninitialized(Width * Height);
+
+	for (int32 Attempt = 0; Attempt < MaxAttempts; Attempt++)
+	{
+		// Filling in index order means the cells to the left and below are always known, and any run of three is caught at
+		// its last cell. With three or more types at most two are ever ruled out, so the fill never backtracks
+		for (int32 X = 0; X < Width; X++)
+		{
+			for (int32 Y = 0; Y < Height; Y++)
+			{
+				FForbiddenTypes Forbidden = GetForbiddenTypes(OutTypes, X, Y);
+				if (Forbidden.Num() >= NumTypes)
+				{
+					Forbidden = FForbiddenTypes();
+				}
+
+				// Pick one of the allowed types at random
+				int32 Pick = Random.RandHelper(NumTypes - Forbidden.Num());
+				int32 Type = 0;
+				while (Forbidden.Contains(Type) || Pick-- > 0)
+				{
+					Type++;
+				}
+				OutTypes[GetIndex(X, Y)] = static_cast<uint8>(Type);
+			}
+		}
+
+		// Most fills already have plenty of moves. Plant more where they do not
+		int32 NumMoves = CountMoves(OutTypes, MinMoves);
+		for (int32 Plant = 0; NumMoves < MinMoves && Plant < MinMoves * 4; Plant++)
+		{
+			if (PlantMove(Random, OutTypes))
+			{
+				NumMoves = CountMoves(OutTypes, MinMoves);
+			}
+		}
+
+		if (NumMoves >= MinMoves && !HasMatch(OutTypes))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FBoardGenerator::Reshuffle(FRandomStream& Random, int32 MinMoves, const TArray<uint8>& Types, TArray<int32>& OutSources) const
+{
+	check(Types.Num() == Width * Height);
+
+	TArray<int32, TInlineAllocator<32>> Counts;
+	Counts.SetNumZeroed(NumTypes);
+	for (const uint8 Type : Types)
+	{
+		if (Type == EmptyCell)
+		{
+			continue;
+		}
+		if (Type >= NumTypes)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Cannot reshuffle gem type [%d] on a board of [%d] types"), Type, NumTypes);
+			return false;
+		}
+		Counts[Type]++;
+	}
+
+	TArray<uint8> Shuffled;
+	Shuffled.SetNumUninitialized(Types.Num());
+	TArray<int32, TInlineAllocator<32>> Remaining;
+	for (int32 Attempt = 0; Attempt < MaxAttempts; Attempt++)
+	{
+		Remaining = Counts;
+
+		// Same fill as Generate, except each type can only be used as many times as it appears on the board
+		bool bDeadEnd = false;
+		for (int32 X = 0; X < Width && !bDeadEnd; X++)
+		{
+			for (int32 Y = 0; Y < Height; Y++)
+			{
+				const int32 Index = GetIndex(X, Y);
+				if (Types[Index] == EmptyCell)
+				{
+					Shuffled[Index] = EmptyCell;
+					continue;
+				}
+
+				const FForbiddenTypes Forbidden = GetForbiddenTypes(Shuffled, X, Y);
+				int32 Total = 0;
+				for (int32 Type = 0; Type < NumTypes; Type++)
+				{
+					Total += Forbidden.Contains(Type) ? 0 : Remaining[Type];
+				}
+				if (Total == 0)
+				{
+					bDeadEnd = true;
+					break;
+				}
+
+				// Weight the pick by the gems left so the rare types are not stranded at the end
+				int32 Pick = Random.RandHelper(Total);
+				int32 Type = 0;
+				for (; Type < NumTypes; Type++)
+				{
+					const int32 Weight = Forbidden.Contains(Type) ? 0 : Remaining[Type];
+					if (Pick < Weight)
+					{
+						break;
+					}
+					Pick -= Weight;
+				}
+				Shuffled[Index] = static_cast<uint8>(Type);
+				Remaining[Type]--;
+			}
+		}
+
+		if (bDeadEnd || CountMoves(Shuffled, MinMoves) < MinMoves)
+		{
+			continue;
+		}
+
+		// Hand each cell a gem of its new type
+		TArray<TArray<int32>, TInlineAllocator<32>> SourcesByType;
+		SourcesByType.SetNum(NumTypes);
+		for (int32 Index = 0; Index < Types.Num(); Index++)
+		{
+			if (Types[Index] != EmptyCell)
+			{
+				SourcesByType[Types[Index]].Add(Index);
+			}
+		}
+
+		OutSources.SetNumUninitialized(Types.Num());
+		for (int32 Index = 0; Index < Types.Num(); Index++)
+		{
+			OutSources[Index] = Shuffled[Index] == EmptyCell ? Index : SourcesByType[Shuffled[Index]].Pop();
+		}
+		return true;
+	}
+	return false;
+}
+
+int32 FBoardGenerator::CountMoves(const TArray<uint8>& Types, int32 MaxMoves) const
+{
+	TArray<uint8> Scratch = Types;
+	int32 NumMoves = 0;
+
+	for (int32 X = 0; X < Width; X++)
+	{
+		for (int32 Y = 0; Y < Height; Y++)
+		{
+			const int32 Index = GetIndex(X, Y);
+			if (Scratch[Index] == EmptyCell)
+			{
+				continue;
+			}
+
+			// Only swap right and up so every pair is tried once
+			const FIntPoint Neighbours[] = { { X + 1, Y }, { X, Y + 1 } };
+			for (const FIntPoint& Neighbour : Neighbours)
+			{
+				if (Neighbour.X >= Width || Neighbour.Y >= Height)
+				{
+					continue;
+				}
+
+				const int32 NeighbourIndex = GetIndex(Neighbour.X, Neighbour.Y);
+				if (Scratch[NeighbourIndex] == EmptyCell || Scratch[NeighbourIndex] == Scratch[Index])
+				{
+					continue;
+				}
+
+				Swap(Scratch[Index], Scratch[NeighbourIndex]);
+				const bool bMatches = FormsMatchAt(Scratch, X, Y) || FormsMatchAt(Scratch, Neighbour.X, Neighbour.Y);
+				Swap(Scratch[Index], Scratch[NeighbourIndex]);
+
+				if (bMatches && ++NumMoves >= MaxMoves)
+				{
+					return NumMoves;
+				}
+			}
+		}
+	}
+	return NumMoves;
+}
+
+bool FBoardGenerator::HasMatch(const TArray<uint8>& Types) const
+{
+	for (int32 X = 0; X < Width; X++)
+	{
+		for (int32 Y = 0; Y < Height; Y++)
+		{
+			const uint8 Type = Types[GetIndex(X, Y)];
+			if (Type == EmptyCell)
+			{
+				continue;
+			}
+			if (X >= 2 && Types[GetIndex(X - 1, Y)] == Type && Types[GetIndex(X - 2, Y)] == Type)
+			{
+				return true;
+			}
+			if (Y >= 2 && Types[GetIndex(X, Y - 1)] == Type && Types[GetIndex(X, Y - 2)] == Type)
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+FBoardGenerator::FForbiddenTypes FBoardGenerator::GetForbiddenTypes(const TArray<uint8>& Types, int32 X, int32 Y) const
+{
+	FForbiddenTypes Forbidden;
+	if (X >= 2)
+	{
+		const uint8 Left = Types[GetIndex(X - 1, Y)];
+		if (Left != EmptyCell && Left == Types[GetIndex(X - 2, Y)])
+		{
+			Forbidden.Types[0] = Left;
+		}
+	}
+	if (Y >= 2)
+	{
+		const uint8 Below = Types[GetIndex(X, Y - 1)];
+		if (Below != EmptyCell && Below == Types[GetIndex(X, Y - 2)] && Below != Forbidden.Types[0])
+		{
+			Forbidden.Types[1] = Below;
+		}
+	}
+	return Forbidden;
+}
+
+bool FBoardGenerator::FormsMatchAt(const TArray<uint8>& Types, int32 X, int32 Y) const
+{
+	const uint8 Type = Types[GetIndex(X, Y)];
+	if (Type == EmptyCell)
+	{
+		return false;
+	}
+
+	int32 Left = X;
+	while (Left > 0 && Types[GetIndex(Left - 1, Y)] == Type) Left--;
+	int32 Right = X;
+	while (Right < Width - 1 && Types[GetIndex(Right + 1, Y)] == Type) Right++;
+	if (Right - Left >= 2)
+	{
+		return true;
+	}
+
+	int32 Bottom = Y;
+	while (Bottom > 0 && Types[GetIndex(X, Bottom - 1)] == Type) Bottom--;
+	int32 Top = Y;
+	while (Top < Height - 1 && Types[GetIndex(X, Top + 1)] == Type) Top++;
+	return Top - Bottom >= 2;
+}
+
+bool FBoardGenerator::PlantMove(FRandomStream& Random, TArray<uint8>& Types) const
+{
+	// A pair in a line and a third gem diagonally off the end, one swap from completing the line
+	const bool bHorizontal = Random.RandHelper(2) == 0;
+	const int32 SpanX = bHorizontal ? 3 : 2;
+	const int32 SpanY = bHorizontal ? 2 : 3;
+	if (Width < SpanX || Height < SpanY)
+	{
+		return false;
+	}
+
+	const int32 X = Random.RandHelper(Width - SpanX + 1);
+	const int32 Y = Random.RandHelper(Height - SpanY + 1);
+	FIntPoint Cells[3] = { { X, Y }, { X + 1, Y }, { X + 2, Y + 1 } };
+	if (!bHorizontal)
+	{
+		Cells[1] = { X, Y + 1 };
+		Cells[2] = { X + 1, Y + 2 };
+	}
+	const uint8 Type = static_cast<uint8>(Random.RandHelper(NumTypes));
+
+	uint8 Previous[3];
+	for (int32 Cell = 0; Cell < 3; Cell++)
+	{
+		const int32 Index = GetIndex(Cells[Cell].X, Cells[Cell].Y);
+		Previous[Cell] = Types[Index];
+		Types[Index] = Type;
+	}
+
+	bool bFormsMatch = false;
+	for (const FIntPoint& Cell : Cells)
+	{
+		bFormsMatch |= FormsMatchAt(Types, Cell.X, Cell.Y);
+	}
+
+	if (bFormsMatch)
+	{
+		for (int32 Cell = 0; Cell < 3; Cell++)
+		{
+			Types[GetIndex(Cells[Cell].X, Cells[Cell].Y)] = Previous[Cell];
+		}
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,225 @@
+// Copyright Peter Carsten Collins (2024)
+
+
+#include "Board/BoardLogic.h"
+
+#include "Board/BoardSnapshot.h"
+#include "Board/CascadeArena.h"
+#include "Profiling/AllocationCounter.h"
+
+void FBoardLogic::Init(const FBoardSnapshot& Snapshot, const FGemArchetypeRegistry& InRegistry)
+{
+	Width = Snapshot.Width;
+	Height = Snapshot.Height;
+	Cells = Snapshot.Cells;
+	SpawnQueues = Snapshot.SpawnQueues;
+	NumSpawned.Init(0, Width);
+	Random.Initialize(Snapshot.RandomSeed);
+	Registry = InRegistry;
+	ClearMask.Init(Width, Height);
+
+	// A board is only handed over settled, but an unfilled cell must not be mistaken for a gem
+	for (int32 Index = 0; Index < Cells.Num(); Index++)
+	{
+		if (Cells[Index] == FGemArchetypeRegistry::InvalidTypeId)
+		{
+			Cells[Index] = NextSpawn(Index / Height);
+		}
+	}
+}
+
+bool FBoardLogic::IsValidLocation(const FBoardLocation& Location) const
+{
+	return Location.X >= 0 && Location.X < Width && Location.Y >= 0 && Location.Y < Height;
+}
+
+bool FBoardLogic::WouldSwapMatch(const FBoardLocation& LocationA, const FBoardLocation& LocationB)
+{
+	if (!IsValidLocation(LocationA) || !IsValidLocation(LocationB) || FMath::Abs(LocationA.X - LocationB.X) + FMath::Abs(LocationA.Y - LocationB.Y) != 1)
+	{
+		return false;
+	}
+
+	Swap(LocationA, LocationB);
+	const bool bMatched = IsMatched(LocationA) || IsMatched(LocationB);
+	Swap(LocationA, LocationB);
+	return bMatched;
+}
+
+void FBoardLogic::Swap(const FBoardLocation& LocationA, const FBoardLocation& LocationB)
+{
+	::Swap(Cells[GetIndex(LocationA)], Cells[GetIndex(LocationB)]);
+}
+
+bool FBoardLogic::IsMatched(const FBoardLocation& Location) const
+{
+	const uint8 TypeId = Cells[GetIndex(Location)];
+	if (TypeId == FGemArchetypeRegistry::InvalidTypeId)
+	{
+		return false;
+	}
+
+	auto CountRun = [&](int32 StepX, int32 StepY)
+		{
+			int32 Count = 0;
+			FBoardLocation Candidate(Location.X + StepX, Location.Y + StepY);
+			while (IsValidLocation(Candidate))
+			{
+				const uint8 CandidateTypeId = Cells[GetIndex(Candidate)];
+				if (CandidateTypeId == FGemArchetypeRegistry::InvalidTypeId || !Registry.CanMatch(CandidateTypeId, TypeId))
+					break;
+
+				Count++;
+				Candidate.X += StepX;
+				Candidate.Y += StepY;
+			}
+			return Count;
+		};
+
+	return CountRun(-1, 0) + CountRun(1, 0) >= 2 || CountRun(0, -1) + CountRun(0, 1) >= 2;
+}
+
+bool FBoardLogic::FindMatches(FBoardMask& OutMask) const
+{
+	OutMask.Reset();
+
+	bool bFound = false;
+	for (int32 X = 0; X < Width; X++)
+	{
+		for (int32 Y = 0; Y < Height; Y++)
+		{
+			const FBoardLocation Location(X, Y);
+			if (IsMatched(Location))
+			{
+				OutMask.Set(Location);
+				bFound = true;
+			}
+		}
+	}
+	return bFound;
+}
+
+int32 FBoardLogic::ResolveStep(uint32 SpanId, TFunctionRef<void(const FBoardEvent&)> Emit)
+{
+	// Every buffer a step uses is sized by Init, so the steps never touch the heap
+	MATCHTHREE_COUNT_ALLOCATIONS();
+	FCascadeArenaScope ArenaScope;
+
+	if (!FindMatches(ClearMask))
+	{
+		return 0;
+	}
+
+	FBoardEvent Event;
+	Event.SpanId = SpanId;
+
+	// Clear every matched gem
+	int32 NumCleared = 0;
+	ClearMask.ForEachSetBit([&](int32 Index)
+		{
+			if (NumCleared == 0)
+			{
+				Event.Location = ClearMask.GetLocation(Index);
+			}
+			NumCleared++;
+			Cells[Index] = FGemArchetypeRegistry::InvalidTypeId;
+		});
+
+	Event.Type = EBoardEventType::Score;
+	Event.NumGems = NumCleared;
+	Emit(Event);
+	Event.NumGems = 0;
+
+	Event.Type = EBoardEventType::Destroy;
+	ClearMask.ForEachSetBit([&](int32 Index)
+		{
+			Event.Location = ClearMask.GetLocation(Index);
+			Emit(Event);
+		});
+
+	for (int32 X = 0; X < Width; X++)
+	{
+		const int32 FirstRow = ClearMask.FindFirstInColumn(X);
+		if (FirstRow == INDEX_NONE)
+		{
+			continue;
+		}
+
+		// Gems keep their order, so each one lands on the next free row above the gems already placed
+		int32 TargetRow = FirstRow;
+		int16 NumFallen = 0;
+		for (int32 Row = FirstRow; Row < Height; Row++)
+		{
+			const int32 Index = X * Height + Row;
+			if (Cells[Index] == FGemArchetypeRegistry::InvalidTypeId)
+			{
+				continue;
+			}
+
+			if (Row != TargetRow)
+			{
+				Cells[X * Height + TargetRow] = Cells[Index];
+				Cells[Index] = FGemArchetypeRegistry::InvalidTypeId;
+
+				Event.Type = EBoardEventType::Move;
+				Event.Location = FBoardLocation(X, Row);
+				Event.Target = FBoardLocation(X, TargetRow);
+				Event.Order = NumFallen++;
+				Emit(Event);
+			}
+			TargetRow++;
+		}
+
+		// Fill the cells left at the top
+		Event.Type = EBoardEventType::Spawn;
+		Event.Order = 0;
+		for (int32 Row = TargetRow; Row < Height; Row++)
+		{
+			Event.bFromSpawnQueue = NumSpawned[X] < SpawnQueues[X].Num();
+			const uint8 TypeId = NextSpawn(X);
+			Cells[X * Height + Row] = TypeId;
+
+			Event.Location = FBoardLocation(X, Row);
+			Event.TypeId = TypeId;
+			Event.RandomSeed = Random.GetCurrentSeed();
+			Emit(Event);
+		}
+		Event.TypeId = FGemArchetypeRegistry::InvalidTypeId;
+		Event.bFromSpawnQueue = false;
+	}
+
+	Event.Type = EBoardEventType::StepEnd;
+	Emit(Event);
+	return NumCleared;
+}
+
+int32 FBoardLogic::CountLegalMoves(int32 MaxMoves)
+{
+	int32 NumMoves = 0;
+	for (int32 X = 0; X < Width; X++)
+	{
+		for (int32 Y = 0; Y < Height; Y++)
+		{
+			const FBoardLocation Location(X, Y);
+			if ((X + 1 < Width && WouldSwapMatch(Location, FBoardLocation(X + 1, Y)))
+				|| (Y + 1 < Height && WouldSwapMatch(Location, FBoardLocation(X, Y + 1))))
+			{
+				if (++NumMoves >= MaxMoves)
+				{
+					return NumMoves;
+				}
+			}
+		}
+	}
+	return NumMoves;
+}
+
+uint8 FBoardLogic::NextSpawn(int32 Column)
+{
+	const TArray<uint8>& SpawnQueue = SpawnQueues[Column];
+	if (NumSpawned[Column] < SpawnQueue.Num())
+	{
+		return SpawnQueue[NumSpawned[Column]++];
+	}
+	return Registry.PickRandom(Random);
+}
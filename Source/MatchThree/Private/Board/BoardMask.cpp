@@ -0,0 +1,104 @@
+// Copyright Peter Carsten Collins (2024)
+
+
+#include "Board/BoardMask.h"
+
+void FBoardMask::Init(int32 InWidth, int32 InHeight)
+{
+	Width = InWidth;
+	Height = InHeight;
+	Words.Init(0, FMath::DivideAndRoundUp(Width * Height, 64));
+}
+
+void FBoardMask::Reset()
+{
+	FMemory::Memzero(Words.GetData(), Words.Num() * sizeof(uint64));
+}
+
+void FBoardMask::SetColumn(int32 X)
+{
+	SetRange(X * Height, Height);
+}
+
+void FBoardMask::SetRow(int32 Y)
+{
+	for (int32 X = 0; X < Width; X++)
+	{
+		Set(X * Height + Y);
+	}
+}
+
+void FBoardMask::SetArea(const FBoardLocation& Center, int32 Radius)
+{
+	const int32 MinY = FMath::Max(Center.Y - Radius, 0);
+	const int32 MaxY = FMath::Min(Center.Y + Radius, Height - 1);
+	for (int32 X = FMath::Max(Center.X - Radius, 0); X <= FMath::Min(Center.X + Radius, Width - 1); X++)
+	{
+		SetRange(X * Height + MinY, MaxY - MinY + 1);
+	}
+}
+
+FBoardMask& FBoardMask::operator|=(const FBoardMask& Other)
+{
+	check(Words.Num() == Other.Words.Num());
+	for (int32 WordIndex = 0; WordIndex < Words.Num(); WordIndex++)
+	{
+		Words[WordIndex] |= Other.Words[WordIndex];
+	}
+	return *this;
+}
+
+bool FBoardMask::IsEmpty() const
+{
+	for (const uint64 Word : Words)
+	{
+		if (Word != 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int32 FBoardMask::CountBits() const
+{
+	int32 Count = 0;
+	for (const uint64 Word : Words)
+	{
+		Count += static_cast<int32>(FMath::CountBits(Word));
+	}
+	return Count;
+}
+
+int32 FBoardMask::CountBitsInColumn(int32 X) const
+{
+	int32 Count = 0;
+	ForEachWordInRange(X * Height, Height, [this, &Count](int32 WordIndex, uint64 Bits)
+		{
+			Count += static_cast<int32>(FMath::CountBits(Words[WordIndex] & Bits));
+		});
+	return Count;
+}
+
+int32 FBoardMask::FindFirstInColumn(int32 X) const
+{
+	int32 First = INDEX_NONE;
+	ForEachWordInRange(X * Height, Height, [this, &First](int32 WordIndex, uint64 Bits)
+		{
+			const uint64 Word = Words[WordIndex] & Bits;
+			if (First == INDEX_NONE && Word != 0)
+			{
+				First = WordIndex * 64 + static_cast<int32>(FMath::CountTrailingZeros64(Word));
+			}
+		});
+	return First == INDEX_NONE ? INDEX_NONE : First - X * Height;
+}
+
+void FBoardMask::SetRange(int32 Start, int32 Num)
+{
+	// Whole words in the middle of the run are filled at once
+	ForEachWordInRange(Start, Num, [this](int32 WordIndex, uint64 Bits)
+		{
+			Words[WordIndex] |= Bits;
+		});
+}
@@ -0,0 +1,184 @@
+// Copyright Peter Carsten Collins (2024)
+
+
+#include "Board/BoardSnapshot.h"
+
+#include "Algo/AllOf.h"
+#include "Misc/Crc.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace
+{
+	// Type ids are packed into nibbles when every id and the empty cell fit in four bits
+	constexpr uint8 EmptyNibble = 0xF;
+
+	bool CanPackNibbles(int32 NumTypes)
+	{
+		return NumTypes < EmptyNibble;
+	}
+}
+
+bool FBoardSnapshot::IsValid() const
+{
+	if (Width <= 0 || Height <= 0 || Width > MAX_uint16 || Height > MAX_uint16 || NumTypes <= 0 || NumTypes >= EmptyCell)
+	{
+		return false;
+	}
+
+	if (Cells.Num() != Width * Height || SpawnQueues.Num() != Width)
+	{
+		return false;
+	}
+
+	auto IsValidTypeId = [this](uint8 TypeId) { return TypeId < NumTypes; };
+	for (const uint8 Cell : Cells)
+	{
+		if (Cell != EmptyCell && !IsValidTypeId(Cell))
+		{
+			return false;
+		}
+	}
+
+	for (const TArray<uint8>& SpawnQueue : SpawnQueues)
+	{
+		if (SpawnQueue.Num() > MAX_uint16 || !Algo::AllOf(SpawnQueue, IsValidTypeId))
+		{
+			return false;
+		}
+	}
+
+	for (const FSnapshotSwap& Swap : Swaps)
+	{
+		if (Swap.LocationAX < 0 || Swap.LocationAX >= Width || Swap.LocationBX < 0 || Swap.LocationBX >= Width
+			|| Swap.LocationAY < 0 || Swap.LocationAY >= Height || Swap.LocationBY < 0 || Swap.LocationBY >= Height)
+		{
+			return false;
+		}
+	}
+
+	return Swaps.Num() <= MAX_uint16;
+}
+
+void FBoardSnapshot::Write(TArray<uint8>& OutBytes) const
+{
+	check(IsValid());
+
+	OutBytes.Reset();
+	FMemoryWriter Writer(OutBytes);
+
+	uint32 Magic = FileMagic;
+	uint16 Version = FileVersion;
+	uint16 Width16 = static_cast<uint16>(Width);
+	uint16 Height16 = static_cast<uint16>(Height);
+	uint8 NumTypes8 = static_cast<uint8>(NumTypes);
+	int32 Seed = RandomSeed;
+	int32 ScoreValue = Score;
+	Writer << Magic << Version << Width16 << Height16 << NumTypes8 << Seed << ScoreValue;
+
+	if (CanPackNibbles(NumTypes))
+	{
+		for (int32 Index = 0; Index < Cells.Num(); Index += 2)
+		{
+			const uint8 Low = Cells[Index] == EmptyCell ? EmptyNibble : Cells[Index];
+			const uint8 High = Index + 1 >= Cells.Num() || Cells[Index + 1] == EmptyCell ? EmptyNibble : Cells[Index + 1];
+			uint8 Packed = static_cast<uint8>(Low | (High << 4));
+			Writer << Packed;
+		}
+	}
+	else
+	{
+		Writer.Serialize(const_cast<uint8*>(Cells.GetData()), Cells.Num());
+	}
+
+	for (const TArray<uint8>& SpawnQueue : SpawnQueues)
+	{
+		uint16 Length = static_cast<uint16>(SpawnQueue.Num());
+		Writer << Length;
+		Writer.Serialize(const_cast<uint8*>(SpawnQueue.GetData()), SpawnQueue.Num());
+	}
+
+	uint16 NumSwaps = static_cast<uint16>(Swaps.Num());
+	Writer << NumSwaps;
+	for (FSnapshotSwap Swap : Swaps)
+	{
+		Writer << Swap.LocationAX << Swap.LocationAY << Swap.LocationBX << Swap.LocationBY;
+	}
+
+	uint32 Checksum = FCrc::MemCrc32(OutBytes.GetData(), OutBytes.Num());
+	Writer << Checksum;
+}
+
+bool FBoardSnapshot::Read(const TArray<uint8>& Bytes)
+{
+	if (Bytes.Num() < static_cast<int32>(sizeof(uint32)))
+	{
+		return false;
+	}
+
+	// Check the whole payload before trusting any of it
+	const int32 PayloadSize = Bytes.Num() - sizeof(uint32);
+	uint32 StoredChecksum = 0;
+	FMemory::Memcpy(&StoredChecksum, Bytes.GetData() + PayloadSize, sizeof(uint32));
+	if (StoredChecksum != FCrc::MemCrc32(Bytes.GetData(), PayloadSize))
+	{
+		return false;
+	}
+
+	FMemoryReader Reader(Bytes);
+
+	uint32 Magic = 0;
+	uint16 Version = 0;
+	uint16 Width16 = 0;
+	uint16 Height16 = 0;
+	uint8 NumTypes8 = 0;
+	Reader << Magic << Version << Width16 << Height16 << NumTypes8 << RandomSeed << Score;
+	if (Reader.IsError() || Magic != FileMagic || Version != FileVersion)
+	{
+		return false;
+	}
+
+	Width = Width16;
+	Height = Height16;
+	NumTypes = NumTypes8;
+
+	Cells.SetNumUninitialized(Width * Height);
+	if (CanPackNibbles(NumTypes))
+	{
+		for (int32 Index = 0; Index < Cells.Num(); Index += 2)
+		{
+			uint8 Packed = 0;
+			Reader << Packed;
+			const uint8 Low = Packed & 0xF;
+			const uint8 High = Packed >> 4;
+			Cells[Index] = Low == EmptyNibble ? EmptyCell : Low;
+			if (Index + 1 < Cells.Num())
+			{
+				Cells[Index + 1] = High == EmptyNibble ? EmptyCell : High;
+			}
+		}
+	}
+	else
+	{
+		Reader.Serialize(Cells.GetData(), Cells.Num());
+	}
+
+	SpawnQueues.SetNum(Width);
+	for (TArray<uint8>& SpawnQueue : SpawnQueues)
+	{
+		uint16 Length = 0;
+		Reader << Length;
+		SpawnQueue.SetNumUninitialized(Length);
+		Reader.Serialize(SpawnQueue.GetData(), Length);
+	}
+
+	uint16 NumSwaps = 0;
+	Reader << NumSwaps;
+	Swaps.SetNum(NumSwaps);
+	for (FSnapshotSwap& Swap : Swaps)
+	{
+		Reader << Swap.LocationAX << Swap.LocationAY << Swap.LocationBX << Swap.LocationBY;
+	}
+
+	return !Reader.IsError() && Reader.Tell() == PayloadSize && IsValid();
+}
@@ -0,0 +1,125 @@
+// Copyright Peter Carsten Collins (2024)
+
+
+#include "Board/BoardWorker.h"
+
+#include "Board/BoardSnapshot.h"
+#include "HAL/Event.h"
+#include "HAL/RunnableThread.h"
+#include "Profiling/MatchThreeStats.h"
+
+FBoardWorker::FBoardWorker()
+{
+	WakeEvent = FPlatformProcess::GetSynchEventFromPool();
+}
+
+FBoardWorker::~FBoardWorker()
+{
+	Shutdown();
+	FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+}
+
+void FBoardWorker::Start(const FBoardSnapshot& Snapshot, const FGemArchetypeRegistry& Registry)
+{
+	if (!Thread)
+	{
+		Logic.Init(Snapshot, Registry);
+		bStopping = false;
+		Thread = FRunnableThread::Create(this, TEXT("MatchThreeBoard"), 0, TPri_Normal);
+	}
+}
+
+void FBoardWorker::Shutdown()
+{
+	if (Thread)
+	{
+		Stop();
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+}
+
+bool FBoardWorker::PushCommand(const FBoardCommand& Command)
+{
+	if (!Commands.Push(Command))
+	{
+		return false;
+	}
+	WakeEvent->Trigger();
+	return true;
+}
+
+uint32 FBoardWorker::Run()
+{
+	while (!bStopping)
+	{
+		WakeEvent->Wait();
+
+		FBoardCommand Command;
+		while (!bStopping && Commands.Pop(Command))
+		{
+			RunCommand(Command);
+		}
+	}
+	return 0;
+}
+
+void FBoardWorker::Stop()
+{
+	bStopping = true;
+	WakeEvent->Trigger();
+}
+
+void FBoardWorker::RunCommand(const FBoardCommand& Command)
+{
+	MATCHTHREE_SCOPE_CYCLE_COUNTER(STAT_MatchThree_BoardWorker);
+
+	FBoardEvent Event;
+	Event.Location = Command.LocationA;
+	Event.Target = Command.LocationB;
+	Event.SpanId = Command.SpanId;
+
+	if (!Logic.WouldSwapMatch(Command.LocationA, Command.LocationB))
+	{
+		Event.Type = EBoardEventType::SwapRejected;
+		Emit(Event);
+		Event.Type = EBoardEventType::Settled;
+		Event.RandomSeed = Logic.GetRandomSeed();
+		Emit(Event);
+		return;
+	}
+
+	// The swap is shown as a step of its own so the gems arrive before anything is cleared
+	Logic.Swap(Command.LocationA, Command.LocationB);
+	Event.Type = EBoardEventType::SwapAccepted;
+	Emit(Event);
+	Event.Type = EBoardEventType::StepEnd;
+	Emit(Event);
+
+	while (!bStopping && Logic.ResolveStep(Command.SpanId, [this](const FBoardEvent& StepEvent) { Emit(StepEvent); }) > 0)
+	{
+	}
+
+	Event.Type = EBoardEventType::Settled;
+	Event.RandomSeed = Logic.GetRandomSeed();
+	Emit(Event);
+
+	if (Logic.CountLegalMoves(1) == 0)
+	{
+		Event.Type = EBoardEventType::DeadBoard;
+		Emit(Event);
+	}
+}
+
+void FBoardWorker::Emit(const FBoardEvent& Event)
+{
+	while (!Events.Push(Event))
+	{
+		if (bStopping)
+		{
+			return;
+		}
+		FPlatformProcess::Sleep(0.001f);
+	}
+}
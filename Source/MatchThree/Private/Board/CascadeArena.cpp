@@ -0,0 +1,65 @@
+// Copyright Peter Carsten Collins (2024)
+
+
+#include "Board/CascadeArena.h"
+
+#include "Profiling/MatchThreeMemory.h"
+
+FCascadeArena& FCascadeArena::Get()
+{
+	static thread_local FCascadeArena Arena;
+	return Arena;
+}
+
+FCascadeArena::~FCascadeArena()
+{
+	for (const FChunk& Chunk : Chunks)
+	{
+		FMemory::Free(Chunk.Data);
+	}
+}
+
+void* FCascadeArena::Allocate(SIZE_T Size, uint32 Alignment)
+{
+	// Move on through the chunks already held before allocating another
+	while (ChunkIndex < Chunks.Num())
+	{
+		const FChunk& Chunk = Chunks[ChunkIndex];
+		const SIZE_T AlignedOffset = Align(Offset, Alignment);
+		if (AlignedOffset + Size <= Chunk.Size)
+		{
+			BytesUsed += AlignedOffset + Size - Offset;
+			PeakBytesUsed = FMath::Max(PeakBytesUsed, BytesUsed);
+			Offset = AlignedOffset + Size;
+			return Chunk.Data + AlignedOffset;
+		}
+
+		ChunkIndex++;
+		Offset = 0;
+	}
+
+	MATCHTHREE_LLM_SCOPE(Matches);
+	FChunk& Chunk = Chunks.AddDefaulted_GetRef();
+	Chunk.Size = FMath::Max<SIZE_T>(ChunkSize, Size);
+	Chunk.Data = static_cast<uint8*>(FMemory::Malloc(Chunk.Size, FMath::Max<uint32>(Alignment, 16)));
+
+	ChunkIndex = Chunks.Num() - 1;
+	Offset = Size;
+	BytesUsed += Size;
+	PeakBytesUsed = FMath::Max(PeakBytesUsed, BytesUsed);
+	return Chunk.Data;
+}
+
+void FCascadeArena::Reset()
+{
+	ChunkIndex = 0;
+	Offset = 0;
+	BytesUsed = 0;
+}
+
+void FCascadeArena::Rewind(const FMark& Mark)
+{
+	ChunkIndex = Mark.ChunkIndex;
+	Offset = Mark.Offset;
+	BytesUsed = Mark.BytesUsed;
+}
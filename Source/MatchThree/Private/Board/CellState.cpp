@@ -0,0 +1,29 @@
+// Copyright Peter Carsten Collins (2024)
+
+
+#include "Board/CellState.h"
+
+namespace CellState
+{
+	static constexpr uint8 Bit(ECellState State)
+	{
+		return static_cast<uint8>(1 << static_cast<uint8>(State));
+	}
+
+	// The states each state can go to, by ECellState. Any gem can leave its cell, which empties it
+	static constexpr uint8 LegalTransitions[] =
+	{
+		/* Empty */    Bit(ECellState::Settled) | Bit(ECellState::Falling) | Bit(ECellState::Swapping) | Bit(ECellState::Spawning),
+		/* Settled */  Bit(ECellState::Empty) | Bit(ECellState::Swapping) | Bit(ECellState::Matched),
+		/* Falling */  Bit(ECellState::Empty) | Bit(ECellState::Settled),
+		/* Swapping */ Bit(ECellState::Empty) | Bit(ECellState::Settled),
+		/* Matched */  Bit(ECellState::Empty) | Bit(ECellState::Settled),
+		/* Spawning */ Bit(ECellState::Empty) | Bit(ECellState::Settled),
+	};
+	static_assert(UE_ARRAY_COUNT(LegalTransitions) == static_cast<int32>(ECellState::Spawning) + 1, "Every cell state needs its transitions");
+
+	bool IsLegalTransition(ECellState From, ECellState To)
+	{
+		return From == To || (LegalTransitions[static_cast<uint8>(From)] & Bit(To)) != 0;
+	}
+}
@@ -0,0 +1,42 @@
+// Copyright Peter Carsten Collins (2024)
+
+
+#include "Board/ColumnLocks.h"
+
+void FColumnLocks::Init(int32 NumColumns)
+{
+	LockCounts.Init(0, NumColumns);
+	NumLocked = 0;
+}
+
+void FColumnLocks::Lock(int32 Column)
+{
+	if (LockCounts[Column]++ == 0)
+	{
+		NumLocked++;
+	}
+}
+
+void FColumnLocks::Unlock(int32 Column)
+{
+	if (LockCounts[Column] <= 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Tried to unlock column [%d] which is not locked"), Column);
+		return;
+	}
+
+	if (--LockCounts[Column] == 0)
+	{
+		NumLocked--;
+	}
+}
+
+bool FColumnLocks::IsLocked(int32 Column) const
+{
+	return LockCounts[Column] > 0;
+}
+
+bool FColumnLocks::IsEmpty() const
+{
+	return NumLocked == 0;
+}
@@ -0,0 +1,327 @@
+// Copyright Peter Carsten Collins (2024)
+
+
+#include "Board/LevelPack.h"
+
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/Crc.h"
+#include "Misc/FileHelper.h"
+
+namespace
+{
+	// Level records start on a 4 byte boundary so their goals and offsets can be read in place
+	constexpr int32 RecordAlignment = 4;
+
+	int32 GetMaskSize(int32 Width, int32 Height)
+	{
+		return FMath::DivideAndRoundUp(Width * Height, 8);
+	}
+
+	// The size of a level record up to its spawn types
+	int64 GetFixedSize(int32 Width, int32 Height, int32 NumGoals)
+	{
+		return sizeof(LevelPack::FLevelRecord)
+			+ static_cast<int64>(NumGoals) * sizeof(FLevelGoal)
+			+ (static_cast<int64>(Width) + 1) * sizeof(uint32)
+			+ GetMaskSize(Width, Height)
+			+ static_cast<int64>(Width) * Height;
+	}
+}
+
+uint32 LevelPack::HashName(const FString& Name)
+{
+	return FCrc::StrCrc32(*Name.ToLower());
+}
+
+bool FLevelView::IsPlayable(int32 X, int32 Y) const
+{
+	const int32 CellIndex = X * Record->Height + Y;
+	return (Mask[CellIndex / 8] & (1 << (CellIndex % 8))) != 0;
+}
+
+bool FLevelView::HasMask() const
+{
+	const int32 NumCells = Record->Width * Record->Height;
+	for (int32 CellIndex = 0; CellIndex < NumCells; CellIndex++)
+	{
+		if ((Mask[CellIndex / 8] & (1 << (CellIndex % 8))) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+TConstArrayView<uint8> FLevelView::GetSpawnSequence(int32 Column) const
+{
+	return TConstArrayView<uint8>(SpawnTypes + SpawnOffsets[Column], SpawnOffsets[Column + 1] - SpawnOffsets[Column]);
+}
+
+bool FLevelView::Init(const uint8* Data, uint32 Size)
+{
+	Record = nullptr;
+
+	if (Size < sizeof(LevelPack::FLevelRecord))
+	{
+		return false;
+	}
+
+	const LevelPack::FLevelRecord* InRecord = reinterpret_cast<const LevelPack::FLevelRecord*>(Data);
+	const int32 Width = InRecord->Width;
+	const int32 Height = InRecord->Height;
+	const int64 FixedSize = GetFixedSize(Width, Height, InRecord->NumGoals);
+	if (Width == 0 || Height == 0 || InRecord->NumTypes == 0 || FixedSize > Size)
+	{
+		return false;
+	}
+
+	const uint8* Cursor = Data + sizeof(LevelPack::FLevelRecord);
+	Goals = TConstArrayView<FLevelGoal>(reinterpret_cast<const FLevelGoal*>(Cursor), InRecord->NumGoals);
+	Cursor += InRecord->NumGoals * sizeof(FLevelGoal);
+	SpawnOffsets = reinterpret_cast<const uint32*>(Cursor);
+	Cursor += (Width + 1) * sizeof(uint32);
+	Mask = Cursor;
+	Cursor += GetMaskSize(Width, Height);
+	Cells = Cursor;
+	Cursor += Width * Height;
+	SpawnTypes = Cursor;
+
+	// The offsets must rise and stay inside the record
+	if (SpawnOffsets[0] != 0 || FixedSize + SpawnOffsets[Width] > Size)
+	{
+		return false;
+	}
+	for (int32 Column = 0; Column < Width; Column++)
+	{
+		if (SpawnOffsets[Column + 1] < SpawnOffsets[Column])
+		{
+			return false;
+		}
+	}
+
+	// Type ids index into the board's gem types, so a bad one must never reach it
+	auto IsBadTypeId = [InRecord](uint8 TypeId) { return TypeId >= InRecord->NumTypes; };
+	for (int32 CellIndex = 0; CellIndex < Width * Height; CellIndex++)
+	{
+		if (Cells[CellIndex] != LevelPack::RandomCell && IsBadTypeId(Cells[CellIndex]))
+		{
+			return false;
+		}
+	}
+	for (uint32 SpawnIndex = 0; SpawnIndex < SpawnOffsets[Width]; SpawnIndex++)
+	{
+		if (IsBadTypeId(SpawnTypes[SpawnIndex]))
+		{
+			return false;
+		}
+	}
+	for (const FLevelGoal& Goal : Goals)
+	{
+		if (Goal.Type == ELevelGoalType::ClearGems && IsBadTypeId(Goal.TypeId))
+		{
+			return false;
+		}
+	}
+
+	Record = InRecord;
+	return true;
+}
+
+FLevelPack::FLevelPack() = default;
+
+FLevelPack::~FLevelPack()
+{
+	Close();
+}
+
+bool FLevelPack::Open(const FString& FileName)
+{
+	Close();
+
+	// Map the pack so only the pages of the levels that are opened are ever read
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	FOpenMappedResult MappedResult = PlatformFile.OpenMappedEx(*FileName);
+	if (!MappedResult.HasError())
+	{
+		MappedFile = MappedResult.StealValue();
+		MappedRegion.Reset(MappedFile->MapRegion(0, MappedFile->GetFileSize()));
+	}
+
+	if (MappedRegion)
+	{
+		Data = MappedRegion->GetMappedPtr();
+		Size = MappedRegion->GetMappedSize();
+	}
+	else
+	{
+		// Packed files and some platforms cannot be mapped
+		MappedFile.Reset();
+		if (!FFileHelper::LoadFileToArray(LoadedBytes, *FileName, FILEREAD_Silent))
+		{
+			return false;
+		}
+		Data = LoadedBytes.GetData();
+		Size = LoadedBytes.Num();
+	}
+
+	if (!ReadIndex())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Level pack [%s] is corrupt or not version [%d]"), *FileName, LevelPack::FileVersion);
+		Close();
+		return false;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Opened [%d] levels from [%s]%s"), Index.Num(), *FileName, MappedRegion ? TEXT(" (mapped)") : TEXT(""));
+	return true;
+}
+
+void FLevelPack::Close()
+{
+	Index = TConstArrayView<LevelPack::FIndexEntry>();
+	Data = nullptr;
+	Size = 0;
+
+	// The region must be unmapped before its file is closed
+	MappedRegion.Reset();
+	MappedFile.Reset();
+	LoadedBytes.Empty();
+}
+
+bool FLevelPack::ReadIndex()
+{
+	if (!Data || Size < static_cast<int64>(sizeof(LevelPack::FHeader)))
+	{
+		return false;
+	}
+
+	const LevelPack::FHeader* Header = reinterpret_cast<const LevelPack::FHeader*>(Data);
+	if (Header->Magic != LevelPack::FileMagic || Header->Version != LevelPack::FileVersion)
+	{
+		return false;
+	}
+
+	const int64 IndexSize = static_cast<int64>(Header->NumLevels) * sizeof(LevelPack::FIndexEntry);
+	if (Header->IndexOffset % RecordAlignment != 0 || Header->IndexOffset + IndexSize > Size)
+	{
+		return false;
+	}
+
+	Index = TConstArrayView<LevelPack::FIndexEntry>(reinterpret_cast<const LevelPack::FIndexEntry*>(Data + Header->IndexOffset), Header->NumLevels);
+	for (const LevelPack::FIndexEntry& Entry : Index)
+	{
+		if (Entry.Offset % RecordAlignment != 0 || static_cast<int64>(Entry.Offset) + Entry.Size > Size)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int32 FLevelPack::FindLevel(const FString& Name) const
+{
+	const uint32 NameHash = LevelPack::HashName(Name);
+	return Index.IndexOfByPredicate([NameHash](const LevelPack::FIndexEntry& Entry) { return Entry.NameHash == NameHash; });
+}
+
+FLevelView FLevelPack::GetLevel(int32 LevelIndex) const
+{
+	FLevelView Level;
+	if (Index.IsValidIndex(LevelIndex))
+	{
+		Level.Init(Data + Index[LevelIndex].Offset, Index[LevelIndex].Size);
+	}
+	return Level;
+}
+
+bool FLevelPackBuilder::AddLevel(const FLevelDescription& Level, FString& OutError)
+{
+	const int32 NumCells = Level.Width * Level.Height;
+	if (Level.Width <= 0 || Level.Height <= 0 || Level.Width > MAX_uint16 || Level.Height > MAX_uint16)
+	{
+		OutError = FString::Printf(TEXT("Bad size [%dx%d]"), Level.Width, Level.Height);
+		return false;
+	}
+	if (Level.NumTypes <= 0 || Level.NumTypes >= LevelPack::RandomCell || Level.Goals.Num() > MAX_uint8 || Level.MoveLimit < 0 || Level.MoveLimit > MAX_uint16)
+	{
+		OutError = FString::Printf(TEXT("Bad gem types [%d], goals [%d] or move limit [%d]"), Level.NumTypes, Level.Goals.Num(), Level.MoveLimit);
+		return false;
+	}
+	if (Level.Mask.Num() != NumCells || Level.Cells.Num() != NumCells || Level.SpawnSequences.Num() != Level.Width)
+	{
+		OutError = TEXT("The mask, cells and spawn sequences do not match the size");
+		return false;
+	}
+
+	const uint32 NameHash = LevelPack::HashName(Level.Name);
+	if (Index.ContainsByPredicate([NameHash](const LevelPack::FIndexEntry& Entry) { return Entry.NameHash == NameHash; }))
+	{
+		OutError = FString::Printf(TEXT("Name [%s] is already used, or has the same hash as another level"), *Level.Name);
+		return false;
+	}
+
+	TArray<uint8> Bytes;
+	Bytes.Reserve(GetFixedSize(Level.Width, Level.Height, Level.Goals.Num()));
+	auto Append = [&Bytes](const void* Source, int32 Num) { Bytes.Append(static_cast<const uint8*>(Source), Num); };
+
+	LevelPack::FLevelRecord Record;
+	Record.Width = static_cast<uint16>(Level.Width);
+	Record.Height = static_cast<uint16>(Level.Height);
+	Record.NumTypes = static_cast<uint8>(Level.NumTypes);
+	Record.NumGoals = static_cast<uint8>(Level.Goals.Num());
+	Record.MoveLimit = static_cast<uint16>(Level.MoveLimit);
+	Append(&Record, sizeof(Record));
+	Append(Level.Goals.GetData(), Level.Goals.Num() * sizeof(FLevelGoal));
+
+	uint32 SpawnOffset = 0;
+	Append(&SpawnOffset, sizeof(SpawnOffset));
+	for (const TArray<uint8>& SpawnSequence : Level.SpawnSequences)
+	{
+		SpawnOffset += SpawnSequence.Num();
+		Append(&SpawnOffset, sizeof(SpawnOffset));
+	}
+
+	const int32 MaskStart = Bytes.AddZeroed(GetMaskSize(Level.Width, Level.Height));
+	for (int32 CellIndex = 0; CellIndex < NumCells; CellIndex++)
+	{
+		if (Level.Mask[CellIndex])
+		{
+			Bytes[MaskStart + CellIndex / 8] |= 1 << (CellIndex % 8);
+		}
+	}
+
+	Append(Level.Cells.GetData(), NumCells);
+	for (const TArray<uint8>& SpawnSequence : Level.SpawnSequences)
+	{
+		Append(SpawnSequence.GetData(), SpawnSequence.Num());
+	}
+
+	// Check the level the way the game will read it
+	FLevelView View;
+	if (!View.Init(Bytes.GetData(), Bytes.Num()))
+	{
+		OutError = TEXT("A cell, spawn or goal uses a gem type the level does not have");
+		return false;
+	}
+
+	LevelPack::FIndexEntry& Entry = Index.AddDefaulted_GetRef();
+	Entry.NameHash = NameHash;
+	Entry.Offset = sizeof(LevelPack::FHeader) + LevelBytes.Num();
+	Entry.Size = Bytes.Num();
+
+	LevelBytes.Append(Bytes);
+	LevelBytes.AddZeroed(Align(LevelBytes.Num(), RecordAlignment) - LevelBytes.Num());
+	return true;
+}
+
+void FLevelPackBuilder::Write(TArray<uint8>& OutBytes) const
+{
+	LevelPack::FHeader Header;
+	Header.NumLevels = Index.Num();
+	Header.IndexOffset = sizeof(LevelPack::FHeader) + LevelBytes.Num();
+
+	OutBytes.Reset(Header.IndexOffset + Index.Num() * sizeof(LevelPack::FIndexEntry));
+	OutBytes.Append(reinterpret_cast<const uint8*>(&Header), sizeof(Header));
+	OutBytes.Append(LevelBytes);
+	OutBytes.Append(reinterpret_cast<const uint8*>(Index.GetData()), Index.Num() * sizeof(LevelPack::FIndexEntry));
+}
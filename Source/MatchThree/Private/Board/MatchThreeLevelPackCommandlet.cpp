@@ -0,0 +1,170 @@
+// Copyright Peter Carsten Collins (2024)
+
+
+#include "Board/MatchThreeLevelPackCommandlet.h"
+
+#include "Board/LevelPack.h"
+#include "Dom/JsonObject.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+
+UMatchThreeLevelPackCommandlet::UMatchThreeLevelPackCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UMatchThreeLevelPackCommandlet::Main(const FString& Params)
+{
+	FString SourceDirectory = FPaths::ProjectDir() / TEXT("Levels") / TEXT("Source");
+	FParse::Value(*Params, TEXT("Source="), SourceDirectory);
+
+	FString OutputPath = FPaths::ProjectContentDir() / TEXT("Levels") / TEXT("Levels.m3lp");
+	FParse::Value(*Params, TEXT("Output="), OutputPath);
+
+	// Sort the files so the pack is the same on every machine
+	TArray<FString> FileNames;
+	IFileManager::Get().FindFiles(FileNames, *(SourceDirectory / TEXT("*.json")), true, false);
+	FileNames.Sort();
+
+	FLevelPackBuilder Builder;
+	int32 NumErrors = 0;
+	for (const FString& FileName : FileNames)
+	{
+		FString Json;
+		FLevelDescription Level;
+		FString Error;
+		if (!FFileHelper::LoadFileToString(Json, *(SourceDirectory / FileName)))
+		{
+			Error = TEXT("Could not read the file");
+		}
+		else if (ParseLevel(Json, Level, Error))
+		{
+			Level.Name = FPaths::GetBaseFilename(FileName);
+			Builder.AddLevel(Level, Error);
+		}
+
+		if (!Error.IsEmpty())
+		{
+			UE_LOG(LogTemp, Error, TEXT("Level [%s]: %s"), *FileName, *Error);
+			NumErrors++;
+		}
+	}
+
+	if (NumErrors != 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("[%d] levels are malformed. The level pack was not written"), NumErrors);
+		return 1;
+	}
+
+	TArray<uint8> Bytes;
+	Builder.Write(Bytes);
+	if (!FFileHelper::SaveArrayToFile(Bytes, *OutputPath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to write the level pack to [%s]"), *OutputPath);
+		return 1;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Wrote [%d] levels in [%d] bytes to [%s]"), Builder.GetNumLevels(), Bytes.Num(), *OutputPath);
+	return 0;
+}
+
+bool UMatchThreeLevelPackCommandlet::ParseLevel(const FString& Json, FLevelDescription& OutLevel, FString& OutError) const
+{
+	TSharedPtr<FJsonObject> Root;
+	if (!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Json), Root) || !Root.IsValid())
+	{
+		OutError = TEXT("Not valid JSON");
+		return false;
+	}
+
+	const TArray<TSharedPtr<FJsonValue>>* Rows = nullptr;
+	if (!Root->TryGetNumberField(TEXT("types"), OutLevel.NumTypes) || !Root->TryGetArrayField(TEXT("rows"), Rows) || Rows->IsEmpty())
+	{
+		OutError = TEXT("Missing types or rows");
+		return false;
+	}
+	Root->TryGetNumberField(TEXT("moveLimit"), OutLevel.MoveLimit);
+
+	OutLevel.Height = Rows->Num();
+	OutLevel.Width = (*Rows)[0]->AsString().Len();
+	OutLevel.Mask.Init(true, OutLevel.Width * OutLevel.Height);
+	OutLevel.Cells.Init(LevelPack::RandomCell, OutLevel.Width * OutLevel.Height);
+
+	for (int32 RowIndex = 0; RowIndex < Rows->Num(); RowIndex++)
+	{
+		const FString Row = (*Rows)[RowIndex]->AsString();
+		if (Row.Len() != OutLevel.Width)
+		{
+			OutError = FString::Printf(TEXT("Row [%d] is not [%d] cells wide"), RowIndex, OutLevel.Width);
+			return false;
+		}
+
+		// The first row is the top of the board
+		const int32 Y = OutLevel.Height - 1 - RowIndex;
+		for (int32 X = 0; X < OutLevel.Width; X++)
+		{
+			const int32 CellIndex = X * OutLevel.Height + Y;
+			const TCHAR Cell = Row[X];
+			if (FChar::IsDigit(Cell))
+			{
+				OutLevel.Cells[CellIndex] = static_cast<uint8>(Cell - TEXT('0'));
+			}
+			else if (Cell == TEXT('#'))
+			{
+				OutLevel.Mask[CellIndex] = false;
+			}
+			else if (Cell != TEXT('.'))
+			{
+				OutError = FString::Printf(TEXT("Unknown cell [%c] in row [%d]"), Cell, RowIndex);
+				return false;
+			}
+		}
+	}
+
+	// Columns without a spawn sequence refill at random
+	OutLevel.SpawnSequences.SetNum(OutLevel.Width);
+	const TArray<TSharedPtr<FJsonValue>>* Spawn = nullptr;
+	if (Root->TryGetArrayField(TEXT("spawn"), Spawn))
+	{
+		for (int32 Column = 0; Column < FMath::Min(Spawn->Num(), OutLevel.Width); Column++)
+		{
+			for (const TSharedPtr<FJsonValue>& TypeId : (*Spawn)[Column]->AsArray())
+			{
+				OutLevel.SpawnSequences[Column].Add(static_cast<uint8>(TypeId->AsNumber()));
+			}
+		}
+	}
+
+	const TArray<TSharedPtr<FJsonValue>>* Goals = nullptr;
+	if (Root->TryGetArrayField(TEXT("goals"), Goals))
+	{
+		for (const TSharedPtr<FJsonValue>& GoalValue : *Goals)
+		{
+			const TSharedPtr<FJsonObject> GoalObject = GoalValue->AsObject();
+			FLevelGoal& Goal = OutLevel.Goals.AddDefaulted_GetRef();
+			int32 TypeId = 0;
+			if (GoalObject->TryGetNumberField(TEXT("score"), Goal.Target))
+			{
+				Goal.Type = ELevelGoalType::Score;
+			}
+			else if (GoalObject->TryGetNumberField(TEXT("clear"), TypeId) && GoalObject->TryGetNumberField(TEXT("target"), Goal.Target))
+			{
+				Goal.Type = ELevelGoalType::ClearGems;
+				Goal.TypeId = static_cast<uint8>(TypeId);
+			}
+			else
+			{
+				OutError = TEXT("A goal needs a score, or a gem type to clear and a target");
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
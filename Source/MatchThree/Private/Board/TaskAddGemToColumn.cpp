@@ -3,6 +3,7 @@
 
 #include "Board/TaskAddGemToColumn.h"
 #include "GameBoard.h"
+#include "Profiling/MatchThreeStats.h"
 
 void UTaskAddGemsToColumn::Init(AGameBoard* InGameBoard, int32 InColumn, int32 InNumberToAdd, float InTimerRate)
 {
@@ -14,11 +15,13 @@ void UTaskAddGemsToColumn::Init(AGameBoard* InGameBoard, int32 InColumn, int32 I
 
 void UTaskAddGemsToColumn::Execute()
 {
-	GetWorld()->GetTimerManager().SetTimer(TimerHandle, this, &UTaskAddGemsToColumn::TimerCallback, TimerRate, true, 0.f);
+	SetTaskTimer(TimerHandle, FTimerDelegate::CreateUObject(this, &UTaskAddGemsToColumn::TimerCallback), TimerRate);
 }
 
 void UTaskAddGemsToColumn::TimerCallback()
 {
+	MATCHTHREE_SCOPE_CYCLE_COUNTER(STAT_MatchThree_AddGems);
+
 	if (NumberAdded < NumberToAdd)
 	{
 		GameBoard->SpawnGemInColumn(Column);
@@ -26,6 +29,7 @@ void UTaskAddGemsToColumn::TimerCallback()
 	}
 	else
 	{
+		ClearTaskTimer(TimerHandle);
 		Complete();
 	}
 }
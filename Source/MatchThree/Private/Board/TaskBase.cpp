@@ -3,8 +3,87 @@
 
 #include "Board/TaskBase.h"
 
+#include "Engine/World.h"
+#include "Profiling/EventRecorder.h"
+#include "Profiling/MatchThreeStats.h"
+
+int32 UTaskBase::NumActiveTimers = 0;
+
+void UTaskBase::PostInitProperties()
+{
+	Super::PostInitProperties();
+
+	if (!HasAnyFlags(RF_ClassDefaultObject))
+	{
+		MATCHTHREE_COUNTER_INC(LiveTasks);
+	}
+}
+
+void UTaskBase::BeginDestroy()
+{
+	// The timer manager drops timers whose object is gone, so only the counts need to be released
+	if (!TaskTimers.IsEmpty())
+	{
+		MATCHTHREE_COUNTER_SUB(ActiveTimers, TaskTimers.Num());
+		NumActiveTimers -= TaskTimers.Num();
+		TaskTimers.Empty();
+	}
+
+	if (!HasAnyFlags(RF_ClassDefaultObject))
+	{
+		MATCHTHREE_COUNTER_DEC(LiveTasks);
+	}
+
+	Super::BeginDestroy();
+}
+
+void UTaskBase::SetTaskTimer(FTimerHandle& TimerHandle, FTimerDelegate const& Delegate, float Rate)
+{
+	FTimerManager& TimerManager = GetWorld()->GetTimerManager();
+	if (!TimerManager.IsTimerActive(TimerHandle))
+	{
+		MATCHTHREE_COUNTER_INC(ActiveTimers);
+		NumActiveTimers++;
+	}
+	TimerManager.SetTimer(TimerHandle, Delegate, Rate, true, 0.f);
+	TaskTimers.AddUnique(TimerHandle);
+}
+
+void UTaskBase::ClearTaskTimer(FTimerHandle& TimerHandle)
+{
+	TaskTimers.Remove(TimerHandle);
+
+	UWorld* World = GetWorld();
+	if (!World)
+	{
+		return;
+	}
+
+	FTimerManager& TimerManager = World->GetTimerManager();
+	if (TimerManager.IsTimerActive(TimerHandle))
+	{
+		MATCHTHREE_COUNTER_DEC(ActiveTimers);
+		NumActiveTimers--;
+	}
+	TimerManager.ClearTimer(TimerHandle);
+}
+
 void UTaskBase::Complete()
 {
+	// Listeners hold resources for the task so only tell them once
+	if (bIsComplete) return;
+
 	bIsComplete = true;
+
+	// Timers are cleared by the task when it finishes, but a completed task must never tick again whatever path it took
+	while (!TaskTimers.IsEmpty())
+	{
+		FTimerHandle TimerHandle = TaskTimers.Last();
+		ClearTaskTimer(TimerHandle);
+	}
+
+	MATCHTHREE_RECORD_EVENT(TaskCompleted, static_cast<int32>(GetUniqueID()));
+
+	MATCHTHREE_SCOPE_CYCLE_COUNTER(STAT_MatchThree_Broadcast);
 	OnTaskComplete.Broadcast();
 }
@@ -5,21 +5,23 @@
 
 #include "Board/TaskAddGemToColumn.h"
 #include "Board/TaskCollapseColumn.h"
+#include "Profiling/MatchThreeMemory.h"
 
 void UTaskCollapseAndFill::Execute()
 {
 	TaskCollapseColumn->Execute();
 }
 
-void UTaskCollapseAndFill::Init(AGameBoard* InGameBoard, int32 InColumn, int32 InNumberToAdd, float InTimerRate)
+void UTaskCollapseAndFill::Init(AGameBoard* InGameBoard, int32 InColumn, int32 InFirstRow, int32 InNumberToAdd, float InTimerRate)
 {
 	GameBoard = InGameBoard;
 	Column = InColumn;
 	NumberToAdd = InNumberToAdd;
 	TimerRate = InTimerRate;
 
+	MATCHTHREE_LLM_SCOPE(Tasks);
 	TaskCollapseColumn = NewObject<UTaskCollapseColumn>(this);
-	TaskCollapseColumn->Init(GameBoard, Column, TimerRate);
+	TaskCollapseColumn->Init(GameBoard, Column, InFirstRow);
 
 	TaskAddGemsToColumn = NewObject<UTaskAddGemsToColumn>(this);
 	TaskAddGemsToColumn->Init(GameBoard, Column, NumberToAdd, TimerRate);
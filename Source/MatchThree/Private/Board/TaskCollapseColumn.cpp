@@ -4,33 +4,16 @@
 #include "Board/TaskCollapseColumn.h"
 #include "GameBoard.h"
 
-void UTaskCollapseColumn::Init(AGameBoard* InGameBoard, int32 InColumn, float InTimerRate)
+void UTaskCollapseColumn::Init(AGameBoard* InGameBoard, int32 InColumn, int32 InFirstRow)
 {
 	GameBoard = InGameBoard;
 	Column = InColumn;
-	TimerRate = InTimerRate;
+	FirstRow = InFirstRow;
 }
 
 void UTaskCollapseColumn::Execute()
 {
-	GetWorld()->GetTimerManager().SetTimer(TimerHandle, this, &UTaskCollapseColumn::TimerCallback, TimerRate, true, 0.f);
-}
-
-void UTaskCollapseColumn::TimerCallback()
-{
-	// Find the next location that can move down
-	while (CurrentRow < GameBoard->GetBoardHeight() && !GameBoard->CanMoveDown({ Column, CurrentRow }))
-	{
-		CurrentRow++;
-	}
-
-	if (CurrentRow < GameBoard->GetBoardHeight())
-	{
-		GameBoard->MoveGemDown({ Column, CurrentRow });
-		CurrentRow++;
-	}
-	else
-	{
-		Complete();
-	}
+	// Every gem is given its final row and starts falling this frame, so the column needs no timer
+	GameBoard->CompactColumn(Column, FirstRow);
+	Complete();
 }
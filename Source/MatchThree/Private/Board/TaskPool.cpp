@@ -4,14 +4,17 @@
 #include "Board/TaskPool.h"
 
 #include "Board/TaskBase.h"
+#include "Profiling/GrowthTracker.h"
+#include "Profiling/EventRecorder.h"
+#include "Profiling/MatchThreeStats.h"
 
 void UTaskPool::AddTask(UTaskBase* InTask)
 {
-	// Clean the list if it's full
-	if (Tasks.Num() >= MaxTasks)
-	{
-		Clean();
-	}
+	MATCHTHREE_SCOPE_CYCLE_COUNTER(STAT_MatchThree_TaskPool);
+	MATCHTHREE_RECORD_EVENT(TaskStarted, static_cast<int32>(InTask->GetUniqueID()));
+
+	// Release completed tasks as we go so they can be collected, rather than holding them until the pool is full
+	Clean();
 
 	// Look for an empty space for the task
 	for (int i = 0; i < Tasks.Num(); i++)
@@ -34,8 +37,29 @@ void UTaskPool::AddTask(UTaskBase* InTask)
 	}
 }
 
+int32 UTaskPool::GetNumActiveTasks() const
+{
+	int32 NumActiveTasks = 0;
+	for (const UTaskBase* Task : Tasks)
+	{
+		if (Task && !Task->IsComplete())
+		{
+			NumActiveTasks++;
+		}
+	}
+	return NumActiveTasks;
+}
+
+void UTaskPool::SampleGrowth(FGrowthTracker& Tracker) const
+{
+	Tracker.Record(TEXT("PoolSlots"), TEXT("TaskPool"), Tasks.Num());
+	Tracker.Record(TEXT("ActiveTasks"), TEXT("TaskPool"), GetNumActiveTasks());
+}
+
 void UTaskPool::Clean()
 {
+	MATCHTHREE_SCOPE_CYCLE_COUNTER(STAT_MatchThree_TaskPool);
+
 	for (int i = 0; i < Tasks.Num(); i++)
 	{
 		if (Tasks[i] && Tasks[i]->IsComplete())
@@ -7,6 +7,12 @@ void UGemMovementComponent::TickComponent(float DeltaTime, ELevelTick TickType,
 {
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
 
+	if (bIsMoving && StartDelay > 0.f)
+	{
+		StartDelay -= DeltaTime;
+		return;
+	}
+
 	if (bIsMoving)
 	{
         const FVector CurrentLocation = GetOwner()->GetActorLocation();
@@ -36,10 +42,20 @@ void UGemMovementComponent::TickComponent(float DeltaTime, ELevelTick TickType,
 	}
 }
 
-void UGemMovementComponent::MoveTo(const FVector& NewLocation)
+void UGemMovementComponent::MoveTo(const FVector& NewLocation, float Delay)
 {
 	bIsMoving = true;
 	TargetLocation = NewLocation;
+
+	// A gem already on its way keeps going rather than pausing mid air
+	StartDelay = Velocity.IsNearlyZero() ? Delay : 0.f;
+}
+
+void UGemMovementComponent::Stop()
+{
+	bIsMoving = false;
+	StartDelay = 0.f;
+	Velocity = FVector::ZeroVector;
 }
 
 void UGemMovementComponent::FinishMoveTo()
@@ -0,0 +1,74 @@
+// Copyright Peter Carsten Collins (2024)
+
+
+#include "Core/MatchThreeAutoPlayer.h"
+
+#include "Core/MatchThreeGameMode.h"
+#include "GameBoard.h"
+#include "GemBase.h"
+
+void UMatchThreeAutoPlayer::Init(AMatchThreeGameMode* InGameMode, int32 Seed)
+{
+	GameMode = InGameMode;
+	GameBoard = GameMode->GetGameBoard();
+	Random.Initialize(Seed);
+	TimeUntilSwap = SwapInterval;
+	NumSwaps = 0;
+}
+
+void UMatchThreeAutoPlayer::Tick(float DeltaSeconds)
+{
+	TimeUntilSwap -= DeltaSeconds;
+	if (TimeUntilSwap > 0.f)
+	{
+		return;
+	}
+	TimeUntilSwap += SwapInterval;
+
+	const bool bMustMatch = Random.FRand() >= InvalidSwapFraction;
+	FBoardLocation LocationA;
+	FBoardLocation LocationB;
+	if (FindSwap(bMustMatch, LocationA, LocationB))
+	{
+		GameMode->SwapGems(GameBoard->GetGem(LocationA), GameBoard->GetGem(LocationB), GameMode->GetLatencyTracker().BeginSpan());
+		NumSwaps++;
+	}
+}
+
+bool UMatchThreeAutoPlayer::FindSwap(bool bMustMatch, FBoardLocation& OutLocationA, FBoardLocation& OutLocationB)
+{
+	auto IsSettled = [this](const FBoardLocation& Location)
+		{
+			return GameBoard->GetCellState(Location) == ECellState::Settled;
+		};
+
+	const int32 Width = GameBoard->GetBoardWidth();
+	const int32 Height = GameBoard->GetBoardHeight();
+	const int32 NumCells = Width * Height;
+	const int32 FirstCell = Random.RandHelper(NumCells);
+
+	for (int32 Offset = 0; Offset < NumCells; Offset++)
+	{
+		const int32 Cell = (FirstCell + Offset) % NumCells;
+		const FBoardLocation LocationA(Cell % Width, Cell / Width);
+
+		// Only look right and up so every pair is tried once
+		const FBoardLocation Neighbours[] = { { LocationA.X + 1, LocationA.Y }, { LocationA.X, LocationA.Y + 1 } };
+		for (const FBoardLocation& LocationB : Neighbours)
+		{
+			if (!GameBoard->IsValidLocation(LocationB) || !IsSettled(LocationA) || !IsSettled(LocationB))
+			{
+				continue;
+			}
+			if (bMustMatch && !GameBoard->WouldSwapMatch(LocationA, LocationB))
+			{
+				continue;
+			}
+
+			OutLocationA = LocationA;
+			OutLocationB = LocationB;
+			return true;
+		}
+	}
+	return false;
+}
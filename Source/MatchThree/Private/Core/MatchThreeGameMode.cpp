@@ -4,14 +4,35 @@
 #include "Core/MatchThreeGameMode.h"
 
 #include "GameBoard.h"
+#include "Board/BoardSnapshot.h"
+#include "Board/CascadeArena.h"
 #include "Board/Match.h"
+#include "Board/TaskBase.h"
 #include "Board/TaskPool.h"
 #include "Board/TaskAddGemToColumn.h"
 #include "Board/TaskCollapseAndFill.h"
+#include "Profiling/AllocationCounter.h"
+#include "Profiling/EventRecorder.h"
+#include "Profiling/GrowthTracker.h"
+#include "Profiling/MatchThreePerfRun.h"
+#include "Profiling/MatchThreeSoakRun.h"
+#include "Profiling/MatchThreeMemory.h"
+#include "Profiling/MatchThreeStats.h"
 #include "Score/ScoreActor.h"
+#include "Tasks/TaskRejectSwap.h"
 #include "Tasks/TaskSwapGems.h"
 #include "Tasks/TaskSequential.h"
+#include "Async/Async.h"
+#include "HAL/FileManager.h"
 #include "Kismet/GameplayStatics.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+AMatchThreeGameMode::AMatchThreeGameMode()
+{
+	PrimaryActorTick.bCanEverTick = true;
+}
 
 void AMatchThreeGameMode::BeginPlay()
 {
@@ -21,42 +42,916 @@ void AMatchThreeGameMode::StartPlay()
 {
 	Super::StartPlay();
 
+	FMatchThreeEventRecorder::Get().Start();
+
+	if (bRecordMoveAnalytics)
+	{
+		AnalyticsWriter = MakeUnique<FMoveAnalyticsWriter>();
+		AnalyticsWriter->Start(static_cast<int64>(MaxAnalyticsMegabytes) * 1024 * 1024);
+	}
+
 	// Collect dependencies
-	TaskPool = NewObject<UTaskPool>(this);
+	{
+		MATCHTHREE_LLM_SCOPE(Tasks);
+		TaskPool = NewObject<UTaskPool>(this);
+	}
 	GameBoard = Cast<AGameBoard>(UGameplayStatics::GetActorOfClass(this, AGameBoard::StaticClass()));
 
-	GameBoard->OnMatchFoundDelegate.AddUniqueDynamic(this, &AMatchThreeGameMode::HandleMatchesFound);
+	GameBoard->OnMatchFoundDelegate.AddUniqueDynamic(this, &AMatchThreeGameMode::HandleMatchesFound);
+
+	LevelPack.Open(FPaths::ProjectContentDir() / LevelPackPath);
+
+	// Scripted runs always start from a fresh board and must not overwrite the player's save
+	const bool bPerfRun = FParse::Param(FCommandLine::Get(), TEXT("MatchThreePerfRun"));
+	const bool bSoakRun = FParse::Param(FCommandLine::Get(), TEXT("MatchThreeSoak"));
+	if (bPerfRun || bSoakRun)
+	{
+		bContinueSavedGame = false;
+		bSaveOnSuspend = false;
+	}
+
+	// Soak runs prove that the match pipeline stays off the heap. Perf runs leave the allocator alone, since the proxy would be
+	// part of the frame times they measure
+	if (bSoakRun || FParse::Param(FCommandLine::Get(), TEXT("MatchThreeCountAllocations")))
+	{
+		FAllocationCounter::Install();
+		CascadeStartAllocations = FAllocationCounter::GetThreadCount();
+	}
+
+	if (!bContinueSavedGame || !LoadSaveFile())
+	{
+		FillBoard();
+	}
+
+	if (bSaveOnSuspend)
+	{
+		EnterBackgroundHandle = FCoreDelegates::ApplicationWillEnterBackgroundDelegate.AddUObject(this, &AMatchThreeGameMode::HandleEnterBackground);
+	}
+
+	if (bPerfRun)
+	{
+		PerfRun = NewObject<UMatchThreePerfRun>(this);
+		PerfRun->Init(this, FCommandLine::Get());
+	}
+	else if (bSoakRun)
+	{
+		SoakRun = NewObject<UMatchThreeSoakRun>(this);
+		SoakRun->Init(this, FCommandLine::Get());
+	}
+}
+
+void AMatchThreeGameMode::FillBoard()
+{
+	ColumnLocks.Init(GameBoard->GetBoardWidth());
+	ColumnSpans.Init(0, GameBoard->GetBoardWidth());
+	PendingClears.Reset();
+
+	if (bWarmStart)
+	{
+		GameBoard->PlaceInitialGems(bPlayIntroDrop);
+		return;
+	}
+
+	// Fill the columns
+	for (int Column = 0; Column < GameBoard->GetBoardWidth(); Column++)
+	{
+		MATCHTHREE_LLM_SCOPE(Tasks);
+		UTaskAddGemsToColumn* Task = NewObject<UTaskAddGemsToColumn>(this);
+		TaskPool->AddTask(Task);
+		Task->Init(GameBoard, Column, GameBoard->GetBoardHeight(), .2f);
+		LockColumnForTask(Task, Column);
+		Task->Execute();
+	}
+}
+
+void AMatchThreeGameMode::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	LatencyTracker.LogReport();
+	FMatchThreeEventRecorder::Get().Stop();
+
+	if (bSaveOnSuspend)
+	{
+		FCoreDelegates::ApplicationWillEnterBackgroundDelegate.Remove(EnterBackgroundHandle);
+		SaveBoard();
+	}
+	if (PendingSave.IsValid())
+	{
+		PendingSave.Wait();
+	}
+
+	StopBoardWorker();
+
+	if (AnalyticsWriter)
+	{
+		AnalyticsWriter->Shutdown();
+		AnalyticsWriter.Reset();
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AMatchThreeGameMode::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	TRACE_COUNTER_SET(MatchThree_MatchesPerFrame, 0);
+	TRACE_COUNTER_SET(MatchThree_MatchAllocations, 0);
+
+	// Queued swaps wait for their gems to settle
+	if (!SwapQueue.IsEmpty())
+	{
+		ProcessSwapQueue();
+	}
+
+	if (BoardWorker)
+	{
+		// The worker resolves matches and dead boards itself
+		PresentBoardEvents();
+	}
+	else
+	{
+		if (!SettlingSpans.IsEmpty())
+		{
+			UpdateSettlingSpans();
+		}
+		ResolveDirtyMatches();
+		TryEndDelta();
+		CheckForDeadBoard();
+
+		if (bRunBoardOnWorker)
+		{
+			StartBoardWorker();
+		}
+	}
+	ResetCascadeArena();
+
+	if (PerfRun)
+	{
+		PerfRun->Tick(DeltaSeconds);
+	}
+	if (SoakRun)
+	{
+		SoakRun->Tick(DeltaSeconds);
+	}
+}
+
+void AMatchThreeGameMode::ResolveDirtyMatches()
+{
+	// A clean board has nothing new to match
+	if (!GameBoard || GameBoard->GetDirtyRegion().IsClean() || !IsBoardSettled() || !GameBoard->IsSettled())
+	{
+		return;
+	}
+
+	FCascadeArenaScope ArenaScope;
+	TCascadeArray<FMatch> Matches;
+	GameBoard->FindMatches(Matches);
+	if (!Matches.IsEmpty())
+	{
+		ResolveMatches(Matches, 0);
+	}
+}
+
+void AMatchThreeGameMode::ResetCascadeArena()
+{
+	// Each cascade step rewinds the arena itself. Resetting here as well keeps a step that missed its scope from growing it
+	FCascadeArena& Arena = FCascadeArena::Get();
+	Arena.Reset();
+
+	// Heap allocations are still reported once per cascade
+	if (!GameBoard || !IsBoardSettled() || !GameBoard->IsSettled())
+	{
+		return;
+	}
+
+	if (FAllocationCounter::IsInstalled())
+	{
+		const uint64 Allocations = FAllocationCounter::GetThreadCount() - CascadeStartAllocations;
+		if (Allocations > 0)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Cascade made [%llu] heap allocations in the match pipeline, with [%llu] bytes of the arena at its peak"),
+				Allocations, static_cast<uint64>(Arena.GetPeakBytesUsed()));
+		}
+		CascadeStartAllocations = FAllocationCounter::GetThreadCount();
+	}
+}
+
+void AMatchThreeGameMode::CheckForDeadBoard()
+{
+	// Only look again once the board has changed and everything has landed
+	if (!GameBoard || GameBoard->GetRevision() == DeadBoardCheckRevision || !IsBoardSettled() || !GameBoard->IsSettled())
+	{
+		return;
+	}
+	DeadBoardCheckRevision = GameBoard->GetRevision();
+
+	if (GameBoard->CountLegalMoves(1) > 0)
+	{
+		return;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("No legal moves left. Reshuffling the board"));
+	ClearUndoHistory();
+	if (!GameBoard->Reshuffle())
+	{
+		// Too few gems of each type to rearrange, so start again with a fresh board
+		RestartBoard(GameBoard->GetBoardWidth(), GameBoard->GetBoardHeight());
+	}
+}
+
+void AMatchThreeGameMode::StartBoardWorker()
+{
+	if (BoardWorker || !IsBoardSettled() || !GameBoard->IsSettled() || !GameBoard->GetDirtyRegion().IsClean() || GameBoard->IsRecordingDelta())
+	{
+		return;
+	}
+
+	FBoardSnapshot Snapshot;
+	GameBoard->CaptureSnapshot(Snapshot);
+	BoardWorker = MakeUnique<FBoardWorker>();
+	BoardWorker->Start(Snapshot, GameBoard->GetRegistry());
+	GameBoard->SetPresentationOnly(true);
+
+	// Moves on the worker are not recorded, so older moves no longer undo onto the board
+	ClearUndoHistory();
+}
+
+void AMatchThreeGameMode::StopBoardWorker()
+{
+	if (!BoardWorker)
+	{
+		return;
+	}
+
+	BoardWorker->Shutdown();
+	BoardWorker.Reset();
+	NumWorkerMoves = 0;
+	bBoardStepOpen = false;
+	GameBoard->SetPresentationOnly(false);
+}
+
+void AMatchThreeGameMode::PresentBoardEvents()
+{
+	MATCHTHREE_SCOPE_CYCLE_COUNTER(STAT_MatchThree_PresentBoardEvents);
+
+	FBoardEvent Event;
+	while (BoardWorker)
+	{
+		// Each step waits for the gems of the step before it to land. A step the worker is still writing carries on at once
+		if (!bBoardStepOpen && !GameBoard->IsSettled())
+		{
+			return;
+		}
+		if (!BoardWorker->PopEvent(Event))
+		{
+			return;
+		}
+
+		switch (Event.Type)
+		{
+		case EBoardEventType::SwapAccepted:
+		{
+			MATCHTHREE_LLM_SCOPE(Tasks);
+			UTaskSwapGems* TaskSwapGems = NewObject<UTaskSwapGems>(this);
+			TaskSwapGems->Init(GameBoard, Event.Location, Event.Target);
+			TaskPool->AddTask(TaskSwapGems);
+			TaskSwapGems->Execute();
+			LatencyTracker.MarkPhase(Event.SpanId, EActionPhase::Feedback);
+			bBoardStepOpen = true;
+			break;
+		}
+		case EBoardEventType::SwapRejected:
+			RejectSwap(Event.Location, Event.Target);
+			LatencyTracker.MarkPhase(Event.SpanId, EActionPhase::Feedback);
+			break;
+		case EBoardEventType::Score:
+		{
+			const int32 Points = Event.NumGems * PointsPerGem;
+			Score += Points;
+			MATCHTHREE_COUNTER_ADD(MatchesPerFrame, 1);
+			if (FMoveRecord* Move = PendingMoves.Find(Event.SpanId))
+			{
+				Move->CascadeDepth = static_cast<uint8>(FMath::Min<int32>(Move->CascadeDepth + 1, MAX_uint8));
+				Move->ScoreDelta += Points;
+				Move->bMatched = true;
+			}
+
+			MATCHTHREE_LLM_SCOPE(FX);
+			AScoreActor* ScoreActor = GetWorld()->SpawnActor<AScoreActor>(ScoreActorClass);
+			ScoreActor->SetActorLocation(GameBoard->GetWorldLocation(Event.Location));
+			bBoardStepOpen = true;
+			break;
+		}
+		case EBoardEventType::StepEnd:
+			bBoardStepOpen = false;
+			break;
+		case EBoardEventType::Settled:
+			GameBoard->ApplyBoardEvent(Event);
+			NumWorkerMoves = FMath::Max(NumWorkerMoves - 1, 0);
+			LatencyTracker.MarkPhase(Event.SpanId, EActionPhase::Resolved);
+			SettleMove(Event.SpanId);
+			ProcessSwapQueue();
+			break;
+		case EBoardEventType::DeadBoard:
+			// The game thread reshuffles the board and hands it back once it settles
+			StopBoardWorker();
+			break;
+		default:
+			GameBoard->ApplyBoardEvent(Event);
+			bBoardStepOpen = true;
+			break;
+		}
+	}
+}
+
+bool AMatchThreeGameMode::IsBoardSettled() const
+{
+	return SwapQueue.IsEmpty() && ActiveSwaps.IsEmpty() && ColumnTasks.IsEmpty() && PendingClears.IsEmpty() && NumWorkerMoves == 0;
+}
+
+bool AMatchThreeGameMode::RestartBoard(int32 Width, int32 Height, int32 Seed)
+{
+	if (!IsBoardSettled())
+	{
+		return false;
+	}
+
+	StopBoardWorker();
+	SwapPrediction = FSwapPrediction();
+	ClearUndoHistory();
+	GameBoard->ResetBoard(Width, Height, Seed);
+	FillBoard();
+	return true;
+}
+
+int32 AMatchThreeGameMode::GetNumActiveTasks() const
+{
+	return TaskPool ? TaskPool->GetNumActiveTasks() : 0;
+}
+
+void AMatchThreeGameMode::SampleGrowth(FGrowthTracker& Tracker) const
+{
+	Tracker.Record(TEXT("SwapQueue"), TEXT("GameMode"), SwapQueue.Num());
+	Tracker.Record(TEXT("ActiveSwaps"), TEXT("GameMode"), ActiveSwaps.Num());
+	Tracker.Record(TEXT("ColumnTasks"), TEXT("GameMode"), ColumnTasks.Num());
+	Tracker.Record(TEXT("PendingClears"), TEXT("GameMode"), PendingClears.Num());
+	Tracker.Record(TEXT("PendingMoves"), TEXT("Analytics"), PendingMoves.Num());
+	Tracker.Record(TEXT("OpenSpans"), TEXT("Latency"), LatencyTracker.GetNumOpenSpans());
+	Tracker.Record(TEXT("UndoMoves"), TEXT("Undo"), UndoStack.Num() + RedoStack.Num());
+
+	GameBoard->SampleGrowth(Tracker);
+	TaskPool->SampleGrowth(Tracker);
+}
+
+void AMatchThreeGameMode::CaptureSnapshot(FBoardSnapshot& OutSnapshot) const
+{
+	GameBoard->CaptureSnapshot(OutSnapshot);
+	OutSnapshot.Score = Score;
+	OutSnapshot.Swaps.Reset();
+
+	auto AddSwap = [&OutSnapshot](const FSwapPair& SwapAction)
+	{
+		FSnapshotSwap& Swap = OutSnapshot.Swaps.AddDefaulted_GetRef();
+		Swap.LocationAX = static_cast<int16>(SwapAction.LocationA.X);
+		Swap.LocationAY = static_cast<int16>(SwapAction.LocationA.Y);
+		Swap.LocationBX = static_cast<int16>(SwapAction.LocationB.X);
+		Swap.LocationBY = static_cast<int16>(SwapAction.LocationB.Y);
+	};
+
+	for (const TSharedPtr<FSwapPair>& SwapAction : ActiveSwaps)
+	{
+		// A swap being undone has already put its gems back, so it is finished as far as the board is concerned
+		if (SwapAction->bUndoing)
+		{
+			continue;
+		}
+
+		// The moving swap has already exchanged its cells. Put them back so the swap runs again from the start on restore
+		const int32 IndexA = OutSnapshot.GetIndex(SwapAction->LocationA.X, SwapAction->LocationA.Y);
+		const int32 IndexB = OutSnapshot.GetIndex(SwapAction->LocationB.X, SwapAction->LocationB.Y);
+		Swap(OutSnapshot.Cells[IndexA], OutSnapshot.Cells[IndexB]);
+		AddSwap(*SwapAction);
+	}
+
+	for (const TSharedPtr<FSwapPair>& SwapAction : SwapQueue)
+	{
+		AddSwap(*SwapAction);
+	}
+}
+
+bool AMatchThreeGameMode::RestoreSnapshot(const FBoardSnapshot& Snapshot)
+{
+	MATCHTHREE_SCOPE_CYCLE_COUNTER(STAT_MatchThree_RestoreSnapshot);
+
+	if (!IsBoardSettled())
+	{
+		return false;
+	}
+
+	StopBoardWorker();
+
+	const double StartTime = FPlatformTime::Seconds();
+	if (!GameBoard->RestoreSnapshot(Snapshot))
+	{
+		return false;
+	}
+
+	SwapPrediction = FSwapPrediction();
+	ClearUndoHistory();
+	ColumnLocks.Init(GameBoard->GetBoardWidth());
+	ColumnSpans.Init(0, GameBoard->GetBoardWidth());
+	PendingClears.Reset();
+	Score = Snapshot.Score;
+
+	// A refilled cascade can leave matches behind. They resolve before the restored swaps, which wait for their columns
+	FCascadeArenaScope ArenaScope;
+	TCascadeArray<FMatch> Matches;
+	GameBoard->FindMatches(Matches);
+	if (!Matches.IsEmpty())
+	{
+		ResolveMatches(Matches, 0);
+	}
+
+	for (const FSnapshotSwap& Swap : Snapshot.Swaps)
+	{
+		AGemBase* GemA = GameBoard->GetGem(FBoardLocation(Swap.LocationAX, Swap.LocationAY));
+		AGemBase* GemB = GameBoard->GetGem(FBoardLocation(Swap.LocationBX, Swap.LocationBY));
+		if (GemA && GemB)
+		{
+			SwapGems(GemA, GemB);
+		}
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Restored a [%dx%d] board in [%.3f ms]"), Snapshot.Width, Snapshot.Height, (FPlatformTime::Seconds() - StartTime) * 1000.);
+	return true;
+}
+
+FString AMatchThreeGameMode::GetSaveFilePath() const
+{
+	return FPaths::ProjectSavedDir() / TEXT("SaveGames") / TEXT("Board.m3sn");
+}
+
+void AMatchThreeGameMode::SaveBoard()
+{
+	if (!GameBoard)
+	{
+		return;
+	}
+
+	// Capturing and packing the snapshot is the only work done on the game thread
+	TArray<uint8> Bytes;
+	{
+		MATCHTHREE_SCOPE_CYCLE_COUNTER(STAT_MatchThree_SaveSnapshot);
+		FBoardSnapshot Snapshot;
+		CaptureSnapshot(Snapshot);
+		Snapshot.Write(Bytes);
+	}
+
+	// Saves share a temporary file, so a save still being written finishes first
+	if (PendingSave.IsValid())
+	{
+		PendingSave.Wait();
+	}
+
+	PendingSave = Async(EAsyncExecution::ThreadPool, [Bytes = MoveTemp(Bytes), FileName = GetSaveFilePath()]()
+		{
+			// Write beside the save and move it into place so a save interrupted by a suspend never replaces a good one
+			const FString TempFileName = FileName + TEXT(".tmp");
+			if (FFileHelper::SaveArrayToFile(Bytes, *TempFileName) && IFileManager::Get().Move(*FileName, *TempFileName))
+			{
+				UE_LOG(LogTemp, Display, TEXT("Saved [%d] bytes to [%s]"), Bytes.Num(), *FileName);
+			}
+			else
+			{
+				UE_LOG(LogTemp, Error, TEXT("Failed to write save [%s]"), *FileName);
+			}
+		});
+}
+
+void AMatchThreeGameMode::LoadBoard()
+{
+	if (!LoadSaveFile())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Could not load [%s]"), *GetSaveFilePath());
+	}
+}
+
+bool AMatchThreeGameMode::LoadSaveFile()
+{
+	// The save is a few hundred bytes so reading it on the game thread is cheaper than waiting a frame for it
+	if (PendingSave.IsValid())
+	{
+		PendingSave.Wait();
+	}
+
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *GetSaveFilePath(), FILEREAD_Silent))
+	{
+		return false;
+	}
+
+	FBoardSnapshot Snapshot;
+	if (!Snapshot.Read(Bytes))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Ignoring save [%s] that is corrupt or from another version"), *GetSaveFilePath());
+		return false;
+	}
+
+	return RestoreSnapshot(Snapshot);
+}
+
+void AMatchThreeGameMode::UndoMove()
+{
+	if (!CanUndo())
+	{
+		UE_LOG(LogTemp, Display, TEXT("Nothing to undo"));
+		return;
+	}
+
+	FBoardDelta Delta = UndoStack.Pop();
+	GameBoard->ApplyDelta(Delta, true);
+	Score -= Delta.ScoreDelta;
+	RedoStack.Add(MoveTemp(Delta));
+}
+
+void AMatchThreeGameMode::RedoMove()
+{
+	if (!CanRedo())
+	{
+		UE_LOG(LogTemp, Display, TEXT("Nothing to redo"));
+		return;
+	}
+
+	FBoardDelta Delta = RedoStack.Pop();
+	GameBoard->ApplyDelta(Delta, false);
+	Score += Delta.ScoreDelta;
+	UndoStack.Add(MoveTemp(Delta));
+}
+
+bool AMatchThreeGameMode::CanUndo() const
+{
+	return !UndoStack.IsEmpty() && CanApplyDelta();
+}
+
+bool AMatchThreeGameMode::CanRedo() const
+{
+	return !RedoStack.IsEmpty() && CanApplyDelta();
+}
+
+bool AMatchThreeGameMode::CanApplyDelta() const
+{
+	return GameBoard && !BoardWorker && !GameBoard->IsRecordingDelta() && IsBoardSettled() && GameBoard->IsSettled();
+}
+
+void AMatchThreeGameMode::TryEndDelta()
+{
+	if (!GameBoard || !GameBoard->IsRecordingDelta() || !IsBoardSettled() || !GameBoard->IsSettled())
+	{
+		return;
+	}
+
+	FBoardDelta Delta;
+	GameBoard->EndDelta(Delta);
+	Delta.ScoreDelta = Score - DeltaStartScore;
+
+	// A swap undone for lack of a match changes nothing worth undoing
+	if (Delta.IsEmpty() || MaxUndoMoves == 0)
+	{
+		return;
+	}
+
+	RedoStack.Reset();
+	if (UndoStack.Num() >= MaxUndoMoves)
+	{
+		UndoStack.RemoveAt(0);
+	}
+	UndoStack.Add(MoveTemp(Delta));
+}
+
+void AMatchThreeGameMode::ClearUndoHistory()
+{
+	if (GameBoard)
+	{
+		GameBoard->CancelDelta();
+	}
+	UndoStack.Reset();
+	RedoStack.Reset();
+}
+
+void AMatchThreeGameMode::PlayLevel(const FString& Name)
+{
+	const int32 LevelIndex = LevelPack.FindLevel(Name);
+	if (LevelIndex == INDEX_NONE)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("No level [%s] in the level pack"), *Name);
+		return;
+	}
+
+	if (!StartLevel(LevelIndex))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Could not start level [%s]"), *Name);
+	}
+}
+
+bool AMatchThreeGameMode::StartLevel(int32 LevelIndex)
+{
+	if (!IsBoardSettled())
+	{
+		return false;
+	}
+
+	StopBoardWorker();
+
+	const double StartTime = FPlatformTime::Seconds();
+	const FLevelView Level = LevelPack.GetLevel(LevelIndex);
+	if (!GameBoard->LoadLevel(Level))
+	{
+		return false;
+	}
+
+	SwapPrediction = FSwapPrediction();
+	ClearUndoHistory();
+	ColumnLocks.Init(GameBoard->GetBoardWidth());
+	ColumnSpans.Init(0, GameBoard->GetBoardWidth());
+	PendingClears.Reset();
+	Score = 0;
+	LevelGoals = Level.GetGoals();
+	LevelMoveLimit = Level.GetMoveLimit();
+
+	// Random cells can complete a match with the fixed ones
+	FCascadeArenaScope ArenaScope;
+	TCascadeArray<FMatch> Matches;
+	GameBoard->FindMatches(Matches);
+	if (!Matches.IsEmpty())
+	{
+		ResolveMatches(Matches, 0);
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Started level [%d] of [%dx%d] with [%d] goals in [%.3f ms]"),
+		LevelIndex, Level.GetWidth(), Level.GetHeight(), LevelGoals.Num(), (FPlatformTime::Seconds() - StartTime) * 1000.);
+	return true;
+}
+
+void AMatchThreeGameMode::HandleEnterBackground()
+{
+	SaveBoard();
+}
+
+void AMatchThreeGameMode::SwapGems(AGemBase* GemA, AGemBase* GemB, uint32 SpanId)
+{
+	MATCHTHREE_SCOPE_CYCLE_COUNTER(STAT_MatchThree_SwapGems);
+	MATCHTHREE_RECORD_EVENT(SwapRequested, static_cast<int32>(SpanId));
+
+	if (SwapQueue.Num() >= MaxQueuedSwaps)
+	{
+		CancelMove(SpanId);
+		DropSwap(ESwapDropReason::QueueFull);
+		return;
+	}
+
+	TSharedPtr<FSwapPair> SwapAction = MakeShared<FSwapPair>();
+	SwapAction->LocationA = GameBoard->GetBoardLocation(GemA);
+	SwapAction->LocationB = GameBoard->GetBoardLocation(GemB);
+	SwapAction->GemA = GemA;
+	SwapAction->GemB = GemB;
+	SwapAction->SpanId = SpanId;
+
+	if (AnalyticsWriter && SpanId != 0)
+	{
+		FMoveRecord& Move = PendingMoves.Add(SpanId);
+		Move.Time = GetWorld()->GetTimeSeconds();
+		Move.MoveId = SpanId;
+		Move.LocationAX = static_cast<int16>(SwapAction->LocationA.X);
+		Move.LocationAY = static_cast<int16>(SwapAction->LocationA.Y);
+		Move.LocationBX = static_cast<int16>(SwapAction->LocationB.X);
+		Move.LocationBY = static_cast<int16>(SwapAction->LocationB.Y);
+	}
+
+	// A swap known to have no match never needs the round trip. It still waits for its columns like any other swap
+	bool bWouldMatch = true;
+	if (bRejectInvalidSwaps && SwapQueue.IsEmpty() && GetPredictedSwap(SwapAction->LocationA, SwapAction->LocationB, bWouldMatch) && !bWouldMatch)
+	{
+		SwapAction->bPredictedNoMatch = true;
+		SwapAction->PredictedRevision = GameBoard->GetRevision();
+	}
+
+	SwapQueue.Add(SwapAction);
+
+	ProcessSwapQueue();
+}
+
+void AMatchThreeGameMode::PredictSwaps(AGemBase* Gem)
+{
+	SwapPrediction = FSwapPrediction();
+	if (!Gem || !GameBoard->ContainsGem(Gem))
+	{
+		return;
+	}
+
+	SwapPrediction.Location = GameBoard->GetBoardLocation(Gem);
+	SwapPrediction.BoardRevision = GameBoard->GetRevision();
+	SwapPrediction.bIsSet = true;
+
+	const FBoardLocation Neighbours[4] = {
+		{ SwapPrediction.Location.X - 1, SwapPrediction.Location.Y },
+		{ SwapPrediction.Location.X + 1, SwapPrediction.Location.Y },
+		{ SwapPrediction.Location.X, SwapPrediction.Location.Y - 1 },
+		{ SwapPrediction.Location.X, SwapPrediction.Location.Y + 1 }
+	};
+	for (int32 Direction = 0; Direction < 4; Direction++)
+	{
+		SwapPrediction.bWouldMatch[Direction] = GameBoard->IsValidLocation(Neighbours[Direction])
+			&& GameBoard->WouldSwapMatch(SwapPrediction.Location, Neighbours[Direction]);
+	}
+}
+
+bool AMatchThreeGameMode::GetPredictedSwap(const FBoardLocation& LocationA, const FBoardLocation& LocationB, bool& bOutWouldMatch) const
+{
+	// Any change to the board invalidates the prediction
+	if (!SwapPrediction.bIsSet || SwapPrediction.BoardRevision != GameBoard->GetRevision())
+	{
+		return false;
+	}
+
+	const bool bFromA = LocationA == SwapPrediction.Location;
+	const bool bFromB = LocationB == SwapPrediction.Location;
+	if (!bFromA && !bFromB)
+	{
+		return false;
+	}
+
+	const FBoardLocation& Other = bFromA ? LocationB : LocationA;
+	const int32 DeltaX = Other.X - SwapPrediction.Location.X;
+	const int32 DeltaY = Other.Y - SwapPrediction.Location.Y;
+
+	int32 Direction = INDEX_NONE;
+	if (DeltaX == -1 && DeltaY == 0) Direction = 0;
+	else if (DeltaX == 1 && DeltaY == 0) Direction = 1;
+	else if (DeltaX == 0 && DeltaY == -1) Direction = 2;
+	else if (DeltaX == 0 && DeltaY == 1) Direction = 3;
+
+	if (Direction == INDEX_NONE)
+	{
+		return false;
+	}
+
+	bOutWouldMatch = SwapPrediction.bWouldMatch[Direction];
+	return true;
+}
+
+void AMatchThreeGameMode::RejectSwap(const FBoardLocation& LocationA, const FBoardLocation& LocationB)
+{
+	MATCHTHREE_LLM_SCOPE(Tasks);
+	UTaskRejectSwap* TaskRejectSwap = NewObject<UTaskRejectSwap>(this);
+	TaskRejectSwap->Init(GameBoard, LocationA, LocationB, RejectNudgeFraction);
+	TaskPool->AddTask(TaskRejectSwap);
+	TaskRejectSwap->Execute();
+}
+
+void AMatchThreeGameMode::StartRejectAction(const TSharedPtr<FSwapPair>& SwapAction)
+{
+	ActiveSwaps.Add(SwapAction);
+	ColumnLocks.Lock(SwapAction->LocationA.X);
+	ColumnLocks.Lock(SwapAction->LocationB.X);
+	ColumnSpans[SwapAction->LocationA.X] = SwapAction->SpanId;
+	ColumnSpans[SwapAction->LocationB.X] = SwapAction->SpanId;
+	SwapAction->bRejecting = true;
+
+	MATCHTHREE_LLM_SCOPE(Tasks);
+	UTaskRejectSwap* TaskRejectSwap = NewObject<UTaskRejectSwap>(this);
+	TaskRejectSwap->Init(GameBoard, SwapAction->LocationA, SwapAction->LocationB, RejectNudgeFraction);
+	TaskRejectSwap->OnTaskComplete.AddUniqueDynamic(this, &AMatchThreeGameMode::HandleRejectedSwapAction);
+	TaskPool->AddTask(TaskRejectSwap);
+	SwapAction->Task = TaskRejectSwap;
+	LatencyTracker.MarkPhase(SwapAction->SpanId, EActionPhase::Feedback);
+	TaskRejectSwap->Execute();
+}
+
+void AMatchThreeGameMode::ProcessSwapQueue()
+{
+	// Columns wanted by swaps still waiting in the queue. Later swaps on these columns must not overtake them
+	TSet<int32> ReservedColumns;
 
-	// Fill the columns
-	for (int Column = 0; Column < GameBoard->GetBoardWidth(); Column++)
+	for (int32 Index = 0; Index < SwapQueue.Num();)
 	{
-		UTaskAddGemsToColumn* Task = NewObject<UTaskAddGemsToColumn>(this);
-		TaskPool->AddTask(Task);
-		Task->Init(GameBoard, Column, GameBoard->GetBoardHeight(), .2f);
-		Task->Execute();
+		const TSharedPtr<FSwapPair> SwapAction = SwapQueue[Index];
+
+		ESwapDropReason Reason;
+		if (IsStale(*SwapAction, Reason))
+		{
+			SwapQueue.RemoveAt(Index);
+			CancelMove(SwapAction->SpanId);
+			DropSwap(Reason);
+			continue;
+		}
+
+		if (!CanStart(*SwapAction, ReservedColumns))
+		{
+			ReservedColumns.Add(SwapAction->LocationA.X);
+			ReservedColumns.Add(SwapAction->LocationB.X);
+			Index++;
+			continue;
+		}
+
+		SwapQueue.RemoveAt(Index);
+		StartSwapAction(SwapAction);
 	}
 }
 
-void AMatchThreeGameMode::SwapGems(AGemBase* GemA, AGemBase* GemB)
+void AMatchThreeGameMode::StartSwapAction(const TSharedPtr<FSwapPair>& SwapAction)
 {
-	// Only one swap action at once
-	if (CurrentSwapAction.IsValid())
+	MATCHTHREE_SCOPE_CYCLE_COUNTER(STAT_MatchThree_SwapGems);
+
+	if (BoardWorker)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("Swap already in progress"));
+		// The worker validates the swap and resolves its cascade. The gems move once its events come back
+		if (!BoardWorker->PushCommand({ SwapAction->LocationA, SwapAction->LocationB, SwapAction->SpanId }))
+		{
+			CancelMove(SwapAction->SpanId);
+			DropSwap(ESwapDropReason::QueueFull);
+			return;
+		}
+		NumWorkerMoves++;
+		MATCHTHREE_RECORD_EVENT(SwapStarted, FMatchThreeEventRecorder::PackLocation(SwapAction->LocationA.X, SwapAction->LocationA.Y));
+		return;
+	}
+
+	// The prediction only holds on the board it was made on. Otherwise the swap goes there and back as usual
+	if (SwapAction->bPredictedNoMatch && SwapAction->PredictedRevision == GameBoard->GetRevision())
+	{
+		StartRejectAction(SwapAction);
 		return;
 	}
 
-	// Set the current swap action
-	CurrentSwapAction = MakeShared<FSwapPair>();
-	CurrentSwapAction->LocationA = GameBoard->GetBoardLocation(GemA);
-	CurrentSwapAction->LocationB = GameBoard->GetBoardLocation(GemB);
+	// A move runs from its swap until the board settles. Swaps made before then join the same move
+	if (!GameBoard->IsRecordingDelta())
+	{
+		GameBoard->BeginDelta();
+		DeltaStartScore = Score;
+	}
+
+	ActiveSwaps.Add(SwapAction);
+	ColumnLocks.Lock(SwapAction->LocationA.X);
+	ColumnLocks.Lock(SwapAction->LocationB.X);
+	ColumnSpans[SwapAction->LocationA.X] = SwapAction->SpanId;
+	ColumnSpans[SwapAction->LocationB.X] = SwapAction->SpanId;
 
 	// Swap the gems
+	MATCHTHREE_LLM_SCOPE(Tasks);
 	UTaskSwapGems* TaskSwapGems = NewObject<UTaskSwapGems>(this);
-	TaskSwapGems->Init(GameBoard, CurrentSwapAction->LocationA, CurrentSwapAction->LocationB);
+	TaskSwapGems->Init(GameBoard, SwapAction->LocationA, SwapAction->LocationB);
 	TaskSwapGems->OnTaskComplete.AddUniqueDynamic(this, &AMatchThreeGameMode::HandleCompletedSwapAction);
 	TaskPool->AddTask(TaskSwapGems);
+	SwapAction->Task = TaskSwapGems;
 	TaskSwapGems->Execute();
+
+	LatencyTracker.MarkPhase(SwapAction->SpanId, EActionPhase::Feedback);
+	MATCHTHREE_RECORD_EVENT(SwapStarted, FMatchThreeEventRecorder::PackLocation(SwapAction->LocationA.X, SwapAction->LocationA.Y));
+}
+
+bool AMatchThreeGameMode::IsStale(const FSwapPair& SwapAction, ESwapDropReason& OutReason) const
+{
+	AGemBase* GemA = SwapAction.GemA.Get();
+	AGemBase* GemB = SwapAction.GemB.Get();
+
+	if (!GemA || !GemB || !GameBoard->ContainsGem(GemA) || !GameBoard->ContainsGem(GemB))
+	{
+		OutReason = ESwapDropReason::GemRemoved;
+		return true;
+	}
+
+	if (GameBoard->GetGem(SwapAction.LocationA) != GemA || GameBoard->GetGem(SwapAction.LocationB) != GemB)
+	{
+		OutReason = ESwapDropReason::GemMoved;
+		return true;
+	}
+
+	return false;
+}
+
+bool AMatchThreeGameMode::CanStart(const FSwapPair& SwapAction, const TSet<int32>& ReservedColumns) const
+{
+	if (NumWorkerMoves > 0)
+	{
+		return false;
+	}
+
+	for (const int32 Column : { SwapAction.LocationA.X, SwapAction.LocationB.X })
+	{
+		if (ColumnLocks.IsLocked(Column) || ReservedColumns.Contains(Column) || IsColumnPendingClear(Column))
+		{
+			return false;
+		}
+	}
+
+	return GameBoard->GetCellState(SwapAction.LocationA) == ECellState::Settled && GameBoard->GetCellState(SwapAction.LocationB) == ECellState::Settled;
+}
+
+void AMatchThreeGameMode::DropSwap(ESwapDropReason Reason)
+{
+	UE_LOG(LogTemp, Warning, TEXT("Swap dropped: %s"), *UEnum::GetValueAsString(Reason));
+	MATCHTHREE_SCOPE_CYCLE_COUNTER(STAT_MatchThree_Broadcast);
+	OnSwapDroppedDelegate.Broadcast(Reason);
 }
 
 bool AMatchThreeGameMode::CanSwapGems(AGemBase* GemA, AGemBase* GemB)
@@ -66,77 +961,548 @@ bool AMatchThreeGameMode::CanSwapGems(AGemBase* GemA, AGemBase* GemB)
 
 void AMatchThreeGameMode::HandleMatchesFound(TArray<FMatch>& Matches)
 {
-	UE_LOG(LogTemp, Warning, TEXT("Matches found!"));
+	// The board reuses the array it broadcasts, so resolve from a copy in the arena
+	FCascadeArenaScope ArenaScope;
+	TCascadeArray<FMatch> CascadeMatches;
+	{
+		MATCHTHREE_COUNT_ALLOCATIONS();
+		CascadeMatches = Matches;
+	}
 
-	for (const FMatch& Match : Matches)
+	// Cascades extend the action that caused them
+	ResolveMatches(CascadeMatches, FindSpanForMatches(CascadeMatches));
+}
+
+void AMatchThreeGameMode::ResolveMatches(TConstArrayView<FMatch> Matches, uint32 SpanId, const FSwapPair* SwapAction)
+{
+	MATCHTHREE_SCOPE_CYCLE_COUNTER(STAT_MatchThree_HandleMatches);
+	MATCHTHREE_LLM_SCOPE(Matches);
+
+	UE_LOG(LogTemp, Verbose, TEXT("Matches found!"));
+
+	FMoveRecord* Move = PendingMoves.Find(SpanId);
+	if (Move)
+	{
+		Move->CascadeDepth = static_cast<uint8>(FMath::Min<int32>(Move->CascadeDepth + 1, MAX_uint8));
+	}
+
+	// Gather every gem to clear into one mask so overlapping matches and special gems clear each cell once. Only the board
+	// model is touched until the mask is complete, so planning the clear makes no heap allocations
+	FBoardMask ClearMask(GameBoard->GetBoardWidth(), GameBoard->GetBoardHeight());
+	FCascadeArenaScope ArenaScope;
+	TArray<TPair<FBoardLocation, uint8>, TInlineAllocator<4, TCascadeArenaAllocator<>>> NewSpecials;
+	TCascadeArray<FBoardLocation> ScoreLocations;
 	{
-		if (!Match.IsEmpty())
+		MATCHTHREE_COUNT_ALLOCATIONS();
+		for (const FMatch& Match : Matches)
 		{
-			AScoreActor* ScoreActor = GetWorld()->SpawnActor<AScoreActor>(ScoreActorClass);
-			ScoreActor->SetActorLocation(GameBoard->GetWorldLocation(Match.GetLocations()[0]));
+			if (!Match.IsEmpty())
+			{
+				MATCHTHREE_COUNTER_ADD(MatchesPerFrame, 1);
+				MATCHTHREE_RECORD_EVENT(MatchFound, Match.GetLocations().Num());
+
+				if (Move)
+				{
+					Move->bMatched = true;
+					Move->AddShape(FMoveRecord::GetShape(Match));
+				}
+
+				for (const FBoardLocation& Location : Match.GetLocations())
+				{
+					ClearMask.Set(Location);
+				}
+
+				// The special gem takes the place of the gem the player moved, or of the first gem of the match
+				FBoardLocation SpecialLocation = Match.GetLocations()[0];
+				if (SwapAction)
+				{
+					if (Match.GetLocations().Contains(SwapAction->LocationA)) SpecialLocation = SwapAction->LocationA;
+					else if (Match.GetLocations().Contains(SwapAction->LocationB)) SpecialLocation = SwapAction->LocationB;
+				}
+
+				const AGemBase* Gem = GameBoard->GetGem(SpecialLocation);
+				const uint8 SpecialTypeId = Gem ? GetSpecialForMatch(Match, Gem->GetTypeId()) : FGemArchetypeRegistry::InvalidTypeId;
+				if (SpecialTypeId != FGemArchetypeRegistry::InvalidTypeId
+					&& !NewSpecials.ContainsByPredicate([&SpecialLocation](const TPair<FBoardLocation, uint8>& Special) { return Special.Key == SpecialLocation; }))
+				{
+					NewSpecials.Emplace(SpecialLocation, SpecialTypeId);
+				}
+
+				ScoreLocations.Add(Match.GetLocations()[0]);
+			}
+		}
+
+		// Special gems in the matches go off before the new ones take their cells. Their areas can reach columns held by
+		// other actions, in which case the whole batch waits in ClearGems
+		GameBoard->ExpandSpecialClears(ClearMask);
+	}
+
+	for (const TPair<FBoardLocation, uint8>& Special : NewSpecials)
+	{
+		ClearMask.Clear(Special.Key);
+		GameBoard->SetGemType(Special.Key, Special.Value);
+	}
+
+	ClearGems(ClearMask, SpanId, SwapAction);
+
+	MATCHTHREE_LLM_SCOPE(FX);
+	for (const FBoardLocation& Location : ScoreLocations)
+	{
+		AScoreActor* ScoreActor = GetWorld()->SpawnActor<AScoreActor>(ScoreActorClass);
+		ScoreActor->SetActorLocation(GameBoard->GetWorldLocation(Location));
+	}
+}
+
+void AMatchThreeGameMode::ResolveColourBombSwap(const FSwapPair& SwapAction, bool bBothColourBombs)
+{
+	MATCHTHREE_SCOPE_CYCLE_COUNTER(STAT_MatchThree_HandleMatches);
+	MATCHTHREE_LLM_SCOPE(Matches);
+
+	const FGemArchetypeRegistry& Registry = GameBoard->GetRegistry();
+	const bool bColourBombAtA = GameBoard->GetGem(SwapAction.LocationA)->GetTypeId() == Registry.GetColourBombTypeId();
+	const FBoardLocation& BombLocation = bColourBombAtA ? SwapAction.LocationA : SwapAction.LocationB;
+	const FBoardLocation& OtherLocation = bColourBombAtA ? SwapAction.LocationB : SwapAction.LocationA;
+
+	const int32 Width = GameBoard->GetBoardWidth();
+	const int32 Height = GameBoard->GetBoardHeight();
+	FBoardMask Area(Width, Height);
+	if (bBothColourBombs)
+	{
+		for (int32 Column = 0; Column < Width; Column++)
+		{
+			Area.SetColumn(Column);
 		}
 	}
+	else
+	{
+		const uint8 TargetGroup = Registry.Get(GameBoard->GetGem(OtherLocation)->GetTypeId()).MatchGroup;
+		GameBoard->GetSpecialClearMask(BombLocation, EGemSpecial::ColourBomb, TargetGroup, Area);
+	}
+
+	FBoardMask ClearMask(Width, Height);
+	Area.ForEachSetBit([&](int32 Index)
+		{
+			if (GameBoard->IsClearable(Area.GetLocation(Index)))
+			{
+				ClearMask.Set(Index);
+			}
+		});
+
+	// The colour bombs are spent, but a special gem swapped onto one goes off with the gems it clears
+	ClearMask.Clear(BombLocation);
+	if (bBothColourBombs)
+	{
+		ClearMask.Clear(OtherLocation);
+	}
+	else
+	{
+		ClearMask.Set(OtherLocation);
+	}
+	GameBoard->ExpandSpecialClears(ClearMask);
+	ClearMask.Set(BombLocation);
+	ClearMask.Set(OtherLocation);
+
+	MATCHTHREE_COUNTER_ADD(MatchesPerFrame, 1);
+	if (FMoveRecord* Move = PendingMoves.Find(SwapAction.SpanId))
+	{
+		Move->CascadeDepth = static_cast<uint8>(FMath::Min<int32>(Move->CascadeDepth + 1, MAX_uint8));
+		Move->bMatched = true;
+	}
+	ClearGems(ClearMask, SwapAction.SpanId, &SwapAction);
+
+	MATCHTHREE_LLM_SCOPE(FX);
+	AScoreActor* ScoreActor = GetWorld()->SpawnActor<AScoreActor>(ScoreActorClass);
+	ScoreActor->SetActorLocation(GameBoard->GetWorldLocation(BombLocation));
+}
+
+uint8 AMatchThreeGameMode::GetSpecialForMatch(const FMatch& Match, uint8 TypeId) const
+{
+	const FGemArchetypeRegistry& Registry = GameBoard->GetRegistry();
+	const TConstArrayView<FBoardLocation> Locations = Match.GetLocations();
+
+	// Striped gems clear across the line that made them
+	const bool bHorizontal = Locations.Num() > 1 && Locations[0].Y == Locations[1].Y;
+	const EGemSpecial Striped = bHorizontal ? EGemSpecial::StripedColumn : EGemSpecial::StripedRow;
+
+	switch (FMoveRecord::GetShape(Match))
+	{
+	case EMatchShape::Line4:
+		return Registry.GetSpecialVariant(TypeId, Striped);
+	case EMatchShape::Line5:
+	{
+		const uint8 ColourBombTypeId = Registry.GetColourBombTypeId();
+		return ColourBombTypeId != FGemArchetypeRegistry::InvalidTypeId ? ColourBombTypeId : Registry.GetSpecialVariant(TypeId, Striped);
+	}
+	case EMatchShape::Cross:
+		return Registry.GetSpecialVariant(TypeId, EGemSpecial::Bomb);
+	default:
+		return FGemArchetypeRegistry::InvalidTypeId;
+	}
+}
+
+void AMatchThreeGameMode::ClearGems(const FBoardMask& ClearMask, uint32 SpanId, const FSwapPair* ResolvingSwap)
+{
+	if (!CanClear(ClearMask, ResolvingSwap, PendingClears.Num()))
+	{
+		PendingClears.Add({ ClearMask, SpanId });
+		return;
+	}
+	RunClear(ClearMask, SpanId);
+}
 
+bool AMatchThreeGameMode::CanClear(const FBoardMask& ClearMask, const FSwapPair* ResolvingSwap, int32 NumEarlierClears) const
+{
 	for (int32 Column = 0; Column < GameBoard->GetBoardWidth(); Column++)
 	{
-		// Track the number of matched gems in each column
+		if (ClearMask.FindFirstInColumn(Column) == INDEX_NONE)
+		{
+			continue;
+		}
+
+		// The swap being resolved still holds its columns, but its gems have arrived
+		int32 NumOwnLocks = 0;
+		if (ResolvingSwap)
+		{
+			NumOwnLocks = (ResolvingSwap->LocationA.X == Column) + (ResolvingSwap->LocationB.X == Column);
+		}
+		if (ColumnLocks.GetLockCount(Column) > NumOwnLocks)
+		{
+			return false;
+		}
+
+		for (int32 Index = 0; Index < NumEarlierClears; Index++)
+		{
+			if (PendingClears[Index].ClearMask.FindFirstInColumn(Column) != INDEX_NONE)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool AMatchThreeGameMode::IsColumnPendingClear(int32 Column) const
+{
+	return PendingClears.ContainsByPredicate([Column](const FPendingClear& PendingClear) { return PendingClear.ClearMask.FindFirstInColumn(Column) != INDEX_NONE; });
+}
+
+void AMatchThreeGameMode::ProcessPendingClears()
+{
+	for (int32 Index = 0; Index < PendingClears.Num();)
+	{
+		if (!CanClear(PendingClears[Index].ClearMask, nullptr, Index))
+		{
+			Index++;
+			continue;
+		}
+
+		// Take the clear out first, since running it can complete tasks and come back here
+		const FPendingClear PendingClear = PendingClears[Index];
+		PendingClears.RemoveAt(Index);
+		RunClear(PendingClear.ClearMask, PendingClear.SpanId);
+	}
+}
+
+void AMatchThreeGameMode::RunClear(const FBoardMask& ClearMask, uint32 SpanId)
+{
+	struct FColumnClear
+	{
+		int32 Column = 0;
+		int32 FirstRow = 0;
 		int32 NumberToAdd = 0;
-		for (FMatch& Match : Matches)
+	};
+
+	// Take the gems off the board first. Only the board model is touched, so this makes no heap allocations
+	FCascadeArenaScope ArenaScope;
+	TCascadeArray<FColumnClear> ColumnClears;
+	TCascadeArray<AGemBase*> RemovedGems;
+	int32 NumCleared = 0;
+	{
+		MATCHTHREE_COUNT_ALLOCATIONS();
+		for (int32 Column = 0; Column < GameBoard->GetBoardWidth(); Column++)
 		{
-			TArray<FBoardLocation> GemLocationsInColumn = Match.GetLocationsInColumn(Column);
-			for (const FBoardLocation& GemLocation : GemLocationsInColumn)
+			// Columns without cleared gems are skipped a word at a time, and gems below the lowest cleared gem stay put
+			const int32 FirstRow = ClearMask.FindFirstInColumn(Column);
+			if (FirstRow == INDEX_NONE)
+			{
+				continue;
+			}
+
+			// Track the number of cleared gems in each column
+			int32 NumberToAdd = 0;
+			for (int32 Row = FirstRow; Row < GameBoard->GetBoardHeight(); Row++)
+			{
+				// A clear that waited only takes the gems still resting where it found them
+				const FBoardLocation Location(Column, Row);
+				const ECellState State = GameBoard->GetCellState(Location);
+				if (!ClearMask.Get(Location) || (State != ECellState::Settled && State != ECellState::Matched))
+				{
+					continue;
+				}
+
+				if (AGemBase* Gem = GameBoard->GetGem(Location))
+				{
+					GameBoard->Remove(Gem);
+					RemovedGems.Add(Gem);
+					NumberToAdd++;
+				}
+			}
+
+			// Columns without removed gems have nothing to collapse
+			if (NumberToAdd > 0)
 			{
-				AGemBase* Gem = GameBoard->GetGem(GemLocation);
-				GameBoard->Remove(Gem);
-				Gem->Destroy();
-				NumberToAdd++;
+				ColumnClears.Add({ Column, FirstRow, NumberToAdd });
+				NumCleared += NumberToAdd;
 			}
 		}
+	}
+
+	for (AGemBase* Gem : RemovedGems)
+	{
+		GameBoard->DestroyGem(Gem);
+	}
 
-		// Collapse and fill the column
+	// Collapse and fill the columns
+	MATCHTHREE_LLM_SCOPE(Tasks);
+	for (const FColumnClear& ColumnClear : ColumnClears)
+	{
 		UTaskCollapseAndFill* TaskCollapseAndFill = NewObject<UTaskCollapseAndFill>(this);
 		TaskPool->AddTask(TaskCollapseAndFill);
-		TaskCollapseAndFill->Init(GameBoard, Column, NumberToAdd, .2f);
+		TaskCollapseAndFill->Init(GameBoard, ColumnClear.Column, ColumnClear.FirstRow, ColumnClear.NumberToAdd, .2f);
+		LockColumnForTask(TaskCollapseAndFill, ColumnClear.Column, SpanId);
 		TaskCollapseAndFill->Execute();
 	}
+
+	const int32 Points = NumCleared * PointsPerGem;
+	Score += Points;
+	if (FMoveRecord* Move = PendingMoves.Find(SpanId))
+	{
+		Move->ScoreDelta += Points;
+	}
+}
+
+uint32 AMatchThreeGameMode::FindSpanForMatches(TConstArrayView<FMatch> Matches) const
+{
+	// The column's tasks may already be done while the gems they dropped are still landing
+	for (const FMatch& Match : Matches)
+	{
+		for (const FBoardLocation& Location : Match.GetLocations())
+		{
+			const uint32 SpanId = ColumnSpans.IsValidIndex(Location.X) ? ColumnSpans[Location.X] : 0;
+			if (SpanId != 0 && LatencyTracker.IsOpen(SpanId))
+			{
+				return SpanId;
+			}
+		}
+	}
+	return 0;
+}
+
+void AMatchThreeGameMode::TryEndSpan(uint32 SpanId)
+{
+	if (!LatencyTracker.IsOpen(SpanId))
+	{
+		return;
+	}
+
+	const bool bSwapRunning = ActiveSwaps.ContainsByPredicate([SpanId](const TSharedPtr<FSwapPair>& SwapAction) { return SwapAction->SpanId == SpanId; });
+	const bool bCascadeRunning = ColumnTasks.ContainsByPredicate([SpanId](const FColumnTask& ColumnTask) { return ColumnTask.SpanId == SpanId; })
+		|| PendingClears.ContainsByPredicate([SpanId](const FPendingClear& PendingClear) { return PendingClear.SpanId == SpanId; });
+	if (bSwapRunning || bCascadeRunning)
+	{
+		return;
+	}
+
+	// The span lasts until the gems it dropped have landed, since landing gems can chain more matches onto it
+	for (int32 Column = 0; Column < ColumnSpans.Num(); Column++)
+	{
+		if (ColumnSpans[Column] == SpanId && !GameBoard->IsColumnSettled(Column))
+		{
+			SettlingSpans.AddUnique(SpanId);
+			return;
+		}
+	}
+
+	for (uint32& ColumnSpan : ColumnSpans)
+	{
+		if (ColumnSpan == SpanId)
+		{
+			ColumnSpan = 0;
+		}
+	}
+	SettleMove(SpanId);
+}
+
+void AMatchThreeGameMode::UpdateSettlingSpans()
+{
+	// Take the list since a span still waiting adds itself back
+	const TArray<uint32> Spans = MoveTemp(SettlingSpans);
+	SettlingSpans.Reset();
+	for (const uint32 SpanId : Spans)
+	{
+		TryEndSpan(SpanId);
+	}
+}
+
+void AMatchThreeGameMode::CancelMove(uint32 SpanId)
+{
+	LatencyTracker.CancelSpan(SpanId);
+	PendingMoves.Remove(SpanId);
+}
+
+void AMatchThreeGameMode::SettleMove(uint32 SpanId)
+{
+	const double SettleMilliseconds = LatencyTracker.EndSpan(SpanId);
+
+	FMoveRecord Move;
+	if (PendingMoves.RemoveAndCopyValue(SpanId, Move) && AnalyticsWriter)
+	{
+		Move.SettleMilliseconds = SettleMilliseconds;
+		AnalyticsWriter->Emit(Move);
+	}
+}
+
+void AMatchThreeGameMode::LatencyReport()
+{
+	LatencyTracker.LogReport();
 }
 
 void AMatchThreeGameMode::HandleCompletedSwapAction()
 {
-	TArray<FMatch> Matches{ {}, {} };
-	const bool bMatchFoundAtLocationA = GameBoard->MatchFound(CurrentSwapAction->LocationA, Matches[0]);
-	const bool bMatchFoundAtLocationB = GameBoard->MatchFound(CurrentSwapAction->LocationB, Matches[1]);
+	// Copy since resolving a swap changes the active swaps
+	const TArray<TSharedPtr<FSwapPair>> Swaps = ActiveSwaps;
+	for (const TSharedPtr<FSwapPair>& SwapAction : Swaps)
+	{
+		if (!SwapAction->bUndoing && !SwapAction->bRejecting && SwapAction->Task.IsValid() && SwapAction->Task->IsComplete())
+		{
+			ResolveSwapAction(SwapAction);
+		}
+	}
+}
+
+void AMatchThreeGameMode::ResolveSwapAction(const TSharedPtr<FSwapPair>& SwapAction)
+{
+	MATCHTHREE_SCOPE_CYCLE_COUNTER(STAT_MatchThree_ResolveSwap);
+
+	LatencyTracker.MarkPhase(SwapAction->SpanId, EActionPhase::SwapCompleted);
+
+	// A colour bomb swapped with a gem clears every gem that matches it. Two colour bombs clear the board
+	const uint8 ColourBombTypeId = GameBoard->GetRegistry().GetColourBombTypeId();
+	const AGemBase* GemA = GameBoard->GetGem(SwapAction->LocationA);
+	const AGemBase* GemB = GameBoard->GetGem(SwapAction->LocationB);
+	const bool bColourBombA = GemA && ColourBombTypeId != FGemArchetypeRegistry::InvalidTypeId && GemA->GetTypeId() == ColourBombTypeId;
+	const bool bColourBombB = GemB && ColourBombTypeId != FGemArchetypeRegistry::InvalidTypeId && GemB->GetTypeId() == ColourBombTypeId;
+	if (GemA && GemB && (bColourBombA || bColourBombB))
+	{
+		MATCHTHREE_RECORD_EVENT(SwapResolved, true);
+		ResolveColourBombSwap(*SwapAction, bColourBombA && bColourBombB);
+		LatencyTracker.MarkPhase(SwapAction->SpanId, EActionPhase::Resolved);
+		FinishSwapAction(SwapAction);
+		return;
+	}
+
+	TArray<FMatch, TInlineAllocator<2>> Matches;
+	Matches.SetNum(2);
+	const bool bMatchFoundAtLocationA = GameBoard->MatchFound(SwapAction->LocationA, Matches[0]);
+	const bool bMatchFoundAtLocationB = GameBoard->MatchFound(SwapAction->LocationB, Matches[1]);
+	MATCHTHREE_RECORD_EVENT(SwapResolved, bMatchFoundAtLocationA || bMatchFoundAtLocationB);
 
 	if (bMatchFoundAtLocationA || bMatchFoundAtLocationB)
 	{
-		HandleMatchesFound(Matches);
-		ClearCurrentSwapAction();
+		// Lines crossing both swapped gems are found from both, so they count once
+		if (bMatchFoundAtLocationA && bMatchFoundAtLocationB && Matches[0].GetLocations().Contains(SwapAction->LocationB))
+		{
+			Matches.RemoveAt(1);
+		}
+
+		// The cascade takes its own column locks before the swap releases its own
+		ResolveMatches(Matches, SwapAction->SpanId, SwapAction.Get());
+		LatencyTracker.MarkPhase(SwapAction->SpanId, EActionPhase::Resolved);
+		FinishSwapAction(SwapAction);
 	}
 	else
 	{
 		// Swap the gems back
+		MATCHTHREE_LLM_SCOPE(Tasks);
 		UTaskSwapGems* TaskSwapGems = NewObject<UTaskSwapGems>(this);
-		TaskSwapGems->Init(GameBoard, CurrentSwapAction->LocationA, CurrentSwapAction->LocationB);
+		TaskSwapGems->Init(GameBoard, SwapAction->LocationA, SwapAction->LocationB);
 		TaskSwapGems->OnTaskComplete.AddUniqueDynamic(this, &AMatchThreeGameMode::HandleUndoneSwapAction);
 		TaskPool->AddTask(TaskSwapGems);
+		SwapAction->Task = TaskSwapGems;
+		SwapAction->bUndoing = true;
 		TaskSwapGems->Execute();
-	}	
+	}
 }
 
 void AMatchThreeGameMode::HandleUndoneSwapAction()
 {
-	//TArray<FMatch> Matches{ {}, {} };
-	//const bool bMatchFoundAtLocationA = GameBoard->MatchFound(CurrentSwapAction->LocationA, Matches[0]);
-	//const bool bMatchFoundAtLocationB = GameBoard->MatchFound(CurrentSwapAction->LocationB, Matches[1]);
+	const TArray<TSharedPtr<FSwapPair>> Swaps = ActiveSwaps;
+	for (const TSharedPtr<FSwapPair>& SwapAction : Swaps)
+	{
+		if (SwapAction->bUndoing && SwapAction->Task.IsValid() && SwapAction->Task->IsComplete())
+		{
+			LatencyTracker.MarkPhase(SwapAction->SpanId, EActionPhase::Resolved);
+			FinishSwapAction(SwapAction);
+		}
+	}
+}
+
+void AMatchThreeGameMode::HandleRejectedSwapAction()
+{
+	const TArray<TSharedPtr<FSwapPair>> Swaps = ActiveSwaps;
+	for (const TSharedPtr<FSwapPair>& SwapAction : Swaps)
+	{
+		if (SwapAction->bRejecting && SwapAction->Task.IsValid() && SwapAction->Task->IsComplete())
+		{
+			LatencyTracker.MarkPhase(SwapAction->SpanId, EActionPhase::Resolved);
+			FinishSwapAction(SwapAction);
+		}
+	}
+}
+
+void AMatchThreeGameMode::HandleCompletedColumnTask()
+{
+	TArray<uint32, TInlineAllocator<4>> ReleasedSpans;
+	for (int32 Index = ColumnTasks.Num() - 1; Index >= 0; Index--)
+	{
+		const FColumnTask& ColumnTask = ColumnTasks[Index];
+		if (!ColumnTask.Task.IsValid() || ColumnTask.Task->IsComplete())
+		{
+			ColumnLocks.Unlock(ColumnTask.Column);
+			ReleasedSpans.AddUnique(ColumnTask.SpanId);
+			ColumnTasks.RemoveAtSwap(Index);
+		}
+	}
+
+	if (!ReleasedSpans.IsEmpty())
+	{
+		// Waiting clears take the released columns before new swaps can
+		ProcessPendingClears();
+		for (const uint32 SpanId : ReleasedSpans)
+		{
+			TryEndSpan(SpanId);
+		}
+		ProcessSwapQueue();
+	}
+}
 
-	//if (bMatchFoundAtLocationA || bMatchFoundAtLocationB)
-	//{
-	//	HandleMatchesFound(Matches);
-	//}
-	ClearCurrentSwapAction();
+void AMatchThreeGameMode::FinishSwapAction(const TSharedPtr<FSwapPair>& SwapAction)
+{
+	ColumnLocks.Unlock(SwapAction->LocationA.X);
+	ColumnLocks.Unlock(SwapAction->LocationB.X);
+	ActiveSwaps.Remove(SwapAction);
+	ProcessPendingClears();
+	TryEndSpan(SwapAction->SpanId);
+	ProcessSwapQueue();
 }
 
-void AMatchThreeGameMode::ClearCurrentSwapAction()
+void AMatchThreeGameMode::LockColumnForTask(UTaskBase* Task, int32 Column, uint32 SpanId)
 {
-	CurrentSwapAction.Reset();
+	ColumnLocks.Lock(Column);
+	if (SpanId != 0)
+	{
+		ColumnSpans[Column] = SpanId;
+	}
+	ColumnTasks.Add({ Task, Column, SpanId });
+	Task->OnTaskComplete.AddUniqueDynamic(this, &AMatchThreeGameMode::HandleCompletedColumnTask);
 }
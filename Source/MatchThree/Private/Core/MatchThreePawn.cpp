@@ -6,9 +6,10 @@
 #include "EnhancedInputComponent.h"
 #include "EnhancedInputSubsystems.h"
 #include "Core/MatchThreeGameMode.h"
+#include "GameBoard.h"
 #include "GemBase.h"
 #include "Kismet/GameplayStatics.h"
-#include "MatchThree/MatchThree.h"
+#include "Profiling/MatchThreeMemory.h"
 #include "SelectionIndicator.h"
 
 AMatchThreePawn::AMatchThreePawn()
@@ -20,8 +21,11 @@ void AMatchThreePawn::BeginPlay()
 {
 	Super::BeginPlay();
 
+	GameBoard = Cast<AGameBoard>(UGameplayStatics::GetActorOfClass(this, AGameBoard::StaticClass()));
+
 	if (SelectionIndicatorClass)
 	{
+		MATCHTHREE_LLM_SCOPE(FX);
 		SelectionIndicator = GetWorld()->SpawnActor<ASelectionIndicator>(SelectionIndicatorClass);
 		SelectionIndicator->Show(false);
 	}
@@ -39,22 +43,90 @@ void AMatchThreePawn::SetupPlayerInputComponent(UInputComponent* PlayerInputComp
 	Subsystem->AddMappingContext(InputMapping, 0);
 
 	UEnhancedInputComponent* Input = Cast<UEnhancedInputComponent>(PlayerInputComponent);
+	Input->BindAction(ClickAction, ETriggerEvent::Started, this, &AMatchThreePawn::Press);
+	Input->BindAction(ClickAction, ETriggerEvent::Triggered, this, &AMatchThreePawn::Drag);
 	Input->BindAction(ClickAction, ETriggerEvent::Completed, this, &AMatchThreePawn::Click);
 }
 
+void AMatchThreePawn::Press(const FInputActionValue& Value)
+{
+	bIsPressed = GetBoardLocationUnderCursor(PressedLocation);
+
+	// A drag from this cell may follow so evaluate its swaps now
+	GameMode = !GameMode ? GetGameMode() : GameMode;
+	if (bIsPressed && GameMode)
+	{
+		GameMode->PredictSwaps(GameBoard->GetGem(PressedLocation));
+	}
+}
+
+void AMatchThreePawn::Drag(const FInputActionValue& Value)
+{
+	FBoardLocation CursorLocation;
+	if (!bIsPressed || !GetBoardLocationUnderCursor(CursorLocation) || CursorLocation == PressedLocation)
+	{
+		return;
+	}
+
+	// The gesture is consumed as soon as the cursor leaves the pressed cell
+	bIsPressed = false;
+
+	// Swap with the neighbour along the dominant drag axis
+	const int32 DeltaX = CursorLocation.X - PressedLocation.X;
+	const int32 DeltaY = CursorLocation.Y - PressedLocation.Y;
+	FBoardLocation TargetLocation = PressedLocation;
+	if (FMath::Abs(DeltaX) >= FMath::Abs(DeltaY))
+	{
+		TargetLocation.X += FMath::Sign(DeltaX);
+	}
+	else
+	{
+		TargetLocation.Y += FMath::Sign(DeltaY);
+	}
+
+	AGemBase* DraggedGem = GameBoard->GetGem(PressedLocation);
+	AGemBase* TargetGem = GameBoard->IsValidLocation(TargetLocation) ? GameBoard->GetGem(TargetLocation) : nullptr;
+
+	GameMode = !GameMode ? GetGameMode() : GameMode;
+	if (GameMode && GameMode->CanSwapGems(DraggedGem, TargetGem))
+	{
+		ClearSelection();
+		GameMode->SwapGems(DraggedGem, TargetGem, GameMode->GetLatencyTracker().BeginSpan());
+	}
+}
+
 void AMatchThreePawn::Click(const FInputActionValue& Value)
+{
+	// Releases that ended a drag gesture are not clicks
+	if (!bIsPressed || !SelectionIndicator)
+	{
+		return;
+	}
+	bIsPressed = false;
+
+	FBoardLocation ClickedLocation;
+	if (GetBoardLocationUnderCursor(ClickedLocation))
+	{
+		HandleGemClicked(GameBoard->GetGem(ClickedLocation));
+	}
+}
+
+bool AMatchThreePawn::GetBoardLocationUnderCursor(FBoardLocation& OutLocation) const
 {
 	APlayerController* PlayerController = Cast<APlayerController>(GetController());
-	if (PlayerController && SelectionIndicator)
+	if (!PlayerController || !GameBoard)
 	{
-		FHitResult HitResult;
-		PlayerController->GetHitResultUnderCursor(ECC_Gem, true, HitResult);
+		return false;
+	}
 
-		if (AGemBase* HitGem = Cast<AGemBase>(HitResult.GetActor()))
-		{
-			HandleGemClicked(HitGem);
-		}
+	FVector RayOrigin;
+	FVector RayDirection;
+	if (!PlayerController->DeprojectMousePositionToWorld(RayOrigin, RayDirection))
+	{
+		return false;
 	}
+
+	return GameBoard->GetBoardLocationFromRay(RayOrigin, RayDirection, OutLocation);
 }
 
 void AMatchThreePawn::HandleGemClicked(AGemBase* HitGem)
@@ -72,7 +144,7 @@ void AMatchThreePawn::HandleGemClicked(AGemBase* HitGem)
 		GameMode = !GameMode ? GetGameMode() : GameMode;
 		if (GameMode && GameMode->CanSwapGems(HitGem, SelectedGem))
 		{
-			GameMode->SwapGems(SelectedGem, HitGem);
+			GameMode->SwapGems(SelectedGem, HitGem, GameMode->GetLatencyTracker().BeginSpan());
 			ClearSelection();
 		}
 		else
@@ -96,10 +168,19 @@ void AMatchThreePawn::ClearSelection()
 {
 	if (SelectedGem)
 	{
+		// Keep the chunk awake while the spinner restores the gem's rotation
+		if (GameBoard && GameBoard->ContainsGem(SelectedGem))
+		{
+			GameBoard->WakeChunk(GameBoard->GetBoardLocation(SelectedGem));
+		}
 		SelectedGem->SetSelected(false);
 		SelectedGem = nullptr;
 	}
-	SelectionIndicator->Show(false);
+
+	if (SelectionIndicator)
+	{
+		SelectionIndicator->Show(false);
+	}
 }
 
 void AMatchThreePawn::SelectGem(AGemBase* NewGem)
@@ -108,6 +189,21 @@ void AMatchThreePawn::SelectGem(AGemBase* NewGem)
 
 	SelectedGem = NewGem;
 	NewGem->SetSelected(true);
-	SelectionIndicator->SetActorLocation(NewGem->GetActorLocation());
-	SelectionIndicator->Show(true);
+	if (GameBoard && GameBoard->ContainsGem(NewGem))
+	{
+		GameBoard->WakeChunk(GameBoard->GetBoardLocation(NewGem));
+	}
+
+	// Work out the outcome of the available swaps while the player picks the second gem
+	GameMode = !GameMode ? GetGameMode() : GameMode;
+	if (GameMode)
+	{
+		GameMode->PredictSwaps(NewGem);
+	}
+
+	if (SelectionIndicator)
+	{
+		SelectionIndicator->SetActorLocation(NewGem->GetActorLocation());
+		SelectionIndicator->Show(true);
+	}
 }
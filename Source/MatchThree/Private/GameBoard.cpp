@@ -6,63 +6,979 @@
 #include "GemBase.h"
 #include "TimerManager.h"
 #include "Board/BoardColumn.h"
+#include "Board/BoardGenerator.h"
+#include "Board/BoardLogic.h"
+#include "Board/BoardSnapshot.h"
+#include "Board/CascadeArena.h"
+#include "Board/LevelPack.h"
+#include "Curves/CurveFloat.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Kismet/GameplayStatics.h"
+#include "Profiling/AllocationCounter.h"
+#include "Profiling/EventRecorder.h"
+#include "Profiling/GrowthTracker.h"
+#include "Profiling/MatchThreeMemory.h"
+#include "Profiling/MatchThreeStats.h"
+
+static FAutoConsoleCommandWithWorld GDumpChunkStatsCommand(
+	TEXT("MatchThree.ChunkStats"),
+	TEXT("Log the number of awake and sleeping chunks on the game board"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+		{
+			if (const AGameBoard* GameBoard = Cast<AGameBoard>(UGameplayStatics::GetActorOfClass(World, AGameBoard::StaticClass())))
+			{
+				const FBoardChunkStats Stats = GameBoard->GetChunkStats();
+				UE_LOG(LogTemp, Display, TEXT("Chunks awake [%d] sleeping [%d] average awake cost [%.2f us] max active gems [%d]"),
+					Stats.NumAwake, Stats.NumSleeping, Stats.AverageAwakeChunkMicroseconds, Stats.MaxActiveGemsInChunk);
+			}
+		}));
 
 AGameBoard::AGameBoard()
 {
-	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bCanEverTick = true;
+}
+
+
+void AGameBoard::BeginPlay()
+{
+	Super::BeginPlay();
+
+	BuildRegistry();
+	InitializeBoard();
+}
+
+void AGameBoard::InitializeBoard()
+{
+	InitializeLayout();
+
+	Random.Initialize(RandomSeed != 0 ? RandomSeed : static_cast<int32>(FPlatformTime::Cycles()));
+
+	// Queue a fill with no matches and some moves. The columns fill from the bottom so the queue is in row order. The
+	// generator picks among the gems that spawn at random, evenly
+	const TConstArrayView<uint8> SpawnableTypeIds = Registry.GetSpawnableTypeIds();
+	TArray<uint8> TypeIds;
+	const FBoardGenerator Generator(BoardWidth, BoardHeight, SpawnableTypeIds.Num());
+	if (!Generator.Generate(Random, MinLegalMoves, TypeIds))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Could not generate a [%dx%d] board with [%d] moves from [%d] gem types"), BoardWidth, BoardHeight, MinLegalMoves, SpawnableTypeIds.Num());
+	}
+
+	for (int Column = 0; Column < BoardWidth; Column++)
+	{
+		for (int Row = 0; Row < BoardHeight; Row++)
+		{
+			Columns[Column].QueueGemToSpawn(SpawnableTypeIds[TypeIds[Generator.GetIndex(Column, Row)]]);
+		}
+	}
+}
+
+void AGameBoard::BuildRegistry()
+{
+	TArray<UGemDataAsset*> DataAssets;
+	if (!GemArchetypes.IsEmpty())
+	{
+		DataAssets = GemArchetypes;
+	}
+	else
+	{
+		// Boards set up before the archetype list keep their types in EGemType order
+		TArray<EGemType> Types;
+		GemData.GenerateKeyArray(Types);
+		Types.Sort();
+		for (const EGemType Type : Types)
+		{
+			DataAssets.Add(GemData[Type]);
+		}
+	}
+
+	Registry.Build(DataAssets);
+	if (bCreateSpecialGems)
+	{
+		Registry.AddSpecialVariants(SpecialGemMaterials, ColourBombData);
+	}
+
+	if (Registry.GetSpawnableTypeIds().IsEmpty())
+	{
+		UE_LOG(LogTemp, Error, TEXT("The game board has no gem archetypes that spawn at random"));
+	}
+
+	ColourBombCounts.SetNumZeroed(Registry.Num());
+}
+
+void AGameBoard::InitializeLayout()
+{
+	MATCHTHREE_LLM_SCOPE(Board);
+
+	// A delta recorded against the old cells means nothing on the new ones
+	CancelDelta();
+
+	Columns.Reset();
+	GemLocations.Reset();
+	Chunks.Reset();
+	Revision++;
+
+	Columns.Init(FBoardColumn(BoardHeight), BoardWidth);
+	CellStates.Init(ECellState::Empty, BoardWidth * BoardHeight);
+	CellTypeIds.Init(FGemArchetypeRegistry::InvalidTypeId, BoardWidth * BoardHeight);
+
+	// Sized once per layout. Each delta clears only the bits it set
+	DeltaTouchedCells.Init(false, BoardWidth * BoardHeight);
+	SpecialTriggered.Init(BoardWidth, BoardHeight);
+	SpecialArea.Init(BoardWidth, BoardHeight);
+
+	DirtyRegion.Init(BoardWidth, BoardHeight);
+	DirtyRegion.MarkAll();
+
+	// Partition the board into chunks
+	NumChunksX = FMath::DivideAndRoundUp(BoardWidth, ChunkSize);
+	const int32 NumChunksY = FMath::DivideAndRoundUp(BoardHeight, ChunkSize);
+	for (int32 ChunkY = 0; ChunkY < NumChunksY; ChunkY++)
+	{
+		for (int32 ChunkX = 0; ChunkX < NumChunksX; ChunkX++)
+		{
+			FBoardChunk& Chunk = Chunks.AddDefaulted_GetRef();
+			Chunk.Min = FBoardLocation(ChunkX * ChunkSize, ChunkY * ChunkSize);
+			Chunk.Max = FBoardLocation(FMath::Min((ChunkX + 1) * ChunkSize, BoardWidth), FMath::Min((ChunkY + 1) * ChunkSize, BoardHeight));
+		}
+	}
+}
+
+void AGameBoard::Tick(float DeltaSeconds)
+{
+	MATCHTHREE_SCOPE_CYCLE_COUNTER(STAT_MatchThree_BoardTick);
+
+	Super::Tick(DeltaSeconds);
+
+	const double Now = GetWorld()->GetTimeSeconds();
+	for (FBoardChunk& Chunk : Chunks)
+	{
+		// Sleeping chunks cost nothing until an edit wakes them
+		if (!Chunk.bIsAwake)
+		{
+			continue;
+		}
+
+		const uint32 StartCycles = FPlatformTime::Cycles();
+
+		Chunk.NumActiveGems = 0;
+		for (int32 X = Chunk.Min.X; X < Chunk.Max.X; X++)
+		{
+			for (int32 Y = Chunk.Min.Y; Y < Chunk.Max.Y; Y++)
+			{
+				const ECellState State = CellStates[X * BoardHeight + Y];
+				if ((State != ECellState::Empty && State != ECellState::Settled) || (State == ECellState::Settled && Columns[X].GetGem(Y)->IsSelected()))
+				{
+					Chunk.NumActiveGems++;
+				}
+			}
+		}
+
+		if (Chunk.NumActiveGems > 0)
+		{
+			Chunk.LastActiveTime = Now;
+		}
+		else if (Now - Chunk.LastActiveTime > ChunkSleepDelay)
+		{
+			SetChunkAwake(Chunk, false);
+		}
+
+		Chunk.LastTickCycles = FPlatformTime::Cycles() - StartCycles;
+	}
+}
+
+void AGameBoard::WakeChunk(const FBoardLocation& InLocation)
+{
+	if (!IsValidLocation(InLocation) || Chunks.IsEmpty())
+	{
+		return;
+	}
+
+	FBoardChunk& Chunk = Chunks[GetChunkIndex(InLocation)];
+	Chunk.LastActiveTime = GetWorld()->GetTimeSeconds();
+	SetChunkAwake(Chunk, true);
+}
+
+FBoardChunkStats AGameBoard::GetChunkStats() const
+{
+	FBoardChunkStats Stats;
+	uint64 AwakeCycles = 0;
+	for (const FBoardChunk& Chunk : Chunks)
+	{
+		if (Chunk.bIsAwake)
+		{
+			Stats.NumAwake++;
+			AwakeCycles += Chunk.LastTickCycles;
+			Stats.MaxActiveGemsInChunk = FMath::Max(Stats.MaxActiveGemsInChunk, Chunk.NumActiveGems);
+		}
+		else
+		{
+			Stats.NumSleeping++;
+		}
+	}
+
+	if (Stats.NumAwake > 0)
+	{
+		Stats.AverageAwakeChunkMicroseconds = FPlatformTime::ToMilliseconds64(AwakeCycles) * 1000. / Stats.NumAwake;
+	}
+	return Stats;
+}
+
+int32 AGameBoard::GetChunkIndex(const FBoardLocation& InLocation) const
+{
+	return (InLocation.Y / ChunkSize) * NumChunksX + InLocation.X / ChunkSize;
+}
+
+void AGameBoard::SetChunkAwake(FBoardChunk& Chunk, bool bAwake)
+{
+	if (Chunk.bIsAwake == bAwake)
+	{
+		return;
+	}
+	Chunk.bIsAwake = bAwake;
+
+	for (int32 X = Chunk.Min.X; X < Chunk.Max.X; X++)
+	{
+		for (int32 Y = Chunk.Min.Y; Y < Chunk.Max.Y; Y++)
+		{
+			if (AGemBase* Gem = Columns[X].GetGem(Y))
+			{
+				Gem->SetSleeping(!bAwake);
+			}
+		}
+	}
+}
+
+void AGameBoard::DestroyGem(AGemBase* Gem)
+{
+	MATCHTHREE_SCOPE_CYCLE_COUNTER(STAT_MatchThree_DestroyGem);
+
+	if (!Gem || Gem->IsPooled()) return;
+	MATCHTHREE_RECORD_EVENT(GemDestroyed, static_cast<int32>(Gem->GetUniqueID()));
+
+	if (bPoolGems)
+	{
+		Gem->SetPooled(true);
+		GemPool.Add(Gem);
+	}
+	else
+	{
+		Gem->Destroy();
+	}
+}
+
+AGemBase* AGameBoard::GetGem(const FBoardLocation& InLocation) const
+{
+	return Columns[InLocation.X].GetGem(InLocation.Y);
+}
+
+void AGameBoard::SetGem(AGemBase* Gem, const FBoardLocation& BoardLocation, ECellState State)
+{
+	MATCHTHREE_LLM_SCOPE(Board);
+
+	// Forget the gem being replaced unless it has already been placed elsewhere
+	if (const AGemBase* PreviousGem = GetGem(BoardLocation))
+	{
+		const FBoardLocation* PreviousLocation = GemLocations.Find(PreviousGem);
+		if (PreviousLocation && *PreviousLocation == BoardLocation)
+		{
+			GemLocations.Remove(PreviousGem);
+		}
+	}
+
+	if (Gem)
+	{
+		GemLocations.Add(Gem, BoardLocation);
+	}
+
+	RecordDeltaCell(BoardLocation);
+
+	// The gem is placed whatever its state, since the columns must stay true to the gems, but a bad transition is a logic error
+	const int32 CellIndex = GetCellIndex(BoardLocation);
+	const ECellState NewState = Gem ? State : ECellState::Empty;
+	ensureMsgf(CellState::IsLegalTransition(CellStates[CellIndex], NewState), TEXT("Illegal cell transition from %s to %s at [%d, %d]"),
+		*UEnum::GetValueAsString(CellStates[CellIndex]), *UEnum::GetValueAsString(NewState), BoardLocation.X, BoardLocation.Y);
+	CellStates[CellIndex] = NewState;
+	CellTypeIds[CellIndex] = GetTypeId(Gem);
+
+	Columns[BoardLocation.X].SetGem(Gem, BoardLocation.Y);
+	DirtyRegion.MarkCell(BoardLocation);
+	Revision++;
+	WakeChunk(BoardLocation);
+}
+
+void AGameBoard::SetGemType(const FBoardLocation& Location, uint8 TypeId)
+{
+	AGemBase* Gem = GetGem(Location);
+	if (!Gem || !Registry.IsValidTypeId(TypeId))
+	{
+		return;
+	}
+
+	RecordDeltaCell(Location);
+
+	// A matched gem made special stays on the board
+	if (GetCellState(Location) == ECellState::Matched)
+	{
+		SetCellState(Location, ECellState::Settled);
+	}
+
+	Gem->SetData(Registry.Get(TypeId), TypeId);
+	CellTypeIds[GetCellIndex(Location)] = TypeId;
+	DirtyRegion.MarkCell(Location);
+	Revision++;
+	WakeChunk(Location);
+}
+
+bool AGameBoard::SetCellState(const FBoardLocation& InLocation, ECellState State)
+{
+	const int32 CellIndex = GetCellIndex(InLocation);
+	const ECellState PreviousState = CellStates[CellIndex];
+	if (!ensureMsgf(CellState::IsLegalTransition(PreviousState, State) && State != ECellState::Empty && PreviousState != ECellState::Empty,
+		TEXT("Illegal cell transition from %s to %s at [%d, %d]"), *UEnum::GetValueAsString(PreviousState), *UEnum::GetValueAsString(State), InLocation.X, InLocation.Y))
+	{
+		return false;
+	}
+
+	if (PreviousState != State)
+	{
+		CellStates[CellIndex] = State;
+
+		// A gem coming to rest can complete a line
+		if (State == ECellState::Settled)
+		{
+			DirtyRegion.MarkCell(InLocation);
+		}
+		Revision++;
+		WakeChunk(InLocation);
+	}
+	return true;
+}
+
+void AGameBoard::RecordDeltaCell(const FBoardLocation& Location)
+{
+	if (!bRecordingDelta)
+	{
+		return;
+	}
+
+	const int32 CellIndex = GetCellIndex(Location);
+	if (!DeltaTouchedCells[CellIndex])
+	{
+		DeltaTouchedCells[CellIndex] = true;
+		FBoardDelta::FCellChange& Change = DeltaCells.AddDefaulted_GetRef();
+		Change.Index = CellIndex;
+		Change.Before = CellTypeIds[CellIndex];
+	}
+}
+
+bool AGameBoard::IsClearable(const FBoardLocation& Location) const
+{
+	return GetCellState(Location) == ECellState::Settled;
+}
+
+void AGameBoard::GetSpecialClearMask(const FBoardLocation& Location, EGemSpecial Special, uint8 TargetGroup, FBoardMask& OutMask) const
+{
+	switch (Special)
+	{
+	case EGemSpecial::StripedRow:
+		OutMask.SetRow(Location.Y);
+		break;
+	case EGemSpecial::StripedColumn:
+		OutMask.SetColumn(Location.X);
+		break;
+	case EGemSpecial::Bomb:
+		OutMask.SetArea(Location, 1);
+		break;
+	case EGemSpecial::ColourBomb:
+	{
+		// Read the groups straight from the cells rather than copying the board
+		auto GetGroup = [this](uint8 TypeId)
+			{
+				return Registry.IsValidTypeId(TypeId) ? Registry.Get(TypeId).MatchGroup : TypeId;
+			};
+
+		// A colour bomb set off by another special takes the most common gem with it
+		if (TargetGroup == FGemArchetypeRegistry::InvalidTypeId)
+		{
+			// Sized with the registry, so a board of any number of types counts without touching the heap
+			TArray<int32>& Counts = ColourBombCounts;
+			FMemory::Memzero(Counts.GetData(), Counts.NumBytes());
+			for (const uint8 TypeId : CellTypeIds)
+			{
+				const uint8 Group = GetGroup(TypeId);
+				if (Registry.IsValidTypeId(Group) && Registry.Get(Group).MatchRule != EGemMatchRule::Never)
+				{
+					Counts[Group]++;
+				}
+			}
+
+			int32 MostGems = 0;
+			for (int32 Group = 0; Group < Counts.Num(); Group++)
+			{
+				if (Counts[Group] > MostGems)
+				{
+					MostGems = Counts[Group];
+					TargetGroup = static_cast<uint8>(Group);
+				}
+			}
+		}
+
+		for (int32 Index = 0; Index < CellTypeIds.Num(); Index++)
+		{
+			if (TargetGroup != FGemArchetypeRegistry::InvalidTypeId && GetGroup(CellTypeIds[Index]) == TargetGroup)
+			{
+				OutMask.Set(Index);
+			}
+		}
+		OutMask.Set(Location);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+void AGameBoard::ExpandSpecialClears(FBoardMask& InOutMask) const
+{
+	MATCHTHREE_SCOPE_CYCLE_COUNTER(STAT_MatchThree_SpecialClears);
+
+	// Each special gem is set off once. Setting one off can add more to the mask, so keep going until a pass finds none new
+	// The masks are sized with the layout, so a cascade on a board of any size does not allocate them
+	FBoardMask& Triggered = SpecialTriggered;
+	FBoardMask& Area = SpecialArea;
+	Triggered.Reset();
+	FCascadeArenaScope ArenaScope;
+	TArray<int32, TInlineAllocator<16, TCascadeArenaAllocator<>>> NewSpecials;
+	do
+	{
+		NewSpecials.Reset();
+		InOutMask.ForEachSetBit([&](int32 Index)
+			{
+				const uint8 TypeId = CellTypeIds[Index];
+				if (!Triggered.Get(Index) && Registry.IsValidTypeId(TypeId) && Registry.Get(TypeId).Special != EGemSpecial::None)
+				{
+					NewSpecials.Add(Index);
+				}
+			});
+
+		for (const int32 Index : NewSpecials)
+		{
+			Triggered.Set(Index);
+			const FBoardLocation Location = InOutMask.GetLocation(Index);
+			Area.Reset();
+			GetSpecialClearMask(Location, Registry.Get(CellTypeIds[Index]).Special, FGemArchetypeRegistry::InvalidTypeId, Area);
+
+			// Gems still falling or already in another match are left alone
+			Area.ForEachSetBit([&](int32 AreaIndex)
+				{
+					if (IsClearable(Area.GetLocation(AreaIndex)))
+					{
+						InOutMask.Set(AreaIndex);
+					}
+				});
+		}
+	}
+	while (!NewSpecials.IsEmpty());
+}
+
+bool AGameBoard::ContainsGem(AGemBase* InGem) const
+{
+	return InGem && GemLocations.Contains(InGem);
+}
+
+FVector AGameBoard::GetWorldLocation(const FBoardLocation& InLocation) const
+{
+	FVector WorldPosition = GetActorLocation();
+	WorldPosition += GetActorRightVector() * InLocation.X * CellSpacing;
+	WorldPosition += GetActorForwardVector() * InLocation.Y * CellSpacing;
+	return WorldPosition;
+}
+
+bool AGameBoard::GetBoardLocationFromRay(const FVector& RayOrigin, const FVector& RayDirection, FBoardLocation& OutLocation) const
+{
+	// Gem centers lie on the plane spanned by the board's right and forward vectors
+	const FVector BoardOrigin = GetActorLocation();
+	const FVector BoardNormal = GetActorUpVector();
+
+	const double Denominator = FVector::DotProduct(RayDirection, BoardNormal);
+	if (FMath::IsNearlyZero(Denominator))
+	{
+		return false;
+	}
+
+	const double Distance = FVector::DotProduct(BoardOrigin - RayOrigin, BoardNormal) / Denominator;
+	if (Distance < 0.)
+	{
+		return false;
+	}
+
+	// Cell centers sit on multiples of CellSpacing so round to the nearest one
+	const FVector Offset = RayOrigin + RayDirection * Distance - BoardOrigin;
+	OutLocation.X = FMath::RoundToInt32(FVector::DotProduct(Offset, GetActorRightVector()) / CellSpacing);
+	OutLocation.Y = FMath::RoundToInt32(FVector::DotProduct(Offset, GetActorForwardVector()) / CellSpacing);
+	return IsValidLocation(OutLocation);
+}
+
+bool AGameBoard::IsValidLocation(const FBoardLocation& InLocation) const
+{
+	return InLocation.X >= 0 && InLocation.X < BoardWidth && InLocation.Y >= 0 && InLocation.Y < BoardHeight;
+}
+
+int32 AGameBoard::NumberOfGems(int32 Column) const
+{
+	return Columns[Column].NumberOfGems() + Columns[Column].NumberOfGemsToSpawn();
+}
+
+void AGameBoard::ResetBoard(int32 Width, int32 Height, int32 Seed)
+{
+	ReleaseGems();
+
+	BoardWidth = FMath::Max(Width, 1);
+	BoardHeight = FMath::Max(Height, 1);
+	if (Seed != 0)
+	{
+		RandomSeed = Seed;
+	}
+	InitializeBoard();
+}
+
+void AGameBoard::ReleaseGems()
+{
+	for (const FBoardColumn& Column : Columns)
+	{
+		for (int32 Row = 0; Row < Column.GetHeight(); Row++)
+		{
+			DestroyGem(Column.GetGem(Row));
+		}
+	}
+}
+
+void AGameBoard::CaptureSnapshot(FBoardSnapshot& OutSnapshot) const
+{
+	OutSnapshot.Width = BoardWidth;
+	OutSnapshot.Height = BoardHeight;
+	OutSnapshot.NumTypes = Registry.Num();
+	OutSnapshot.RandomSeed = Random.GetCurrentSeed();
+	GetTypeIds(OutSnapshot.Cells);
+
+	OutSnapshot.SpawnQueues.SetNum(BoardWidth);
+	for (int32 X = 0; X < BoardWidth; X++)
+	{
+		TArray<uint8>& SpawnQueue = OutSnapshot.SpawnQueues[X];
+		SpawnQueue.SetNumUninitialized(Columns[X].NumberOfGemsToSpawn());
+		for (int32 Index = 0; Index < SpawnQueue.Num(); Index++)
+		{
+			SpawnQueue[Index] = Columns[X].GetGemToSpawn(Index);
+		}
+	}
+}
+
+bool AGameBoard::RestoreSnapshot(const FBoardSnapshot& Snapshot)
+{
+	if (!Snapshot.IsValid() || Snapshot.NumTypes != Registry.Num())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Snapshot of [%d] gem types does not fit a board of [%d] gem types"), Snapshot.NumTypes, Registry.Num());
+		return false;
+	}
+
+	MATCHTHREE_LLM_SCOPE(Board);
+
+	ReleaseGems();
+
+	BoardWidth = Snapshot.Width;
+	BoardHeight = Snapshot.Height;
+	InitializeLayout();
+	Random.Initialize(Snapshot.RandomSeed);
+
+	for (int32 X = 0; X < BoardWidth; X++)
+	{
+		for (const uint8 TypeId : Snapshot.SpawnQueues[X])
+		{
+			Columns[X].QueueGemToSpawn(TypeId);
+		}
+	}
+
+	// Gems above a cell a cascade had not refilled yet land straight away, and the gaps are filled as the cascade would have
+	for (int32 X = 0; X < BoardWidth; X++)
+	{
+		int32 Row = 0;
+		for (int32 Y = 0; Y < BoardHeight; Y++)
+		{
+			const uint8 TypeId = Snapshot.Cells[Snapshot.GetIndex(X, Y)];
+			if (TypeId != FBoardSnapshot::EmptyCell)
+			{
+				PlaceGem(TypeId, FBoardLocation(X, Row++), false);
+			}
+		}
+
+		for (; Row < BoardHeight; Row++)
+		{
+			PlaceGem(DequeueGemToSpawn(X), FBoardLocation(X, Row), false);
+		}
+	}
+
+	PrewarmGemPool(NumPrewarmedGems - GemPool.Num());
+	return true;
+}
+
+bool AGameBoard::LoadLevel(const FLevelView& Level)
+{
+	if (!Level.IsValid() || Level.GetNumTypes() > Registry.Num())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Level of [%d] gem types does not fit a board of [%d] gem types"), Level.IsValid() ? Level.GetNumTypes() : 0, Registry.Num());
+		return false;
+	}
+
+	// Gems fall straight through the columns, so there is nowhere for a masked cell to go yet
+	if (Level.HasMask())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Levels with masked cells are not supported by the board"));
+		return false;
+	}
+
+	MATCHTHREE_LLM_SCOPE(Board);
+
+	ReleaseGems();
+
+	BoardWidth = Level.GetWidth();
+	BoardHeight = Level.GetHeight();
+	InitializeLayout();
+	Random.Initialize(RandomSeed != 0 ? RandomSeed : static_cast<int32>(FPlatformTime::Cycles()));
+
+	for (int32 X = 0; X < BoardWidth; X++)
+	{
+		for (const uint8 TypeId : Level.GetSpawnSequence(X))
+		{
+			Columns[X].QueueGemToSpawn(TypeId);
+		}
+
+		for (int32 Y = 0; Y < BoardHeight; Y++)
+		{
+			const uint8 TypeId = Level.GetCell(X, Y);
+			PlaceGem(TypeId == LevelPack::RandomCell ? DequeueGemToSpawn(X) : TypeId, FBoardLocation(X, Y), false);
+		}
+	}
+
+	PrewarmGemPool(NumPrewarmedGems - GemPool.Num());
+	return true;
+}
+
+void AGameBoard::BeginDelta()
+{
+	CancelDelta();
+
+	bRecordingDelta = true;
+	DeltaSeedBefore = Random.GetCurrentSeed();
+}
+
+void AGameBoard::EndDelta(FBoardDelta& OutDelta)
+{
+	OutDelta.Cells.Reset(DeltaCells.Num());
+	for (FBoardDelta::FCellChange Change : DeltaCells)
+	{
+		Change.After = CellTypeIds[Change.Index];
+		if (Change.After != Change.Before)
+		{
+			OutDelta.Cells.Add(Change);
+		}
+	}
+
+	OutDelta.ConsumedSpawns = DeltaConsumedSpawns;
+	OutDelta.SeedBefore = DeltaSeedBefore;
+	OutDelta.SeedAfter = Random.GetCurrentSeed();
+
+	CancelDelta();
+}
+
+void AGameBoard::CancelDelta()
+{
+	// Clear only the bits that were set so a small move stays cheap on a large board
+	for (const FBoardDelta::FCellChange& Change : DeltaCells)
+	{
+		DeltaTouchedCells[Change.Index] = false;
+	}
+
+	bRecordingDelta = false;
+	DeltaCells.Reset();
+	DeltaConsumedSpawns.Reset();
+}
+
+void AGameBoard::ApplyDelta(const FBoardDelta& Delta, bool bUndo)
+{
+	check(!bRecordingDelta);
+	MATCHTHREE_LLM_SCOPE(Board);
+
+	// Lift the gems off the changed cells, by type, so any changed cell wanting that type can take one
+	TArray<TArray<AGemBase*>, TInlineAllocator<16>> FreeGems;
+	FreeGems.SetNum(Registry.Num());
+	for (const FBoardDelta::FCellChange& Change : Delta.Cells)
+	{
+		const FBoardLocation Location(Change.Index / BoardHeight, Change.Index % BoardHeight);
+		if (AGemBase* Gem = GetGem(Location))
+		{
+			FreeGems[GetTypeId(Gem)].Add(Gem);
+			SetGem(nullptr, Location);
+		}
+	}
+
+	for (const FBoardDelta::FCellChange& Change : Delta.Cells)
+	{
+		const uint8 TypeId = bUndo ? Change.Before : Change.After;
+		if (TypeId == FBoardDelta::EmptyCell)
+		{
+			continue;
+		}
+
+		const FBoardLocation Location(Change.Index / BoardHeight, Change.Index % BoardHeight);
+		if (!FreeGems[TypeId].IsEmpty())
+		{
+			AGemBase* Gem = FreeGems[TypeId].Pop(EAllowShrinking::No);
+			SetGem(Gem, Location, ECellState::Falling);
+			Gem->MoveTo(GetWorldLocation(Location));
+		}
+		else
+		{
+			PlaceGem(TypeId, Location, true);
+		}
+	}
+
+	for (const TArray<AGemBase*>& Gems : FreeGems)
+	{
+		for (AGemBase* Gem : Gems)
+		{
+			DestroyGem(Gem);
+		}
+	}
+
+	// Queued gems go back in the reverse of the order they were taken
+	if (bUndo)
+	{
+		for (int32 Index = Delta.ConsumedSpawns.Num() - 1; Index >= 0; Index--)
+		{
+			const FBoardDelta::FConsumedSpawn& Spawn = Delta.ConsumedSpawns[Index];
+			Columns[Spawn.Column].RequeueGemToSpawn(Spawn.TypeId);
+		}
+	}
+	else
+	{
+		for (const FBoardDelta::FConsumedSpawn& Spawn : Delta.ConsumedSpawns)
+		{
+			Columns[Spawn.Column].DequeueGemToSpawn();
+		}
+	}
+
+	Random.Initialize(bUndo ? Delta.SeedBefore : Delta.SeedAfter);
+}
+
+void AGameBoard::FindMatches(TCascadeArray<FMatch>& OutMatches)
+{
+	MATCHTHREE_SCOPE_CYCLE_COUNTER(STAT_MatchThree_MatchDetection);
+	MATCHTHREE_COUNT_ALLOCATIONS();
+
+	// Reused by every cell. Its locations are inline, so the copies into the arena do not touch the heap
+	FMatch Match;
+	auto CheckCell = [&](const FBoardLocation& Location)
+		{
+			// Matched gems are skipped by the rest of the search so no gem is matched twice
+			if (IsClearable(Location) && MatchFound(Location, Match))
+			{
+				MarkAsMatched(Match.GetLocations());
+				OutMatches.Add(Match);
+			}
+		};
+
+	// Every new line crosses a changed cell, so it lies in a dirty column or a dirty row. Clean columns cost nothing
+	const TBitArray<>& DirtyColumns = DirtyRegion.GetDirtyColumns();
+	for (TConstSetBitIterator<> Column(DirtyColumns); Column; ++Column)
+	{
+		for (int32 Y = 0; Y < BoardHeight; Y++)
+		{
+			CheckCell(FBoardLocation(Column.GetIndex(), Y));
+		}
+	}
+	for (TConstSetBitIterator<> Row(DirtyRegion.GetDirtyRows()); Row; ++Row)
+	{
+		for (int32 X = 0; X < BoardWidth; X++)
+		{
+			if (!DirtyColumns[X])
+			{
+				CheckCell(FBoardLocation(X, Row.GetIndex()));
+			}
+		}
+	}
+
+	DirtyRegion.Reset();
 }
 
+void AGameBoard::SampleGrowth(FGrowthTracker& Tracker) const
+{
+	int32 NumGemsToSpawn = 0;
+	for (const FBoardColumn& Column : Columns)
+	{
+		NumGemsToSpawn += Column.NumberOfGemsToSpawn();
+	}
 
-void AGameBoard::BeginPlay()
+	Tracker.Record(TEXT("GemLocations"), TEXT("Board"), GemLocations.Num());
+	Tracker.Record(TEXT("SpawnQueues"), TEXT("Board"), NumGemsToSpawn);
+	Tracker.Record(TEXT("MatchListeners"), TEXT("Board"), OnMatchFoundDelegate.GetAllObjects().Num());
+}
+
+void AGameBoard::PlaceInitialGems(bool bDropIn)
 {
-	Super::BeginPlay();
+	MATCHTHREE_LLM_SCOPE(Gems);
 
-	for (int Column = 0; Column < BoardWidth; Column++)
+	for (int32 X = 0; X < BoardWidth; X++)
 	{
-		Columns.Add(FBoardColumn(BoardHeight));
-		for (int Row = 0; Row < BoardHeight; Row++)
+		for (int32 Y = 0; Y < BoardHeight; Y++)
 		{
-			QueueGemToSpawn(Column);
+			PlaceGem(DequeueGemToSpawn(X), FBoardLocation(X, Y), bDropIn);
 		}
 	}
+
+	PrewarmGemPool(NumPrewarmedGems - GemPool.Num());
 }
 
-void AGameBoard::DestroyGem(AGemBase* Gem)
+AGemBase* AGameBoard::PlaceGem(uint8 TypeId, const FBoardLocation& Location, bool bDropIn)
 {
-	if (!Gem) return;
-	Gem->Destroy();
+	AGemBase* Gem = SpawnGem(Location.X, TypeId);
+	SetGem(Gem, Location, bDropIn ? ECellState::Spawning : ECellState::Settled);
+
+	// Gems dropping in are already on their cells as far as the board is concerned
+	if (bDropIn)
+	{
+		Gem->MoveTo(GetWorldLocation(Location));
+	}
+	else
+	{
+		Gem->SetActorLocation(GetWorldLocation(Location));
+	}
+	return Gem;
 }
 
-AGemBase* AGameBoard::GetGem(const FBoardLocation& InLocation) const
+void AGameBoard::PrewarmGemPool(int32 NumGems)
 {
-	return Columns[InLocation.X].GetGem(InLocation.Y);
+	if (!bPoolGems || Registry.Num() == 0)
+	{
+		return;
+	}
+
+	MATCHTHREE_LLM_SCOPE(Gems);
+	const int32 TargetNum = GemPool.Num() + NumGems;
+	GemPool.Reserve(TargetNum);
+
+	// SpawnGem would hand back the gem just pooled, so always spawn a new actor
+	FTransform SpawnTransform(GetActorRotation(), GetActorLocation(), FVector(GemScale));
+	for (int32 Index = 0; Index < NumGems; Index++)
+	{
+		AGemBase* Gem = SpawnGemActor(SpawnTransform, 0);
+		Gem->SetPooled(true);
+		GemPool.Add(Gem);
+	}
+
+	ensureMsgf(GemPool.Num() >= TargetNum, TEXT("Gem pool holds [%d] gems after prewarming to [%d]"), GemPool.Num(), TargetNum);
 }
 
-void AGameBoard::SetGem(AGemBase* Gem, const FBoardLocation& BoardLocation)
+void AGameBoard::GetTypeIds(TArray<uint8>& OutTypeIds) const
 {
-	Columns[BoardLocation.X].SetGem(Gem, BoardLocation.Y);
+	OutTypeIds = CellTypeIds;
 }
 
-bool AGameBoard::ContainsGem(AGemBase* InGem) const
+void AGameBoard::GetMatchGroups(TArray<uint8>& OutGroups) const
 {
-	for (const FBoardColumn& Column : Columns)
+	GetTypeIds(OutGroups);
+	for (uint8& TypeId : OutGroups)
 	{
-		if (Column.Contains(InGem)) return true;
+		if (Registry.IsValidTypeId(TypeId))
+		{
+			TypeId = Registry.GetMatchGroupIndex(TypeId);
+		}
 	}
-	return false;
 }
 
-FVector AGameBoard::GetWorldLocation(const FBoardLocation& InLocation) const
+uint8 AGameBoard::GetTypeId(const AGemBase* Gem) const
 {
-	FVector WorldPosition = GetActorLocation();
-	WorldPosition += GetActorRightVector() * InLocation.X * CellSpacing;
-	WorldPosition += GetActorForwardVector() * InLocation.Y * CellSpacing;
-	return WorldPosition;
+	return Gem ? Gem->GetTypeId() : FGemArchetypeRegistry::InvalidTypeId;
 }
 
-int32 AGameBoard::NumberOfGems(int32 Column) const
+int32 AGameBoard::CountLegalMoves(int32 MaxMoves) const
 {
-	return Columns[Column].NumberOfGems() + Columns[Column].NumberOfGemsToSpawn();
+	TArray<uint8> TypeIds;
+	GetMatchGroups(TypeIds);
+	return FBoardGenerator(BoardWidth, BoardHeight, Registry.GetNumMatchGroups()).CountMoves(TypeIds, MaxMoves);
+}
+
+bool AGameBoard::IsSettled() const
+{
+	for (const ECellState State : CellStates)
+	{
+		if (State != ECellState::Empty && State != ECellState::Settled)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool AGameBoard::IsColumnSettled(int32 Column) const
+{
+	// A column's cells are contiguous
+	const int32 FirstIndex = Column * BoardHeight;
+	for (int32 Index = FirstIndex; Index < FirstIndex + BoardHeight; Index++)
+	{
+		if (CellStates[Index] != ECellState::Empty && CellStates[Index] != ECellState::Settled)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool AGameBoard::Reshuffle()
+{
+	if (!IsSettled())
+	{
+		return false;
+	}
+
+	TArray<uint8> TypeIds;
+	GetMatchGroups(TypeIds);
+
+	TArray<int32> Sources;
+	const FBoardGenerator Generator(BoardWidth, BoardHeight, Registry.GetNumMatchGroups());
+	if (!Generator.Reshuffle(Random, MinLegalMoves, TypeIds, Sources))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Could not reshuffle the board into [%d] moves"), MinLegalMoves);
+		return false;
+	}
+
+	// Take every gem off the board before placing any so no gem is forgotten by a cell it is about to leave
+	TArray<AGemBase*> Gems;
+	Gems.SetNumUninitialized(Sources.Num());
+	for (int32 Index = 0; Index < Sources.Num(); Index++)
+	{
+		Gems[Index] = Columns[Sources[Index] / BoardHeight].GetGem(Sources[Index] % BoardHeight);
+	}
+	GemLocations.Reset();
+
+	for (int32 Index = 0; Index < Gems.Num(); Index++)
+	{
+		const FBoardLocation Location(Index / BoardHeight, Index % BoardHeight);
+		Columns[Location.X].SetGem(nullptr, Location.Y);
+		CellStates[Index] = ECellState::Empty;
+		CellTypeIds[Index] = FGemArchetypeRegistry::InvalidTypeId;
+		DirtyRegion.MarkCell(Location);
+		if (AGemBase* Gem = Gems[Index])
+		{
+			const bool bMoved = Sources[Index] != Index;
+			SetGem(Gem, Location, bMoved ? ECellState::Falling : ECellState::Settled);
+			if (bMoved)
+			{
+				Gem->MoveTo(GetWorldLocation(Location));
+			}
+		}
+	}
+	return true;
 }
 
 int32 AGameBoard::GetBoardWidth() const
@@ -93,6 +1009,58 @@ bool AGameBoard::CanSwapGems(AGemBase* GemA, AGemBase* GemB) const
 	return false;
 }
 
+bool AGameBoard::WouldSwapMatch(const FBoardLocation& LocationA, const FBoardLocation& LocationB) const
+{
+	MATCHTHREE_SCOPE_CYCLE_COUNTER(STAT_MatchThree_MatchDetection);
+
+	const uint8 TypeIdA = CellTypeIds[GetCellIndex(LocationA)];
+	const uint8 TypeIdB = CellTypeIds[GetCellIndex(LocationB)];
+	if (TypeIdA == FGemArchetypeRegistry::InvalidTypeId || TypeIdB == FGemArchetypeRegistry::InvalidTypeId)
+	{
+		return false;
+	}
+
+	// A colour bomb goes off when swapped with any gem
+	const uint8 ColourBombTypeId = Registry.GetColourBombTypeId();
+	if (ColourBombTypeId != FGemArchetypeRegistry::InvalidTypeId && (TypeIdA == ColourBombTypeId || TypeIdB == ColourBombTypeId))
+	{
+		return true;
+	}
+
+	// Get the type id at a location as if the swap had already happened
+	auto GetSwappedTypeId = [&](const FBoardLocation& Location)
+		{
+			if (Location == LocationA) return TypeIdB;
+			if (Location == LocationB) return TypeIdA;
+			return CellTypeIds[GetCellIndex(Location)];
+		};
+
+	// Lambda for checking if a gem of the given type would complete a line at the location
+	auto FormsMatch = [&](const FBoardLocation& Location, uint8 TypeId)
+		{
+			auto CountRun = [&](int StepX, int StepY)
+				{
+					int Count = 0;
+					FBoardLocation Candidate(Location.X + StepX, Location.Y + StepY);
+					while (Count < 2 && IsValidLocation(Candidate))
+					{
+						const uint8 CandidateTypeId = GetSwappedTypeId(Candidate);
+						if (CandidateTypeId == FGemArchetypeRegistry::InvalidTypeId || !Registry.CanMatch(CandidateTypeId, TypeId))
+							break;
+
+						Count++;
+						Candidate.X += StepX;
+						Candidate.Y += StepY;
+					}
+					return Count;
+				};
+
+			return CountRun(-1, 0) + CountRun(1, 0) >= 2 || CountRun(0, -1) + CountRun(0, 1) >= 2;
+		};
+
+	return FormsMatch(LocationA, TypeIdB) || FormsMatch(LocationB, TypeIdA);
+}
+
 void AGameBoard::MoveIntoPosition(const FBoardLocation& BoardLocation)
 {
 	AGemBase* Gem = GetGem(BoardLocation);
@@ -111,149 +1079,104 @@ void AGameBoard::MoveGemToBoardLocation(AGemBase* Gem, const FBoardLocation& New
 			const FBoardLocation OldBoardLocation = GetBoardLocation(Gem);
 			SetGem(nullptr, OldBoardLocation);
 		}
-		SetGem(Gem, NewBoardLocation);
+		SetGem(Gem, NewBoardLocation, ECellState::Falling);
 		Gem->MoveTo(GetWorldLocation(NewBoardLocation));
 	}
 }
 
-bool AGameBoard::IsInPosition(AGemBase* InGem) const
+bool AGameBoard::IsEmpty(const FBoardLocation& InLocation) const
 {
-	if (!InGem) { return false; }
-
-	const FBoardLocation InLocation = GetBoardLocation(InGem);
-	const float DistSquaredToBoardLocation = FVector::DistSquared(GetWorldLocation(InLocation), InGem->GetActorLocation());
-	if (DistSquaredToBoardLocation > 10.f || InGem->IsMoving())
-	{
-		return false;
-	}
-	return true;
+	return Columns[InLocation.X].IsEmpty(InLocation.Y);
 }
 
-bool AGameBoard::IsInPosition(const FBoardLocation& InLocation) const
+void AGameBoard::GetMatch(AGemBase* InGem, FMatch& OutMatch) const
 {
-	const AGemBase* Gem = GetGem(InLocation);
-	// An empty location is considered as in position
-	return !(Gem && Gem->IsMoving());
+	MATCHTHREE_SCOPE_CYCLE_COUNTER(STAT_MatchThree_MatchDetection);
+	MATCHTHREE_LLM_SCOPE(Matches);
+
+	OutMatch.Reset();
+
+	if (!InGem)
+		return;
+
+	GrowMatch(GetBoardLocation(InGem), OutMatch);
 }
 
-bool AGameBoard::IsEmpty(const FBoardLocation& InLocation) const
+bool AGameBoard::MatchFound(const FBoardLocation& Location, FMatch& OutMatch) const
 {
-	return Columns[InLocation.X].IsEmpty(InLocation.Y);
+	MATCHTHREE_SCOPE_CYCLE_COUNTER(STAT_MatchThree_MatchDetection);
+	MATCHTHREE_LLM_SCOPE(Matches);
+
+	OutMatch.Reset();
+	return GrowMatch(Location, OutMatch);
 }
 
-void AGameBoard::GetMatch(AGemBase* InGem, FMatch& OutMatch) const
+bool AGameBoard::GrowMatch(const FBoardLocation& Location, FMatch& OutMatch) const
 {
-	OutMatch = FMatch();
-
-	// Cannot match gems that have been matched already
-	if (!InGem || InGem->bCannotMatch)
-		return;
+	// Only settled gems match. Gems still moving or already matched are left out
+	const int32 StartIndex = GetCellIndex(Location);
+	if (CellStates[StartIndex] != ECellState::Settled) return false;
 
-	const FBoardLocation InLocation = GetBoardLocation(InGem);
+	const uint8 TypeId = CellTypeIds[StartIndex];
 
-	// Lambda for growing matches in a specific direction
-	auto GrowMatches = [&](TArray<FBoardLocation>& Matches, const FBoardLocation& Start, int StepX, int StepY, int Min, int Max)
+	// Lambda for collecting the line of matching gems through a location in one direction
+	auto CollectLine = [&](TArray<FBoardLocation, TInlineAllocator<16>>& Line, const FBoardLocation& Start, int StepX, int StepY)
 		{
-			for (int i = 1; i <= 2; ++i) // Check up to 2 steps in the specified direction
+			Line.Reset();
+			Line.Add(Start);
+			for (const int Sign : { -1, 1 })
 			{
-				int X = Start.X + i * StepX;
-				int Y = Start.Y + i * StepY;
-
-				if (X < Min || X > Max || Y < Min || Y > Max)
-					break;
-
-				AGemBase* CandidateGem = GetGem({ X, Y });
-				if (IsInPosition(CandidateGem) && CandidateGem && !CandidateGem->bCannotMatch && CandidateGem->GetType() == InGem->GetType())
-				{
-					Matches.Add({ X, Y });
-				}
-				else
+				FBoardLocation Candidate(Start.X + Sign * StepX, Start.Y + Sign * StepY);
+				while (IsValidLocation(Candidate))
 				{
-					break;
+					const int32 CandidateIndex = GetCellIndex(Candidate);
+					if (CellStates[CandidateIndex] != ECellState::Settled || !Registry.CanMatch(CellTypeIds[CandidateIndex], TypeId))
+						break;
+
+					Line.Add(Candidate);
+					Candidate.X += Sign * StepX;
+					Candidate.Y += Sign * StepY;
 				}
 			}
 		};
 
-	// Horizontal match check
-	TArray<FBoardLocation> Matches = { InLocation };
-	GrowMatches(Matches, InLocation, -1, 0, 0, BoardWidth - 1); // Grow left
-	GrowMatches(Matches, InLocation, 1, 0, 0, BoardWidth - 1);  // Grow right
-
-	if (Matches.Num() >= 3)
-	{
-		OutMatch.AddLocations(Matches);
-		return;
-	}
-
-	// Vertical match check
-	Matches.Empty();
-	Matches.Add(InLocation);
-	GrowMatches(Matches, InLocation, 0, -1, 0, BoardHeight - 1); // Grow down
-	GrowMatches(Matches, InLocation, 0, 1, 0, BoardHeight - 1);  // Grow up
+	TArray<FBoardLocation, TInlineAllocator<16>> Line;
+	TArray<FBoardLocation, TInlineAllocator<16>> CrossLine;
 
-	if (Matches.Num() >= 3)
+	// Each line of three or more through the location joins the match, with the lines crossing it at its other gems
+	for (const bool bHorizontal : { true, false })
 	{
-		OutMatch.AddLocations(Matches);
-	}
-}
-
-bool AGameBoard::MatchFound(const FBoardLocation& Location, FMatch& OutMatch) const
-{
-	OutMatch = FMatch();
-
-	// Lambda for growing matches in a specific direction
-	auto GrowMatches = [&](TArray<FBoardLocation>& Matches, const FBoardLocation& Start, int StepX, int StepY, int Min, int Max)
+		CollectLine(Line, Location, bHorizontal ? 1 : 0, bHorizontal ? 0 : 1);
+		if (Line.Num() < 3)
 		{
-			AGemBase* StartGem = GetGem(Start);
-			if (!StartGem) return;
+			continue;
+		}
 
-			for (int i = 1; i <= 2; ++i) // Check up to 2 steps in the specified direction
+		for (int32 Index = 0; Index < Line.Num(); Index++)
+		{
+			OutMatch.AddLocation(Line[Index]);
+			if (Index > 0)
 			{
-				int X = Start.X + i * StepX;
-				int Y = Start.Y + i * StepY;
-
-				if (X < Min || X > Max || Y < Min || Y > Max)
-					break;
-
-				AGemBase* CandidateGem = GetGem({ X, Y });
-				if (IsInPosition(CandidateGem) && CandidateGem && !CandidateGem->bCannotMatch && CandidateGem->GetType() == StartGem->GetType())
-				{
-					Matches.Add({ X, Y });
-				}
-				else
+				CollectLine(CrossLine, Line[Index], bHorizontal ? 0 : 1, bHorizontal ? 1 : 0);
+				if (CrossLine.Num() >= 3)
 				{
-					break;
+					for (const FBoardLocation& CrossLocation : CrossLine)
+					{
+						OutMatch.AddLocation(CrossLocation);
+					}
 				}
 			}
-		};
-
-	// Horizontal match check
-	TArray<FBoardLocation> Matches = { Location };
-	GrowMatches(Matches, Location, -1, 0, 0, BoardWidth - 1); // Grow left
-	GrowMatches(Matches, Location, 1, 0, 0, BoardWidth - 1);  // Grow right
-
-	if (Matches.Num() >= 3)
-	{
-		OutMatch.AddLocations(Matches);
-		return true;
+		}
 	}
 
-	// Vertical match check
-	Matches.Empty();
-	Matches.Add(Location);
-	GrowMatches(Matches, Location, 0, -1, 0, BoardHeight - 1); // Grow down
-	GrowMatches(Matches, Location, 0, 1, 0, BoardHeight - 1);  // Grow up
-
-	if (Matches.Num() >= 3)
-	{
-		OutMatch.AddLocations(Matches);
-		return true;
-	}
-	return false;
+	return !OutMatch.IsEmpty();
 }
 
-AGemBase* AGameBoard::SpawnGem(int32 Column, EGemType GemType)
+AGemBase* AGameBoard::SpawnGem(int32 Column, uint8 TypeId)
 {
+	MATCHTHREE_SCOPE_CYCLE_COUNTER(STAT_MatchThree_SpawnGem);
+	MATCHTHREE_LLM_SCOPE(Gems);
+
 	const int Row = Columns[Column].GetHeight();
 	FVector SpawnLocation = GetActorLocation();
 	SpawnLocation += GetActorRightVector() * Column * CellSpacing;
@@ -262,26 +1185,72 @@ AGemBase* AGameBoard::SpawnGem(int32 Column, EGemType GemType)
 	SpawnTransform.SetLocation(SpawnLocation);
 	SpawnTransform.SetRotation(GetActorRotation().Quaternion());
 
-	AGemBase* GemToPlace = GetWorld()->SpawnActorDeferred<AGemBase>(GemActorClass, SpawnTransform);
-	GemToPlace->SetData(GemData[GemType]);
-	GemToPlace->SetActorScale3D(FVector(GemScale, GemScale, GemScale));
-	GemToPlace->OnGemMoveToCompleteDelegate.AddUniqueDynamic(this, &AGameBoard::HandleGemMoveToComplete);
-	GemToPlace->FinishSpawning(SpawnTransform);
+	SpawnTransform.SetScale3D(FVector(GemScale, GemScale, GemScale));
+
+	AGemBase* GemToPlace = nullptr;
+	if (!GemPool.IsEmpty())
+	{
+		GemToPlace = GemPool.Pop(EAllowShrinking::No);
+		GemToPlace->SetActorTransform(SpawnTransform);
+		GemToPlace->SetData(Registry.Get(TypeId), TypeId);
+		GemToPlace->OnGemMoveToCompleteDelegate.AddUniqueDynamic(this, &AGameBoard::HandleGemMoveToComplete);
+		GemToPlace->SetPooled(false);
+	}
+	else
+	{
+		GemToPlace = SpawnGemActor(SpawnTransform, TypeId);
+	}
+	MATCHTHREE_RECORD_EVENT(GemSpawned, static_cast<int32>(GemToPlace->GetUniqueID()));
 	return GemToPlace;
 }
 
+AGemBase* AGameBoard::SpawnGemActor(const FTransform& SpawnTransform, uint8 TypeId)
+{
+	AGemBase* Gem = GetWorld()->SpawnActorDeferred<AGemBase>(GemActorClass, SpawnTransform);
+	Gem->SetData(Registry.Get(TypeId), TypeId);
+	Gem->OnGemMoveToCompleteDelegate.AddUniqueDynamic(this, &AGameBoard::HandleGemMoveToComplete);
+	Gem->FinishSpawning(SpawnTransform);
+	return Gem;
+}
+
 void AGameBoard::HandleGemMoveToComplete(AGemBase* InGem)
 {
-	// Look for matches
-	FMatch Match;
-	GetMatch(InGem, Match);
+	if (!ContainsGem(InGem))
+	{
+		return;
+	}
+
+	// Keep the chunk awake until the landing has been resolved
+	const FBoardLocation Location = GetBoardLocation(InGem);
+	WakeChunk(Location);
 
-	if (!Match.IsEmpty())
+	// A falling or spawning gem has landed. Swapping gems are settled by their swap
+	const ECellState State = GetCellState(Location);
+	if (State == ECellState::Falling || State == ECellState::Spawning)
 	{
-		MarkAsMatched(Match.GetLocations());
-		TArray<FMatch> Matches{ Match };
-		OnMatchFoundDelegate.Broadcast(Matches);
+		SetCellState(Location, ECellState::Settled);
 	}
+
+	// The board worker has already resolved every match
+	if (bPresentationOnly)
+	{
+		return;
+	}
+
+	// Look for matches
+	{
+		MATCHTHREE_COUNT_ALLOCATIONS();
+		LandingMatches.SetNum(1);
+		GetMatch(InGem, LandingMatches[0]);
+		if (LandingMatches[0].IsEmpty())
+		{
+			return;
+		}
+		MarkAsMatched(LandingMatches[0].GetLocations());
+	}
+
+	MATCHTHREE_SCOPE_CYCLE_COUNTER(STAT_MatchThree_Broadcast);
+	OnMatchFoundDelegate.Broadcast(LandingMatches);
 }
 
 FBoardLocation AGameBoard::GetNextEmptyLocationBelow(const FBoardLocation& InLocation) const
@@ -300,21 +1269,31 @@ FBoardLocation AGameBoard::GetTopEmptyLocation(int32 Column) const
 	return OutLocation;
 }
 
-EGemType AGameBoard::GetRandomGemType() const
+uint8 AGameBoard::GetRandomTypeId() const
 {
-	TArray<EGemType> GemTypes;
-	int NumGemTypes = GemData.GetKeys(GemTypes);
-	return GemTypes[FMath::RandRange(0, NumGemTypes - 1)];
+	return Registry.PickRandom(Random);
 }
 
 void AGameBoard::QueueGemToSpawn(int32 Column)
 {
-	Columns[Column].QueueGemToSpawn(GetRandomGemType());
+	MATCHTHREE_LLM_SCOPE(Board);
+	Columns[Column].QueueGemToSpawn(GetRandomTypeId());
 }
 
-EGemType AGameBoard::DequeueGemToSpawn(int32 Column)
+uint8 AGameBoard::DequeueGemToSpawn(int32 Column)
 {
-	QueueGemToSpawn(Column);
+	// Refills after the generated board has been placed are random
+	if (Columns[Column].NumberOfGemsToSpawn() == 0)
+	{
+		QueueGemToSpawn(Column);
+	}
+	else if (bRecordingDelta)
+	{
+		// Random refills come back from the random stream, but queued gems must be put back by hand
+		FBoardDelta::FConsumedSpawn& Spawn = DeltaConsumedSpawns.AddDefaulted_GetRef();
+		Spawn.Column = static_cast<uint16>(Column);
+		Spawn.TypeId = Columns[Column].GetGemToSpawn(0);
+	}
 	return Columns[Column].DequeueGemToSpawn();
 }
 
@@ -332,12 +1311,82 @@ bool AGameBoard::CanMoveDown(const FBoardLocation& InLocation) const
 	return !IsEmpty(InLocation) && LocationBelow.Y >= 0 && IsEmpty(LocationBelow);
 }
 
+int32 AGameBoard::CompactColumn(int32 Column, int32 FirstRow)
+{
+	MATCHTHREE_SCOPE_CYCLE_COUNTER(STAT_MatchThree_CollapseColumn);
+
+	// Gems keep their order, so each one lands on the next free row above the gems already placed
+	int32 NumFallen = 0;
+	int32 TargetRow = FMath::Max(FirstRow, 0);
+	for (int32 Row = TargetRow; Row < BoardHeight; Row++)
+	{
+		AGemBase* Gem = Columns[Column].GetGem(Row);
+		if (!Gem)
+		{
+			continue;
+		}
+
+		if (Row != TargetRow)
+		{
+			const FBoardLocation Location(Column, TargetRow);
+			SetGem(nullptr, FBoardLocation(Column, Row));
+			SetGem(Gem, Location, ECellState::Falling);
+
+			Gem->MoveTo(GetWorldLocation(Location), GetFallDelay(NumFallen));
+			NumFallen++;
+		}
+		TargetRow++;
+	}
+	return NumFallen;
+}
+
+float AGameBoard::GetFallDelay(int32 NumFallen) const
+{
+	return FallStaggerCurve ? FallStaggerCurve->GetFloatValue(static_cast<float>(NumFallen)) : 0.f;
+}
+
+void AGameBoard::ApplyBoardEvent(const FBoardEvent& Event)
+{
+	switch (Event.Type)
+	{
+	case EBoardEventType::Destroy:
+		if (AGemBase* Gem = GetGem(Event.Location))
+		{
+			SetGem(nullptr, Event.Location);
+			DestroyGem(Gem);
+		}
+		break;
+	case EBoardEventType::Move:
+		if (AGemBase* Gem = GetGem(Event.Location))
+		{
+			SetGem(nullptr, Event.Location);
+			SetGem(Gem, Event.Target, ECellState::Falling);
+			Gem->MoveTo(GetWorldLocation(Event.Target), GetFallDelay(Event.Order));
+		}
+		break;
+	case EBoardEventType::Spawn:
+		if (Event.bFromSpawnQueue && Columns[Event.Location.X].NumberOfGemsToSpawn() > 0)
+		{
+			Columns[Event.Location.X].DequeueGemToSpawn();
+		}
+		Random.Initialize(Event.RandomSeed);
+		PlaceGem(Event.TypeId, Event.Location, true);
+		break;
+	case EBoardEventType::Settled:
+		Random.Initialize(Event.RandomSeed);
+		break;
+	default:
+		break;
+	}
+}
+
 void AGameBoard::SpawnGemInColumn(int32 Column)
 {
-	EGemType GemType = DequeueGemToSpawn(Column);
-	AGemBase* Gem = SpawnGem(Column, GemType);
+	const uint8 TypeId = DequeueGemToSpawn(Column);
+	AGemBase* Gem = SpawnGem(Column, TypeId);
 	const FBoardLocation NewBoardLocation = GetTopEmptyLocation(Column);
-	MoveGemToBoardLocation(Gem, NewBoardLocation);
+	SetGem(Gem, NewBoardLocation, ECellState::Spawning);
+	Gem->MoveTo(GetWorldLocation(NewBoardLocation));
 }
 
 FBoardLocation AGameBoard::GetBoardLocation(const AGemBase* Gem) const
@@ -349,20 +1398,9 @@ FBoardLocation AGameBoard::GetBoardLocation(const AGemBase* Gem) const
 	}
 	else
 	{
-		FBoardLocation BoardLocation;
-		for (int i = 0; i < Columns.Num(); i++)
+		if (const FBoardLocation* BoardLocation = GemLocations.Find(Gem))
 		{
-			int Index = Columns[i].GetIndex(Gem);
-			if (Index == -1)
-			{
-				continue;
-			}
-			else
-			{
-				BoardLocation.X = i;
-				BoardLocation.Y = Index;
-				return BoardLocation;
-			}
+			return *BoardLocation;
 		}
 	}
 	UE_LOG(LogTemp, Error, TEXT("Gem [&s] does not exist on the board. Returning default location."), Gem->GetFName());
@@ -375,12 +1413,14 @@ void AGameBoard::Remove(AGemBase* InGem)
 	SetGem(nullptr, BoardLocation);
 }
 
-void AGameBoard::MarkAsMatched(const TArray<FBoardLocation>& Locations)
+void AGameBoard::MarkAsMatched(TConstArrayView<FBoardLocation> Locations)
 {
 	for (FBoardLocation Location : Locations)
 	{
-		AGemBase* Gem = GetGem(Location);
-		if (Gem) Gem->bCannotMatch = true;
+		if (GetCellState(Location) == ECellState::Settled)
+		{
+			SetCellState(Location, ECellState::Matched);
+		}
 	}
 }
 
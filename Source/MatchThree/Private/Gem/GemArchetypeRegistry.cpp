@@ -0,0 +1,182 @@
+// Copyright Peter Carsten Collins (2024)
+
+
+#include "Gem/GemArchetypeRegistry.h"
+
+#include "Gem/GemDataAsset.h"
+#include "Materials/MaterialInstance.h"
+
+void FGemArchetypeRegistry::Build(TConstArrayView<UGemDataAsset*> DataAssets)
+{
+	Archetypes.Reset();
+	SpawnableTypeIds.Reset();
+	SpecialVariants.Reset();
+	ColourBombTypeId = InvalidTypeId;
+
+	for (UGemDataAsset* DataAsset : DataAssets)
+	{
+		if (!DataAsset)
+		{
+			continue;
+		}
+		if (Archetypes.Num() == MaxArchetypes)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Only the first [%d] gem archetypes can be used"), MaxArchetypes);
+			break;
+		}
+
+		if (DataAsset->SpawnWeight > 0.f)
+		{
+			SpawnableTypeIds.Add(static_cast<uint8>(Archetypes.Num()));
+		}
+
+		FGemArchetype& Archetype = Archetypes.AddDefaulted_GetRef();
+		Archetype.DataAsset = DataAsset;
+		Archetype.Mesh = DataAsset->Mesh;
+		Archetype.Material = DataAsset->Material;
+		Archetype.SpawnWeight = FMath::Max(DataAsset->SpawnWeight, 0.f);
+		Archetype.MatchRule = DataAsset->MatchRule;
+		Archetype.Special = DataAsset->Special;
+		Archetype.MatchGroup = static_cast<uint8>(Archetypes.Num() - 1);
+	}
+	IndexMatchGroups();
+
+	// Build the alias table with Vose's method so a weighted pick costs two random numbers whatever the number of types
+	const int32 NumSpawnable = SpawnableTypeIds.Num();
+	AliasProbabilities.SetNumUninitialized(NumSpawnable);
+	Aliases.SetNumUninitialized(NumSpawnable);
+
+	float TotalWeight = 0.f;
+	for (const uint8 TypeId : SpawnableTypeIds)
+	{
+		TotalWeight += Archetypes[TypeId].SpawnWeight;
+	}
+
+	TArray<int32, TInlineAllocator<32>> Small;
+	TArray<int32, TInlineAllocator<32>> Large;
+	TArray<float, TInlineAllocator<32>> Scaled;
+	Scaled.SetNumUninitialized(NumSpawnable);
+	for (int32 Index = 0; Index < NumSpawnable; Index++)
+	{
+		Scaled[Index] = Archetypes[SpawnableTypeIds[Index]].SpawnWeight * NumSpawnable / TotalWeight;
+		(Scaled[Index] < 1.f ? Small : Large).Add(Index);
+	}
+
+	while (!Small.IsEmpty() && !Large.IsEmpty())
+	{
+		const int32 Less = Small.Pop(EAllowShrinking::No);
+		const int32 More = Large.Pop(EAllowShrinking::No);
+		AliasProbabilities[Less] = Scaled[Less];
+		Aliases[Less] = SpawnableTypeIds[More];
+
+		Scaled[More] = Scaled[More] + Scaled[Less] - 1.f;
+		(Scaled[More] < 1.f ? Small : Large).Add(More);
+	}
+
+	// Whatever is left is full up to rounding error
+	for (const int32 Index : Small)
+	{
+		AliasProbabilities[Index] = 1.f;
+		Aliases[Index] = SpawnableTypeIds[Index];
+	}
+	for (const int32 Index : Large)
+	{
+		AliasProbabilities[Index] = 1.f;
+		Aliases[Index] = SpawnableTypeIds[Index];
+	}
+}
+
+void FGemArchetypeRegistry::AddSpecialVariants(const TMap<EGemSpecial, TObjectPtr<UMaterialInterface>>& Materials, UGemDataAsset* ColourBombData)
+{
+	SpecialVariants.Init(InvalidTypeId, Archetypes.Num() * NumSpecials);
+
+	for (const uint8 TypeId : SpawnableTypeIds)
+	{
+		for (const EGemSpecial Special : { EGemSpecial::StripedRow, EGemSpecial::StripedColumn, EGemSpecial::Bomb })
+		{
+			if (Archetypes.Num() == MaxArchetypes)
+			{
+				UE_LOG(LogTemp, Error, TEXT("No room for more special gem archetypes"));
+				IndexMatchGroups();
+				return;
+			}
+
+			// Copy before adding since adding can move the array
+			FGemArchetype Variant = Archetypes[TypeId];
+			Variant.SpawnWeight = 0.f;
+			Variant.Special = Special;
+			if (const TObjectPtr<UMaterialInterface>* Material = Materials.Find(Special))
+			{
+				Variant.Material = *Material;
+			}
+
+			SpecialVariants[TypeId * NumSpecials + static_cast<int32>(Special)] = static_cast<uint8>(Archetypes.Num());
+			Archetypes.Add(Variant);
+		}
+	}
+
+	if (ColourBombData && Archetypes.Num() < MaxArchetypes)
+	{
+		ColourBombTypeId = static_cast<uint8>(Archetypes.Num());
+
+		// A colour bomb is set off by swapping it, never by a match
+		FGemArchetype& ColourBomb = Archetypes.AddDefaulted_GetRef();
+		ColourBomb.DataAsset = ColourBombData;
+		ColourBomb.Mesh = ColourBombData->Mesh;
+		ColourBomb.Material = ColourBombData->Material;
+		ColourBomb.SpawnWeight = 0.f;
+		ColourBomb.MatchRule = EGemMatchRule::Never;
+		ColourBomb.Special = EGemSpecial::ColourBomb;
+		ColourBomb.MatchGroup = ColourBombTypeId;
+	}
+	IndexMatchGroups();
+}
+
+void FGemArchetypeRegistry::IndexMatchGroups()
+{
+	TArray<uint8, TInlineAllocator<32>> GroupIndices;
+	GroupIndices.Init(InvalidTypeId, Archetypes.Num());
+
+	MatchGroupIndices.SetNumUninitialized(Archetypes.Num());
+	NumMatchGroups = 0;
+	for (int32 TypeId = 0; TypeId < Archetypes.Num(); TypeId++)
+	{
+		uint8& GroupIndex = GroupIndices[Archetypes[TypeId].MatchGroup];
+		if (GroupIndex == InvalidTypeId)
+		{
+			GroupIndex = static_cast<uint8>(NumMatchGroups++);
+		}
+		MatchGroupIndices[TypeId] = GroupIndex;
+	}
+}
+
+uint8 FGemArchetypeRegistry::GetSpecialVariant(uint8 TypeId, EGemSpecial Special) const
+{
+	if (Special == EGemSpecial::ColourBomb)
+	{
+		return ColourBombTypeId;
+	}
+
+	if (!IsValidTypeId(TypeId))
+	{
+		return InvalidTypeId;
+	}
+
+	// A special gem upgrades through the gem it is a version of
+	const int32 Index = Archetypes[TypeId].MatchGroup * NumSpecials + static_cast<int32>(Special);
+	return SpecialVariants.IsValidIndex(Index) ? SpecialVariants[Index] : InvalidTypeId;
+}
+
+uint8 FGemArchetypeRegistry::FindTypeId(const UGemDataAsset* DataAsset) const
+{
+	const int32 TypeId = Archetypes.IndexOfByPredicate([DataAsset](const FGemArchetype& Archetype) { return Archetype.DataAsset == DataAsset; });
+	return TypeId == INDEX_NONE ? InvalidTypeId : static_cast<uint8>(TypeId);
+}
+
+uint8 FGemArchetypeRegistry::PickRandom(FRandomStream& Random) const
+{
+	check(!SpawnableTypeIds.IsEmpty());
+
+	const int32 Index = Random.RandHelper(SpawnableTypeIds.Num());
+	return Random.GetFraction() < AliasProbabilities[Index] ? SpawnableTypeIds[Index] : Aliases[Index];
+}
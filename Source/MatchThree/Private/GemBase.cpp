@@ -5,8 +5,9 @@
 
 #include "Components/SpinnerComponent.h"
 #include "Components/GemMovementComponent.h"
-#include "Gem/GemDataAsset.h"
-#include "MatchThree/MatchThree.h"
+#include "Engine/CollisionProfile.h"
+#include "Gem/GemArchetypeRegistry.h"
+#include "Profiling/MatchThreeStats.h"
 
 AGemBase::AGemBase()
 {
@@ -15,7 +16,9 @@ AGemBase::AGemBase()
 	StaticMesh = CreateDefaultSubobject<UStaticMeshComponent>("StaticMesh");
 	SetRootComponent(StaticMesh);
 
-	StaticMesh->SetCollisionResponseToChannel(ECC_Gem, ECR_Block);
+	// Gems are picked analytically by the game board so they never need to be in the physics scene
+	StaticMesh->SetCollisionProfileName(UCollisionProfile::NoCollision_ProfileName);
+	StaticMesh->SetGenerateOverlapEvents(false);
 
 	SpinnerComponent = CreateDefaultSubobject<USpinnerComponent>("SpinnerComponent");
 
@@ -27,35 +30,91 @@ AGemBase::AGemBase()
 void AGemBase::BeginPlay()
 {
 	Super::BeginPlay();
-}
 
+	MATCHTHREE_COUNTER_INC(LiveGems);
+}
 
-void AGemBase::SetData(UGemDataAsset* GemData)
+void AGemBase::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	if (!GemData) 
+	if (bIsPooled)
+	{
+		MATCHTHREE_COUNTER_DEC(PooledGems);
+	}
+	else
 	{
-		UE_LOG(LogTemp, Error, TEXT("Invalid GemDataAsset pointer!"));
+		MATCHTHREE_COUNTER_DEC(LiveGems);
 	}
 
-	StaticMesh->SetStaticMesh(GemData->Mesh);
-	StaticMesh->SetMaterial(0, GemData->Material);
-	Type = GemData->Type; 
+	Super::EndPlay(EndPlayReason);
 }
 
-void AGemBase::MoveTo(const FVector& NewLocation)
+
+void AGemBase::SetData(const FGemArchetype& Archetype, uint8 InTypeId)
 {
+	// Pooled gems are usually reused as the same type, so skip the render state updates when nothing changes
+	if (StaticMesh->GetStaticMesh() != Archetype.Mesh)
+	{
+		StaticMesh->SetStaticMesh(Archetype.Mesh);
+	}
+	if (StaticMesh->GetMaterial(0) != Archetype.Material)
+	{
+		StaticMesh->SetMaterial(0, Archetype.Material);
+	}
+	TypeId = InTypeId;
+}
+
+void AGemBase::MoveTo(const FVector& NewLocation, float Delay)
+{
+	SetSleeping(false);
 	MovementComponent->OnMoveToCompleteDelegate.AddUniqueDynamic(this, &AGemBase::HandleMoveToComplete);
-	MovementComponent->MoveTo(NewLocation);
+	MovementComponent->MoveTo(NewLocation, Delay);
 }
 
 void AGemBase::SetSelected(bool bInSelected)
 {
+	// The spinner needs to tick to start and to restore the rotation when stopping
+	SetSleeping(false);
 	bIsSelected = bInSelected;
 	bIsSelected ? SpinnerComponent->Start() : SpinnerComponent->Stop();
 }
 
+void AGemBase::SetSleeping(bool bInSleeping)
+{
+	if (bIsSleeping == bInSleeping) return;
+
+	bIsSleeping = bInSleeping;
+	SetActorTickEnabled(!bIsSleeping);
+	MovementComponent->SetComponentTickEnabled(!bIsSleeping);
+	SpinnerComponent->SetComponentTickEnabled(!bIsSleeping);
+}
+
+void AGemBase::SetPooled(bool bInPooled)
+{
+	if (bIsPooled == bInPooled) return;
+
+	bIsPooled = bInPooled;
+	if (bIsPooled)
+	{
+		// Whatever was listening to the gem was listening to it on the board
+		OnGemMoveToCompleteDelegate.Clear();
+		MovementComponent->Stop();
+		SetSelected(false);
+		MATCHTHREE_COUNTER_DEC(LiveGems);
+		MATCHTHREE_COUNTER_INC(PooledGems);
+	}
+	else
+	{
+		MATCHTHREE_COUNTER_INC(LiveGems);
+		MATCHTHREE_COUNTER_DEC(PooledGems);
+	}
+
+	SetActorHiddenInGame(bIsPooled);
+	SetSleeping(bIsPooled);
+}
+
 void AGemBase::HandleMoveToComplete()
 {
+	MATCHTHREE_SCOPE_CYCLE_COUNTER(STAT_MatchThree_Broadcast);
 	OnGemMoveToCompleteDelegate.Broadcast(this);
 }
 
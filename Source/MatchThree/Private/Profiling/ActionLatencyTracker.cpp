@@ -0,0 +1,114 @@
+// Copyright Peter Carsten Collins (2024)
+
+
+#include "Profiling/ActionLatencyTracker.h"
+
+FLatencyHistogram::FLatencyHistogram()
+{
+	Buckets.Init(0, NumBuckets);
+}
+
+void FLatencyHistogram::Add(double Milliseconds)
+{
+	const double Ratio = FMath::Max(Milliseconds, MinMilliseconds) / MinMilliseconds;
+	const int32 Bucket = FMath::Clamp(FMath::FloorToInt32(FMath::Loge(Ratio) / FMath::Loge(BucketGrowth)), 0, NumBuckets - 1);
+	Buckets[Bucket]++;
+	NumSamples++;
+}
+
+double FLatencyHistogram::GetPercentile(double Fraction) const
+{
+	if (NumSamples == 0)
+	{
+		return 0.;
+	}
+
+	const int64 Rank = FMath::CeilToInt64(Fraction * NumSamples);
+	int64 Seen = 0;
+	for (int32 Bucket = 0; Bucket < NumBuckets; Bucket++)
+	{
+		Seen += Buckets[Bucket];
+		if (Seen >= Rank)
+		{
+			// Report the middle of the bucket
+			return MinMilliseconds * FMath::Pow(BucketGrowth, Bucket + .5);
+		}
+	}
+	return MinMilliseconds * FMath::Pow(BucketGrowth, NumBuckets);
+}
+
+uint32 FActionLatencyTracker::BeginSpan()
+{
+	const uint32 SpanId = NextSpanId++;
+
+	FSpan& Span = OpenSpans.Add(SpanId);
+	for (double& PhaseTime : Span.PhaseTimes)
+	{
+		PhaseTime = -1.;
+	}
+	Span.PhaseTimes[static_cast<int32>(EActionPhase::Input)] = FPlatformTime::Seconds();
+	return SpanId;
+}
+
+void FActionLatencyTracker::MarkPhase(uint32 SpanId, EActionPhase Phase)
+{
+	FSpan* Span = OpenSpans.Find(SpanId);
+	if (!Span)
+	{
+		return;
+	}
+
+	double& PhaseTime = Span->PhaseTimes[static_cast<int32>(Phase)];
+	if (PhaseTime < 0.)
+	{
+		PhaseTime = FPlatformTime::Seconds();
+	}
+}
+
+double FActionLatencyTracker::EndSpan(uint32 SpanId)
+{
+	MarkPhase(SpanId, EActionPhase::Settled);
+
+	FSpan Span;
+	if (!OpenSpans.RemoveAndCopyValue(SpanId, Span))
+	{
+		return -1.;
+	}
+
+	const double InputTime = Span.PhaseTimes[static_cast<int32>(EActionPhase::Input)];
+	for (int32 Phase = static_cast<int32>(EActionPhase::Feedback); Phase < static_cast<int32>(EActionPhase::MAX); Phase++)
+	{
+		if (Span.PhaseTimes[Phase] >= 0.)
+		{
+			PhaseHistograms[Phase].Add((Span.PhaseTimes[Phase] - InputTime) * 1000.);
+		}
+	}
+
+	const double SettleMilliseconds = (Span.PhaseTimes[static_cast<int32>(EActionPhase::Settled)] - InputTime) * 1000.;
+	UE_LOG(LogTemp, Verbose, TEXT("Action [%u] settled after [%.1f ms]"), SpanId, SettleMilliseconds);
+	return SettleMilliseconds;
+}
+
+void FActionLatencyTracker::CancelSpan(uint32 SpanId)
+{
+	OpenSpans.Remove(SpanId);
+}
+
+double FActionLatencyTracker::GetPercentile(EActionPhase Phase, double Fraction) const
+{
+	return PhaseHistograms[static_cast<int32>(Phase)].GetPercentile(Fraction);
+}
+
+void FActionLatencyTracker::LogReport() const
+{
+	static const TCHAR* PhaseNames[] = { TEXT("Input"), TEXT("Feedback"), TEXT("SwapCompleted"), TEXT("Resolved"), TEXT("Settled") };
+	static_assert(UE_ARRAY_COUNT(PhaseNames) == static_cast<int32>(EActionPhase::MAX), "Every action phase needs a name");
+
+	UE_LOG(LogTemp, Display, TEXT("Input latency report"));
+	for (int32 Phase = static_cast<int32>(EActionPhase::Feedback); Phase < static_cast<int32>(EActionPhase::MAX); Phase++)
+	{
+		const FLatencyHistogram& Histogram = PhaseHistograms[Phase];
+		UE_LOG(LogTemp, Display, TEXT("  Input to %-14s p50 %8.1f ms  p95 %8.1f ms  p99 %8.1f ms  (%lld actions)"), PhaseNames[Phase],
+			Histogram.GetPercentile(.5), Histogram.GetPercentile(.95), Histogram.GetPercentile(.99), Histogram.Num());
+	}
+}
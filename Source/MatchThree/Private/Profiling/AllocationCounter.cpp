@@ -0,0 +1,112 @@
+// Copyright Peter Carsten Collins (2024)
+
+
+#include "Profiling/AllocationCounter.h"
+
+#include "HAL/MemoryBase.h"
+#include "Profiling/MatchThreeStats.h"
+#include <atomic>
+
+namespace
+{
+	// How deep the calling thread is in counted scopes, and the allocations it has made inside them
+	thread_local int32 GScopeDepth = 0;
+	thread_local uint64 GThreadCount = 0;
+
+	std::atomic<bool> GInstalled{ false };
+
+	/* Forwards everything to the allocator it wraps, counting allocations made inside counted scopes */
+	class FMallocCountingProxy final : public FMalloc
+	{
+	public:
+		explicit FMallocCountingProxy(FMalloc* InInner)
+			: Inner(InInner)
+		{
+		}
+
+		//~ Begin FMalloc interface
+		virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+		{
+			CountAllocation();
+			return Inner->Malloc(Count, Alignment);
+		}
+
+		virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			// Shrinking to nothing is a free
+			if (Count > 0)
+			{
+				CountAllocation();
+			}
+			return Inner->Realloc(Original, Count, Alignment);
+		}
+
+		virtual void Free(void* Original) override { Inner->Free(Original); }
+		virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override { return Inner->QuantizeSize(Count, Alignment); }
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return Inner->GetAllocationSize(Original, SizeOut); }
+		virtual void Trim(bool bTrimThreadCaches) override { Inner->Trim(bTrimThreadCaches); }
+		virtual void SetupTLSCachesOnCurrentThread() override { Inner->SetupTLSCachesOnCurrentThread(); }
+		virtual void ClearAndDisableTLSCachesOnCurrentThread() override { Inner->ClearAndDisableTLSCachesOnCurrentThread(); }
+		virtual void InitializeStatsMetadata() override { Inner->InitializeStatsMetadata(); }
+		virtual void UpdateStats() override { Inner->UpdateStats(); }
+		virtual void GetAllocatorStats(FGenericMemoryStats& OutStats) override { Inner->GetAllocatorStats(OutStats); }
+		virtual void DumpAllocatorStats(FOutputDevice& Ar) override { Inner->DumpAllocatorStats(Ar); }
+		virtual bool IsInternallyThreadSafe() const override { return Inner->IsInternallyThreadSafe(); }
+		virtual bool ValidateHeap() override { return Inner->ValidateHeap(); }
+		virtual const TCHAR* GetDescriptiveName() override { return Inner->GetDescriptiveName(); }
+		//~ End FMalloc interface
+
+	private:
+		// Must not allocate, since it runs inside the allocator
+		static void CountAllocation()
+		{
+			if (GScopeDepth > 0)
+			{
+				GThreadCount++;
+			}
+		}
+
+		FMalloc* Inner;
+	};
+}
+
+void FAllocationCounter::Install()
+{
+	bool bExpected = false;
+	if (!GInstalled.compare_exchange_strong(bExpected, true))
+	{
+		return;
+	}
+
+	// The proxy is never removed, since other threads may already have read it. Memory allocated before it was installed is
+	// freed through it into the same allocator
+	GMalloc = new FMallocCountingProxy(GMalloc);
+	UE_LOG(LogTemp, Display, TEXT("Counting heap allocations in the match pipeline"));
+}
+
+bool FAllocationCounter::IsInstalled()
+{
+	return GInstalled.load(std::memory_order_relaxed);
+}
+
+uint64 FAllocationCounter::GetThreadCount()
+{
+	return GThreadCount;
+}
+
+FScopedAllocationCount::FScopedAllocationCount()
+{
+	StartCount = GThreadCount;
+	GScopeDepth++;
+}
+
+FScopedAllocationCount::~FScopedAllocationCount()
+{
+	GScopeDepth--;
+
+	// Only the outermost scope reports, so nested scopes count each allocation once
+	if (GScopeDepth == 0 && GThreadCount != StartCount)
+	{
+		MATCHTHREE_COUNTER_ADD(MatchAllocations, static_cast<uint32>(GThreadCount - StartCount));
+	}
+}
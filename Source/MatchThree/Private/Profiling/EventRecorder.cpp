@@ -0,0 +1,168 @@
+// Copyright Peter Carsten Collins (2024)
+
+
+#include "Profiling/EventRecorder.h"
+
+#include "Async/Async.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryWriter.h"
+#include "UObject/UObjectGlobals.h"
+
+static TAutoConsoleVariable<float> CVarHitchBudgetMs(
+	TEXT("MatchThree.HitchBudgetMs"),
+	50.f,
+	TEXT("Frames longer than this dump the recent MatchThree events to Saved/Hitches"));
+
+static TAutoConsoleVariable<float> CVarHitchDumpSeconds(
+	TEXT("MatchThree.HitchDumpSeconds"),
+	5.f,
+	TEXT("Seconds of events written for each hitch"));
+
+static TAutoConsoleVariable<int32> CVarEventBufferSize(
+	TEXT("MatchThree.EventBufferSize"),
+	16384,
+	TEXT("Number of events kept in the hitch ring buffer. Read when play starts"));
+
+namespace
+{
+	// Bumped whenever FRecordedEvent or the header changes
+	constexpr uint32 HitchFileMagic = 0x5645334D; // "M3EV"
+	constexpr uint32 HitchFileVersion = 1;
+}
+
+FMatchThreeEventRecorder& FMatchThreeEventRecorder::Get()
+{
+	static FMatchThreeEventRecorder Recorder;
+	return Recorder;
+}
+
+void FMatchThreeEventRecorder::Start()
+{
+	if (bIsRecording)
+	{
+		return;
+	}
+
+	Events.SetNumUninitialized(FMath::Max(CVarEventBufferSize.GetValueOnGameThread(), 1));
+	Head = 0;
+	NumEvents = 0;
+	LastDumpTime = 0.;
+	bIsRecording = true;
+
+	TickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FMatchThreeEventRecorder::Tick));
+	GarbageCollectHandle = FCoreUObjectDelegates::GetPostGarbageCollect().AddRaw(this, &FMatchThreeEventRecorder::HandlePostGarbageCollect);
+}
+
+void FMatchThreeEventRecorder::Stop()
+{
+	if (!bIsRecording)
+	{
+		return;
+	}
+
+	bIsRecording = false;
+	FTSTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+	FCoreUObjectDelegates::GetPostGarbageCollect().Remove(GarbageCollectHandle);
+
+	for (TFuture<void>& PendingDump : PendingDumps)
+	{
+		PendingDump.Wait();
+	}
+	PendingDumps.Reset();
+	Events.Empty();
+}
+
+void FMatchThreeEventRecorder::Record(EMatchThreeEvent Type, int32 Data)
+{
+	if (!bIsRecording)
+	{
+		return;
+	}
+
+	FRecordedEvent& Event = Events[Head];
+	Event.Time = FPlatformTime::Seconds();
+	Event.Data = Data;
+	Event.Frame = static_cast<uint16>(GFrameCounter);
+	Event.Type = Type;
+
+	Head = (Head + 1) % Events.Num();
+	NumEvents = FMath::Min(NumEvents + 1, Events.Num());
+}
+
+void FMatchThreeEventRecorder::Dump(double FrameMilliseconds)
+{
+	const double Now = FPlatformTime::Seconds();
+	const double WindowStart = Now - CVarHitchDumpSeconds.GetValueOnGameThread();
+	LastDumpTime = Now;
+
+	// Copy the window out oldest first. This is the only work done on the game thread
+	TArray<FRecordedEvent> Window;
+	Window.Reserve(NumEvents);
+	const int32 First = (Head - NumEvents + Events.Num()) % Events.Num();
+	for (int32 Index = 0; Index < NumEvents; Index++)
+	{
+		const FRecordedEvent& Event = Events[(First + Index) % Events.Num()];
+		if (Event.Time >= WindowStart)
+		{
+			Window.Add(Event);
+		}
+	}
+
+	const FString FileName = FPaths::ProjectSavedDir() / TEXT("Hitches") / FString::Printf(TEXT("Hitch_%s.m3ev"), *FDateTime::Now().ToString(TEXT("%Y%m%d_%H%M%S_%s")));
+
+	PendingDumps.RemoveAll([](const TFuture<void>& PendingDump) { return PendingDump.IsReady(); });
+	PendingDumps.Add(Async(EAsyncExecution::ThreadPool, [Window = MoveTemp(Window), FileName, FrameMilliseconds]()
+		{
+			TArray<uint8> Bytes;
+			FMemoryWriter Writer(Bytes);
+
+			uint32 Magic = HitchFileMagic;
+			uint32 Version = HitchFileVersion;
+			double HitchMilliseconds = FrameMilliseconds;
+			int32 Num = Window.Num();
+			Writer << Magic << Version << HitchMilliseconds << Num;
+			for (const FRecordedEvent& Event : Window)
+			{
+				double Time = Event.Time;
+				int32 Data = Event.Data;
+				uint16 Frame = Event.Frame;
+				uint8 Type = static_cast<uint8>(Event.Type);
+				Writer << Time << Data << Frame << Type;
+			}
+
+			if (FFileHelper::SaveArrayToFile(Bytes, *FileName))
+			{
+				UE_LOG(LogTemp, Display, TEXT("Hitch of [%.1f ms] wrote [%d] events to [%s]"), HitchMilliseconds, Num, *FileName);
+			}
+			else
+			{
+				UE_LOG(LogTemp, Error, TEXT("Failed to write hitch trace [%s]"), *FileName);
+			}
+		}));
+}
+
+bool FMatchThreeEventRecorder::Tick(float DeltaTime)
+{
+	const double FrameMilliseconds = FApp::GetDeltaTime() * 1000.;
+	if (FrameMilliseconds > CVarHitchBudgetMs.GetValueOnGameThread())
+	{
+		Record(EMatchThreeEvent::Hitch, FMath::RoundToInt32(FrameMilliseconds * 1000.));
+
+		// A run of slow frames is one hitch as far as the trace is concerned
+		const double Now = FPlatformTime::Seconds();
+		if (Now - LastDumpTime > CVarHitchDumpSeconds.GetValueOnGameThread())
+		{
+			Dump(FrameMilliseconds);
+		}
+	}
+	return true;
+}
+
+void FMatchThreeEventRecorder::HandlePostGarbageCollect()
+{
+	Record(EMatchThreeEvent::GarbageCollected);
+}
@@ -0,0 +1,130 @@
+// Copyright Peter Carsten Collins (2024)
+
+
+#include "Profiling/GrowthTracker.h"
+
+#include "Misc/FileHelper.h"
+
+FGrowthTracker::FGrowthTracker(int32 InWindow)
+	: Window(FMath::Max(InWindow, 2))
+{
+}
+
+void FGrowthTracker::Record(const TCHAR* Name, const TCHAR* Subsystem, double Value, double MinGrowth, EGrowthKind Kind)
+{
+	const FString Key = FString::Printf(TEXT("%s.%s"), Subsystem, Name);
+	int32* Index = SeriesIndices.Find(Key);
+	if (!Index)
+	{
+		FSeries& NewSeries = Series.AddDefaulted_GetRef();
+		NewSeries.Name = Name;
+		NewSeries.Subsystem = Subsystem;
+		NewSeries.MinGrowth = MinGrowth;
+		NewSeries.Kind = Kind;
+		Index = &SeriesIndices.Add(Key, Series.Num() - 1);
+	}
+	Series[*Index].Samples.Add(Value);
+}
+
+void FGrowthTracker::Analyse()
+{
+	for (FSeries& Entry : Series)
+	{
+		if (Entry.bFlagged || Entry.Samples.Num() < Window)
+		{
+			continue;
+		}
+
+		const int32 First = Entry.Samples.Num() - Window;
+
+		// Fit a line to the window so one step or one spike does not pass for a trend
+		double MeanY = 0.;
+		for (int32 Index = First; Index < Entry.Samples.Num(); Index++)
+		{
+			MeanY += Entry.Samples[Index];
+		}
+		MeanY /= Window;
+
+		const double MeanX = (Window - 1) * .5;
+		double Covariance = 0.;
+		double Variance = 0.;
+		for (int32 Index = 0; Index < Window; Index++)
+		{
+			Covariance += (Index - MeanX) * (Entry.Samples[First + Index] - MeanY);
+			Variance += (Index - MeanX) * (Index - MeanX);
+		}
+		const double TrendGrowth = Covariance / Variance * (Window - 1);
+
+		bool bGrowing = Entry.Samples.Last() - Entry.Samples[First] >= Entry.MinGrowth && TrendGrowth >= Entry.MinGrowth;
+		if (bGrowing && Entry.Kind == EGrowthKind::Count)
+		{
+			// Steady state structures go up and down as the board plays. Leaks go up on most samples and never down
+			int32 NumRises = 0;
+			for (int32 Index = First + 1; bGrowing && Index < Entry.Samples.Num(); Index++)
+			{
+				bGrowing = Entry.Samples[Index] >= Entry.Samples[Index - 1];
+				NumRises += Entry.Samples[Index] > Entry.Samples[Index - 1] ? 1 : 0;
+			}
+			bGrowing = bGrowing && NumRises * 2 > Window - 1;
+		}
+
+		if (bGrowing)
+		{
+			Entry.bFlagged = true;
+			UE_LOG(LogTemp, Error, TEXT("[%s] %s has grown for [%d] samples (%.0f -> %.0f)"),
+				*Entry.Subsystem, *Entry.Name, Window, Entry.Samples[First], Entry.Samples.Last());
+		}
+	}
+}
+
+int32 FGrowthTracker::GetNumFlagged() const
+{
+	int32 NumFlagged = 0;
+	for (const FSeries& Entry : Series)
+	{
+		NumFlagged += Entry.bFlagged ? 1 : 0;
+	}
+	return NumFlagged;
+}
+
+bool FGrowthTracker::WriteCsv(const FString& Path) const
+{
+	TArray<FString> Lines;
+
+	FString Header = TEXT("Sample");
+	int32 NumSamples = 0;
+	for (const FSeries& Entry : Series)
+	{
+		Header += FString::Printf(TEXT(",%s.%s"), *Entry.Subsystem, *Entry.Name);
+		NumSamples = FMath::Max(NumSamples, Entry.Samples.Num());
+	}
+	Lines.Add(Header);
+
+	for (int32 Sample = 0; Sample < NumSamples; Sample++)
+	{
+		FString Line = FString::FromInt(Sample);
+		for (const FSeries& Entry : Series)
+		{
+			// Series first recorded late are padded at the front
+			const int32 Index = Sample - (NumSamples - Entry.Samples.Num());
+			Line += Entry.Samples.IsValidIndex(Index) ? FString::Printf(TEXT(",%.0f"), Entry.Samples[Index]) : TEXT(",");
+		}
+		Lines.Add(Line);
+	}
+
+	return FFileHelper::SaveStringArrayToFile(Lines, *Path);
+}
+
+void FGrowthTracker::LogReport() const
+{
+	UE_LOG(LogTemp, Display, TEXT("Growth report"));
+	for (const FSeries& Entry : Series)
+	{
+		if (Entry.Samples.IsEmpty())
+		{
+			continue;
+		}
+		UE_LOG(LogTemp, Display, TEXT("  %s %-12s %-28s %12.0f -> %12.0f"), Entry.bFlagged ? TEXT("GROWING") : TEXT("       "),
+			*Entry.Subsystem, *Entry.Name, Entry.Samples[0], Entry.Samples.Last());
+	}
+}
@@ -0,0 +1,386 @@
+// Copyright Peter Carsten Collins (2024)
+
+
+#include "Profiling/MatchThreeBenchmarkCommandlet.h"
+
+#include "Board/BoardColumn.h"
+#include "Board/BoardGenerator.h"
+#include "Board/CascadeArena.h"
+#include "Board/Match.h"
+#include "Dom/JsonObject.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "Gem/GemDataAsset.h"
+#include "GemBase.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Profiling/AllocationCounter.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "UObject/Package.h"
+
+void ABenchmarkGameBoard::Fill(int32 Width, int32 Height, const TMap<EGemType, UGemDataAsset*>& InGemData)
+{
+	BoardWidth = Width;
+	BoardHeight = Height;
+	GemData = InGemData;
+	GemActorClass = AGemBase::StaticClass();
+
+	// Use the same board contents for every run
+	RandomSeed = Width * 7919 + Height;
+
+	BuildRegistry();
+	InitializeBoard();
+
+	for (int32 X = 0; X < BoardWidth; X++)
+	{
+		for (int32 Y = 0; Y < BoardHeight; Y++)
+		{
+			const FBoardLocation Location(X, Y);
+			AGemBase* Gem = SpawnGem(X, GetRandomTypeId());
+			SetGem(Gem, Location);
+			Gem->SetActorLocation(GetWorldLocation(Location));
+		}
+	}
+}
+
+int32 ABenchmarkGameBoard::ClearRows(int32 Column, int32 FirstRow, int32 NumRows)
+{
+	int32 NumCleared = 0;
+	for (int32 Row = FirstRow; Row < FirstRow + NumRows && Row < BoardHeight; Row++)
+	{
+		if (AGemBase* Gem = GetGem({ Column, Row }))
+		{
+			Remove(Gem);
+			DestroyGem(Gem);
+			NumCleared++;
+		}
+	}
+	return NumCleared;
+}
+
+UMatchThreeBenchmarkCommandlet::UMatchThreeBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UMatchThreeBenchmarkCommandlet::Main(const FString& Params)
+{
+	FString SizesString = TEXT("8,16,32,64,128,256,512");
+	FParse::Value(*Params, TEXT("Sizes="), SizesString);
+	FParse::Value(*Params, TEXT("MinTime="), MinTime);
+
+	FString OutputPath = FPaths::ProjectSavedDir() / TEXT("Benchmarks") / TEXT("BoardKernels.json");
+	FParse::Value(*Params, TEXT("Output="), OutputPath);
+
+	FString BaselinePath;
+	FParse::Value(*Params, TEXT("Baseline="), BaselinePath);
+
+	double Tolerance = .1;
+	FParse::Value(*Params, TEXT("Tolerance="), Tolerance);
+
+	if (FParse::Param(*Params, TEXT("CountAllocations")))
+	{
+		FAllocationCounter::Install();
+	}
+
+	// Gem data without meshes is enough for the board logic
+	TMap<EGemType, UGemDataAsset*> GemData;
+	for (uint8 Type = 0; Type < static_cast<uint8>(EGemType::MAX); Type++)
+	{
+		UGemDataAsset* DataAsset = NewObject<UGemDataAsset>(GetTransientPackage());
+		DataAsset->Type = static_cast<EGemType>(Type);
+		GemDataAssets.Add(DataAsset);
+		GemData.Add(DataAsset->Type, DataAsset);
+	}
+
+	TArray<FString> Sizes;
+	SizesString.ParseIntoArray(Sizes, TEXT(","));
+	for (const FString& Size : Sizes)
+	{
+		BenchmarkBoardSize(FCString::Atoi(*Size), GemData);
+	}
+
+	if (!WriteResults(OutputPath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to write benchmark results to [%s]"), *OutputPath);
+		return ExitWriteFailed;
+	}
+	UE_LOG(LogTemp, Display, TEXT("Wrote benchmark results to [%s]"), *OutputPath);
+
+	if (!BaselinePath.IsEmpty())
+	{
+		const int32 NumRegressions = CompareWithBaseline(BaselinePath, Tolerance);
+		if (NumRegressions == INDEX_NONE)
+		{
+			return ExitBadBaseline;
+		}
+		if (NumRegressions != 0)
+		{
+			UE_LOG(LogTemp, Error, TEXT("[%d] kernels regressed against the baseline"), NumRegressions);
+			return ExitRegressed;
+		}
+	}
+	return 0;
+}
+
+void UMatchThreeBenchmarkCommandlet::RunKernel(const TCHAR* Kernel, int32 Width, int32 Height, int64 OpsPerRun, TFunctionRef<void()> Body)
+{
+	int64 NumRuns = 0;
+	double TotalTime = 0.;
+	double BestTime = TNumericLimits<double>::Max();
+	uint64 NumAllocations = 0;
+	do
+	{
+		const uint64 StartAllocations = FAllocationCounter::GetThreadCount();
+		const double StartTime = FPlatformTime::Seconds();
+		{
+			MATCHTHREE_COUNT_ALLOCATIONS();
+			FCascadeArenaScope ArenaScope;
+			Body();
+		}
+		const double RunTime = FPlatformTime::Seconds() - StartTime;
+
+		// The first run warms up the arena and the kernel's own buffers
+		if (NumRuns > 0)
+		{
+			NumAllocations += FAllocationCounter::GetThreadCount() - StartAllocations;
+		}
+
+		TotalTime += RunTime;
+		BestTime = FMath::Min(BestTime, RunTime);
+		NumRuns++;
+	} while (TotalTime < MinTime);
+
+	FKernelResult& Result = Results.AddDefaulted_GetRef();
+	Result.Kernel = Kernel;
+	Result.Width = Width;
+	Result.Height = Height;
+	Result.NumRuns = NumRuns;
+	Result.BestNanosecondsPerOp = BestTime * 1e9 / OpsPerRun;
+	Result.MeanNanosecondsPerOp = TotalTime * 1e9 / (OpsPerRun * NumRuns);
+	if (FAllocationCounter::IsInstalled() && NumRuns > 1)
+	{
+		Result.AllocationsPerRun = static_cast<double>(NumAllocations) / (NumRuns - 1);
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("%-24s %4dx%-4d %12.1f ns/op (mean %.1f, %lld runs, %.1f allocations/run)"),
+		Kernel, Width, Height, Result.BestNanosecondsPerOp, Result.MeanNanosecondsPerOp, NumRuns, Result.AllocationsPerRun);
+}
+
+void UMatchThreeBenchmarkCommandlet::BenchmarkBoardSize(int32 Size, const TMap<EGemType, UGemDataAsset*>& GemData)
+{
+	if (Size <= 0)
+	{
+		return;
+	}
+
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("MatchThreeBenchmark"));
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+
+	ABenchmarkGameBoard* Board = World->SpawnActor<ABenchmarkGameBoard>();
+	Board->Fill(Size, Size, GemData);
+
+	const int64 NumCells = static_cast<int64>(Size) * Size;
+
+	RunKernel(TEXT("GetMatch"), Size, Size, NumCells, [&]()
+		{
+			FMatch Match;
+			for (int32 X = 0; X < Size; X++)
+			{
+				for (int32 Y = 0; Y < Size; Y++)
+				{
+					Board->GetMatch(Board->GetGem({ X, Y }), Match);
+					Sink += Match.GetLocations().Num();
+				}
+			}
+		});
+
+	RunKernel(TEXT("MatchFound"), Size, Size, NumCells, [&]()
+		{
+			FMatch Match;
+			for (int32 X = 0; X < Size; X++)
+			{
+				for (int32 Y = 0; Y < Size; Y++)
+				{
+					Sink += Board->MatchFound({ X, Y }, Match);
+				}
+			}
+		});
+
+	RunKernel(TEXT("GetBoardLocation"), Size, Size, NumCells, [&]()
+		{
+			for (int32 X = 0; X < Size; X++)
+			{
+				for (int32 Y = 0; Y < Size; Y++)
+				{
+					Sink += Board->GetBoardLocation(Board->GetGem({ X, Y })).Y;
+				}
+			}
+		});
+
+	// A column with its lower half filled so every query above it scans down to the top gem
+	FBoardColumn Column(Size);
+	for (int32 Y = 0; Y < Size / 2; Y++)
+	{
+		Column.SetGem(Board->GetGem({ 0, Y }), Y);
+	}
+	RunKernel(TEXT("GetEmptySpaceUnder"), Size, Size, Size, [&]()
+		{
+			for (int32 Y = 0; Y < Size; Y++)
+			{
+				Sink += Column.GetEmptySpaceUnder(Y);
+			}
+		});
+
+	TArray<FBoardLocation> RowLocations;
+	for (int32 X = 0; X < Size; X++)
+	{
+		RowLocations.Add({ X, 0 });
+	}
+	RunKernel(TEXT("FMatch::AddLocations"), Size, Size, 1, [&]()
+		{
+			FMatch Match;
+			Match.AddLocations(RowLocations);
+			Sink += Match.GetLocations().Num();
+		});
+
+	// Keeps its old name so results still compare with older baselines
+	RunKernel(TEXT("GetRandomGemType"), Size, Size, NumCells, [&]()
+		{
+			for (int64 Index = 0; Index < NumCells; Index++)
+			{
+				Sink += static_cast<int64>(Board->GetRandomTypeId());
+			}
+		});
+
+	RunKernel(TEXT("CountLegalMoves"), Size, Size, 1, [&]()
+		{
+			Sink += Board->CountLegalMoves();
+		});
+
+	const FBoardGenerator Generator(Size, Size, GemData.Num());
+	FRandomStream Random(Size);
+	TArray<uint8> TypeIds;
+	RunKernel(TEXT("BoardGenerator::Generate"), Size, Size, 1, [&]()
+		{
+			Sink += Generator.Generate(Random, 3, TypeIds);
+		});
+
+	TArray<int32> Sources;
+	RunKernel(TEXT("BoardGenerator::Reshuffle"), Size, Size, 1, [&]()
+		{
+			Sink += Generator.Reshuffle(Random, 3, TypeIds, Sources);
+		});
+
+	// Collapse and fill changes the board so it runs last, clearing the middle third of every column each run
+	RunKernel(TEXT("CollapseAndFill"), Size, Size, Size, [&]()
+		{
+			const int32 NumRows = FMath::Max(Size / 3, 1);
+			for (int32 X = 0; X < Size; X++)
+			{
+				const int32 NumCleared = Board->ClearRows(X, Size / 3, NumRows);
+				Board->CompactColumn(X, Size / 3);
+				for (int32 Index = 0; Index < NumCleared; Index++)
+				{
+					Board->SpawnGemInColumn(X);
+				}
+			}
+		});
+
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+	CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+}
+
+bool UMatchThreeBenchmarkCommandlet::WriteResults(const FString& Path) const
+{
+	TArray<TSharedPtr<FJsonValue>> Entries;
+	for (const FKernelResult& Result : Results)
+	{
+		TSharedRef<FJsonObject> Entry = MakeShared<FJsonObject>();
+		Entry->SetStringField(TEXT("kernel"), Result.Kernel);
+		Entry->SetNumberField(TEXT("width"), Result.Width);
+		Entry->SetNumberField(TEXT("height"), Result.Height);
+		Entry->SetNumberField(TEXT("runs"), Result.NumRuns);
+		Entry->SetNumberField(TEXT("best_ns_per_op"), Result.BestNanosecondsPerOp);
+		Entry->SetNumberField(TEXT("mean_ns_per_op"), Result.MeanNanosecondsPerOp);
+		if (Result.AllocationsPerRun >= 0.)
+		{
+			Entry->SetNumberField(TEXT("allocations_per_run"), Result.AllocationsPerRun);
+		}
+		Entries.Add(MakeShared<FJsonValueObject>(Entry));
+	}
+
+	TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
+	Root->SetNumberField(TEXT("version"), 1);
+	Root->SetArrayField(TEXT("results"), Entries);
+
+	FString Output;
+	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Output);
+	return FJsonSerializer::Serialize(Root, Writer) && FFileHelper::SaveStringToFile(Output, *Path);
+}
+
+int32 UMatchThreeBenchmarkCommandlet::CompareWithBaseline(const FString& Path, double Tolerance) const
+{
+	FString Input;
+	TSharedPtr<FJsonObject> Root;
+	if (!FFileHelper::LoadFileToString(Input, *Path) || !FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Input), Root) || !Root.IsValid())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to read benchmark baseline [%s]"), *Path);
+		return INDEX_NONE;
+	}
+
+	const TArray<TSharedPtr<FJsonValue>>* Entries = nullptr;
+	if (!Root->TryGetArrayField(TEXT("results"), Entries))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Benchmark baseline [%s] has no results"), *Path);
+		return INDEX_NONE;
+	}
+
+	// Key the baseline by kernel and board size
+	TMap<FString, double> Baseline;
+	for (const TSharedPtr<FJsonValue>& Value : *Entries)
+	{
+		const TSharedPtr<FJsonObject>* Entry = nullptr;
+		FString Kernel;
+		int32 Width = 0;
+		int32 Height = 0;
+		double BestNanosecondsPerOp = 0.;
+		if (!Value->TryGetObject(Entry) || !(*Entry)->TryGetStringField(TEXT("kernel"), Kernel) || !(*Entry)->TryGetNumberField(TEXT("width"), Width)
+			|| !(*Entry)->TryGetNumberField(TEXT("height"), Height) || !(*Entry)->TryGetNumberField(TEXT("best_ns_per_op"), BestNanosecondsPerOp))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Benchmark baseline [%s] has a malformed result"), *Path);
+			return INDEX_NONE;
+		}
+		Baseline.Add(FString::Printf(TEXT("%s@%dx%d"), *Kernel, Width, Height), BestNanosecondsPerOp);
+	}
+
+	int32 NumRegressions = 0;
+	for (const FKernelResult& Result : Results)
+	{
+		const FString Key = FString::Printf(TEXT("%s@%dx%d"), *Result.Kernel, Result.Width, Result.Height);
+		const double* BaselineNanoseconds = Baseline.Find(Key);
+		if (!BaselineNanoseconds)
+		{
+			continue;
+		}
+
+		const double Change = Result.BestNanosecondsPerOp / *BaselineNanoseconds - 1.;
+		if (Change > Tolerance)
+		{
+			UE_LOG(LogTemp, Error, TEXT("%-32s regressed %+.1f%% (%.1f -> %.1f ns/op)"), *Key, Change * 100., *BaselineNanoseconds, Result.BestNanosecondsPerOp);
+			NumRegressions++;
+		}
+		else
+		{
+			UE_LOG(LogTemp, Display, TEXT("%-32s %+.1f%%"), *Key, Change * 100.);
+		}
+	}
+	return NumRegressions;
+}
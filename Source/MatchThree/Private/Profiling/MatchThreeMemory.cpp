@@ -0,0 +1,21 @@
+// Copyright Peter Carsten Collins (2024)
+
+
+#include "Profiling/MatchThreeMemory.h"
+#include "Stats/Stats.h"
+
+DECLARE_LLM_MEMORY_STAT(TEXT("MatchThree"), STAT_MatchThreeSummaryLLM, STATGROUP_LLM);
+DECLARE_LLM_MEMORY_STAT(TEXT("MatchThree"), STAT_MatchThreeLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("MatchThree Gems"), STAT_MatchThreeGemsLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("MatchThree Tasks"), STAT_MatchThreeTasksLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("MatchThree Board"), STAT_MatchThreeBoardLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("MatchThree Matches"), STAT_MatchThreeMatchesLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("MatchThree FX"), STAT_MatchThreeFXLLM, STATGROUP_LLMFULL);
+
+// The categories roll up into the MatchThree tag, which shows as a single line in stat LLM
+LLM_DEFINE_TAG(MatchThree, NAME_None, NAME_None, GET_STATFNAME(STAT_MatchThreeLLM), GET_STATFNAME(STAT_MatchThreeSummaryLLM));
+LLM_DEFINE_TAG(MatchThree_Gems, NAME_None, TEXT("MatchThree"), GET_STATFNAME(STAT_MatchThreeGemsLLM), GET_STATFNAME(STAT_MatchThreeSummaryLLM));
+LLM_DEFINE_TAG(MatchThree_Tasks, NAME_None, TEXT("MatchThree"), GET_STATFNAME(STAT_MatchThreeTasksLLM), GET_STATFNAME(STAT_MatchThreeSummaryLLM));
+LLM_DEFINE_TAG(MatchThree_Board, NAME_None, TEXT("MatchThree"), GET_STATFNAME(STAT_MatchThreeBoardLLM), GET_STATFNAME(STAT_MatchThreeSummaryLLM));
+LLM_DEFINE_TAG(MatchThree_Matches, NAME_None, TEXT("MatchThree"), GET_STATFNAME(STAT_MatchThreeMatchesLLM), GET_STATFNAME(STAT_MatchThreeSummaryLLM));
+LLM_DEFINE_TAG(MatchThree_FX, NAME_None, TEXT("MatchThree"), GET_STATFNAME(STAT_MatchThreeFXLLM), GET_STATFNAME(STAT_MatchThreeSummaryLLM));
@@ -0,0 +1,318 @@
+// Copyright Peter Carsten Collins (2024)
+
+
+#include "Profiling/MatchThreePerfRun.h"
+
+#include "Core/MatchThreeAutoPlayer.h"
+#include "Core/MatchThreeGameMode.h"
+#include "Dom/JsonObject.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "GameBoard.h"
+#include "HAL/PlatformMisc.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "RenderCore.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "UObject/UObjectGlobals.h"
+
+void UMatchThreePerfRun::Init(AMatchThreeGameMode* InGameMode, const TCHAR* Params)
+{
+	GameMode = InGameMode;
+
+	FString SizesString = TEXT("8x8,16x16,32x32");
+	FParse::Value(Params, TEXT("PerfSizes="), SizesString);
+	FParse::Value(Params, TEXT("PerfWarmup="), WarmupTime);
+	FParse::Value(Params, TEXT("PerfDuration="), MeasureTime);
+	FParse::Value(Params, TEXT("PerfSeed="), Seed);
+	FParse::Value(Params, TEXT("PerfTolerance="), Tolerance);
+	FParse::Value(Params, TEXT("PerfBaseline="), BaselinePath);
+
+	OutputPath = FPaths::ProjectSavedDir() / TEXT("Benchmarks") / TEXT("PerfRun.json");
+	FParse::Value(Params, TEXT("PerfOutput="), OutputPath);
+
+	TArray<FString> SizeStrings;
+	SizesString.ParseIntoArray(SizeStrings, TEXT(","));
+	for (const FString& SizeString : SizeStrings)
+	{
+		FString WidthString;
+		FString HeightString;
+		if (!SizeString.Split(TEXT("x"), &WidthString, &HeightString))
+		{
+			WidthString = HeightString = SizeString;
+		}
+		Sizes.Add({ FCString::Atoi(*WidthString), FCString::Atoi(*HeightString) });
+	}
+
+	AutoPlayer = NewObject<UMatchThreeAutoPlayer>(this);
+
+	PreGarbageCollectHandle = FCoreUObjectDelegates::GetPreGarbageCollectDelegate().AddUObject(this, &UMatchThreePerfRun::HandlePreGarbageCollect);
+	PostGarbageCollectHandle = FCoreUObjectDelegates::GetPostGarbageCollect().AddUObject(this, &UMatchThreePerfRun::HandlePostGarbageCollect);
+
+	UE_LOG(LogTemp, Display, TEXT("Starting performance run over [%d] board sizes"), Sizes.Num());
+	SizeIndex = 0;
+	Stage = Sizes.IsEmpty() ? EStage::Finished : EStage::Resizing;
+	if (Sizes.IsEmpty())
+	{
+		Finish();
+	}
+}
+
+void UMatchThreePerfRun::BeginDestroy()
+{
+	FCoreUObjectDelegates::GetPreGarbageCollectDelegate().Remove(PreGarbageCollectHandle);
+	FCoreUObjectDelegates::GetPostGarbageCollect().Remove(PostGarbageCollectHandle);
+
+	Super::BeginDestroy();
+}
+
+void UMatchThreePerfRun::Tick(float DeltaSeconds)
+{
+	StageTime += DeltaSeconds;
+
+	switch (Stage)
+	{
+	case EStage::Resizing:
+		// Let swaps and cascades from the previous size finish before the board is rebuilt. Each size gets a board seed of its
+		// own from the run's seed, so every run of a size plays the same board
+		if (GameMode->RestartBoard(Sizes[SizeIndex].X, Sizes[SizeIndex].Y, static_cast<int32>(HashCombine(GetTypeHash(Seed), GetTypeHash(Sizes[SizeIndex])) | 1)))
+		{
+			StartSize();
+		}
+		break;
+
+	case EStage::Warmup:
+		AutoPlayer->Tick(DeltaSeconds);
+		if (StageTime >= WarmupTime)
+		{
+			Stage = EStage::Measure;
+			StageTime = 0.f;
+		}
+		break;
+
+	case EStage::Measure:
+		AutoPlayer->Tick(DeltaSeconds);
+		RecordFrame(DeltaSeconds);
+		if (StageTime >= MeasureTime)
+		{
+			FinishSize();
+		}
+		break;
+
+	case EStage::Finished:
+		break;
+	}
+}
+
+void UMatchThreePerfRun::StartSize()
+{
+	const FIntPoint& Size = Sizes[SizeIndex];
+	UE_LOG(LogTemp, Display, TEXT("Performance run on a [%dx%d] board"), Size.X, Size.Y);
+
+	// Every size plays the same sequence of swaps
+	AutoPlayer->Init(GameMode, Seed);
+
+	FrameTimes.Reset();
+	GameThreadTimes.Reset();
+	MaxGarbageCollectMilliseconds = 0.;
+	MaxActors = 0;
+	MaxTasks = 0;
+	MaxGems = 0;
+	bForcedGarbageCollect = false;
+
+	Stage = EStage::Warmup;
+	StageTime = 0.f;
+}
+
+void UMatchThreePerfRun::RecordFrame(float DeltaSeconds)
+{
+	FrameTimes.Add(DeltaSeconds * 1000.f);
+	GameThreadTimes.Add(FPlatformTime::ToMilliseconds(GGameThreadTime));
+	MaxActors = FMath::Max(MaxActors, GameMode->GetWorld()->GetActorCount());
+	MaxTasks = FMath::Max(MaxTasks, GameMode->GetNumActiveTasks());
+	MaxGems = FMath::Max(MaxGems, GameMode->GetGameBoard()->GetNumGems());
+
+	// Collect once halfway through so every size pays for a full collection with the board at its busiest
+	if (!bForcedGarbageCollect && StageTime >= MeasureTime * .5f)
+	{
+		bForcedGarbageCollect = true;
+		GEngine->ForceGarbageCollection(true);
+	}
+}
+
+void UMatchThreePerfRun::FinishSize()
+{
+	auto Mean = [](const TArray<float>& Samples)
+		{
+			double Total = 0.;
+			for (const float Sample : Samples)
+			{
+				Total += Sample;
+			}
+			return Samples.IsEmpty() ? 0. : Total / Samples.Num();
+		};
+	auto Percentile = [](TArray<float> Samples, double Fraction)
+		{
+			if (Samples.IsEmpty())
+			{
+				return 0.;
+			}
+			Samples.Sort();
+			return static_cast<double>(Samples[FMath::Clamp(FMath::CeilToInt32(Fraction * Samples.Num()) - 1, 0, Samples.Num() - 1)]);
+		};
+
+	FSizeResult& Result = Results.AddDefaulted_GetRef();
+	Result.Width = Sizes[SizeIndex].X;
+	Result.Height = Sizes[SizeIndex].Y;
+	Result.NumFrames = FrameTimes.Num();
+	Result.NumSwaps = AutoPlayer->GetNumSwaps();
+	Result.Metrics.Add({ TEXT("frame_ms_mean"), Mean(FrameTimes) });
+	Result.Metrics.Add({ TEXT("frame_ms_p95"), Percentile(FrameTimes, .95) });
+	Result.Metrics.Add({ TEXT("game_thread_ms_mean"), Mean(GameThreadTimes) });
+	Result.Metrics.Add({ TEXT("game_thread_ms_p95"), Percentile(GameThreadTimes, .95) });
+	Result.Metrics.Add({ TEXT("gc_ms_max"), MaxGarbageCollectMilliseconds });
+	Result.Metrics.Add({ TEXT("actors_max"), static_cast<double>(MaxActors) });
+	Result.Metrics.Add({ TEXT("tasks_max"), static_cast<double>(MaxTasks) });
+	Result.Metrics.Add({ TEXT("gems_max"), static_cast<double>(MaxGems) });
+
+	for (const TPair<FString, double>& Metric : Result.Metrics)
+	{
+		UE_LOG(LogTemp, Display, TEXT("  %-20s %10.2f"), *Metric.Key, Metric.Value);
+	}
+
+	SizeIndex++;
+	if (SizeIndex < Sizes.Num())
+	{
+		Stage = EStage::Resizing;
+		StageTime = 0.f;
+	}
+	else
+	{
+		Finish();
+	}
+}
+
+void UMatchThreePerfRun::Finish()
+{
+	Stage = EStage::Finished;
+
+	bool bFailed = false;
+	if (WriteResults(OutputPath))
+	{
+		UE_LOG(LogTemp, Display, TEXT("Wrote performance run results to [%s]"), *OutputPath);
+	}
+	else
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to write performance run results to [%s]"), *OutputPath);
+		bFailed = true;
+	}
+
+	if (!BaselinePath.IsEmpty())
+	{
+		const int32 NumRegressions = CompareWithBaseline(BaselinePath);
+		if (NumRegressions != 0)
+		{
+			UE_LOG(LogTemp, Error, TEXT("[%d] metrics regressed against the baseline"), NumRegressions);
+			bFailed = true;
+		}
+	}
+
+	FPlatformMisc::RequestExitWithStatus(false, bFailed ? 1 : 0);
+}
+
+bool UMatchThreePerfRun::WriteResults(const FString& Path) const
+{
+	TArray<TSharedPtr<FJsonValue>> Entries;
+	for (const FSizeResult& Result : Results)
+	{
+		TSharedRef<FJsonObject> Entry = MakeShared<FJsonObject>();
+		Entry->SetNumberField(TEXT("width"), Result.Width);
+		Entry->SetNumberField(TEXT("height"), Result.Height);
+		Entry->SetNumberField(TEXT("frames"), Result.NumFrames);
+		Entry->SetNumberField(TEXT("swaps"), Result.NumSwaps);
+		for (const TPair<FString, double>& Metric : Result.Metrics)
+		{
+			Entry->SetNumberField(Metric.Key, Metric.Value);
+		}
+		Entries.Add(MakeShared<FJsonValueObject>(Entry));
+	}
+
+	TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
+	Root->SetNumberField(TEXT("version"), 1);
+	Root->SetNumberField(TEXT("seed"), Seed);
+	Root->SetArrayField(TEXT("results"), Entries);
+
+	FString Output;
+	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Output);
+	return FJsonSerializer::Serialize(Root, Writer) && FFileHelper::SaveStringToFile(Output, *Path);
+}
+
+int32 UMatchThreePerfRun::CompareWithBaseline(const FString& Path) const
+{
+	FString Input;
+	TSharedPtr<FJsonObject> Root;
+	if (!FFileHelper::LoadFileToString(Input, *Path) || !FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Input), Root) || !Root.IsValid())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to read performance baseline [%s]"), *Path);
+		return 1;
+	}
+
+	// Key the baseline entries by board size
+	TMap<FIntPoint, TSharedPtr<FJsonObject>> Baseline;
+	for (const TSharedPtr<FJsonValue>& Value : Root->GetArrayField(TEXT("results")))
+	{
+		const TSharedPtr<FJsonObject>& Entry = Value->AsObject();
+		Baseline.Add({ static_cast<int32>(Entry->GetNumberField(TEXT("width"))), static_cast<int32>(Entry->GetNumberField(TEXT("height"))) }, Entry);
+	}
+
+	int32 NumRegressions = 0;
+	for (const FSizeResult& Result : Results)
+	{
+		const TSharedPtr<FJsonObject>* Entry = Baseline.Find({ Result.Width, Result.Height });
+		if (!Entry)
+		{
+			// A size the baseline does not cover would otherwise pass unchecked
+			UE_LOG(LogTemp, Error, TEXT("The baseline has no results for a [%dx%d] board"), Result.Width, Result.Height);
+			NumRegressions++;
+			continue;
+		}
+
+		for (const TPair<FString, double>& Metric : Result.Metrics)
+		{
+			double BaselineValue = 0.;
+			if (!(*Entry)->TryGetNumberField(Metric.Key, BaselineValue))
+			{
+				continue;
+			}
+
+			// Every metric is better when lower. A zero baseline only fails if the metric appears at all
+			const FString Key = FString::Printf(TEXT("%s@%dx%d"), *Metric.Key, Result.Width, Result.Height);
+			const bool bRegressed = BaselineValue > 0. ? Metric.Value > BaselineValue * (1. + Tolerance) : Metric.Value > 0.;
+			if (bRegressed)
+			{
+				UE_LOG(LogTemp, Error, TEXT("%-32s regressed (%.2f -> %.2f)"), *Key, BaselineValue, Metric.Value);
+				NumRegressions++;
+			}
+			else
+			{
+				UE_LOG(LogTemp, Display, TEXT("%-32s %.2f (baseline %.2f)"), *Key, Metric.Value, BaselineValue);
+			}
+		}
+	}
+	return NumRegressions;
+}
+
+void UMatchThreePerfRun::HandlePreGarbageCollect()
+{
+	GarbageCollectStartTime = FPlatformTime::Seconds();
+}
+
+void UMatchThreePerfRun::HandlePostGarbageCollect()
+{
+	if (Stage == EStage::Measure)
+	{
+		MaxGarbageCollectMilliseconds = FMath::Max(MaxGarbageCollectMilliseconds, (FPlatformTime::Seconds() - GarbageCollectStartTime) * 1000.);
+	}
+}
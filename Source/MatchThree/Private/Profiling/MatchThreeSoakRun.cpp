@@ -0,0 +1,123 @@
+// Copyright Peter Carsten Collins (2024)
+
+
+#include "Profiling/MatchThreeSoakRun.h"
+
+#include "Board/TaskBase.h"
+#include "Core/MatchThreeAutoPlayer.h"
+#include "Core/MatchThreeGameMode.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GemBase.h"
+#include "HAL/PlatformMemory.h"
+#include "HAL/PlatformMisc.h"
+#include "Misc/DateTime.h"
+#include "Misc/Paths.h"
+#include "Score/ScoreActor.h"
+#include "UObject/UObjectIterator.h"
+
+void UMatchThreeSoakRun::Init(AMatchThreeGameMode* InGameMode, const TCHAR* Params)
+{
+	GameMode = InGameMode;
+
+	double Hours = Duration / 3600.;
+	FParse::Value(Params, TEXT("SoakHours="), Hours);
+	Duration = Hours * 3600.;
+	FParse::Value(Params, TEXT("SoakInterval="), SampleInterval);
+
+	int32 Window = 6;
+	FParse::Value(Params, TEXT("SoakWindow="), Window);
+	GrowthTracker = FGrowthTracker(Window);
+	FParse::Value(Params, TEXT("SoakMemoryGrowthMB="), PhysicalMemoryMinGrowthMB);
+
+	int32 Seed = 1;
+	FParse::Value(Params, TEXT("SoakSeed="), Seed);
+
+	OutputPath = FPaths::ProjectSavedDir() / TEXT("Soak") / FString::Printf(TEXT("Soak_%s.csv"), *FDateTime::Now().ToString());
+	FParse::Value(Params, TEXT("SoakOutput="), OutputPath);
+
+	AutoPlayer = NewObject<UMatchThreeAutoPlayer>(this);
+	AutoPlayer->Init(GameMode, Seed);
+
+	// The first sample is taken once the board has filled and play has started
+	TimeUntilSample = SampleInterval;
+
+	UE_LOG(LogTemp, Display, TEXT("Starting a [%.1f] hour soak, sampling every [%.0f] seconds"), Hours, SampleInterval);
+}
+
+void UMatchThreeSoakRun::Tick(float DeltaSeconds)
+{
+	if (bFinished)
+	{
+		return;
+	}
+
+	AutoPlayer->Tick(DeltaSeconds);
+
+	RunTime += DeltaSeconds;
+	TimeUntilSample -= DeltaSeconds;
+	if (TimeUntilSample <= 0.)
+	{
+		TimeUntilSample += SampleInterval;
+		Sample();
+	}
+
+	if (RunTime >= Duration)
+	{
+		Finish();
+	}
+}
+
+void UMatchThreeSoakRun::Sample()
+{
+	// Only count what is still reachable
+	CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+
+	int32 NumGems = 0;
+	int32 NumGemBindings = 0;
+	for (TActorIterator<AGemBase> It(GameMode->GetWorld()); It; ++It)
+	{
+		NumGems++;
+		NumGemBindings += It->OnGemMoveToCompleteDelegate.GetAllObjects().Num();
+	}
+
+	int32 NumScoreActors = 0;
+	for (TActorIterator<AScoreActor> It(GameMode->GetWorld()); It; ++It)
+	{
+		NumScoreActors++;
+	}
+
+	int32 NumTasks = 0;
+	for (TObjectIterator<UTaskBase> It(RF_ClassDefaultObject); It; ++It)
+	{
+		NumTasks++;
+	}
+
+	GrowthTracker.Record(TEXT("GemActors"), TEXT("Gems"), NumGems);
+	GrowthTracker.Record(TEXT("GemBindings"), TEXT("Gems"), NumGemBindings);
+	GrowthTracker.Record(TEXT("TaskObjects"), TEXT("Tasks"), NumTasks);
+	GrowthTracker.Record(TEXT("TaskTimers"), TEXT("Tasks"), UTaskBase::GetNumActiveTimers());
+	GrowthTracker.Record(TEXT("ScoreActors"), TEXT("FX"), NumScoreActors);
+	GrowthTracker.Record(TEXT("Actors"), TEXT("World"), GameMode->GetWorld()->GetActorCount());
+	GrowthTracker.Record(TEXT("UObjects"), TEXT("Engine"), GUObjectArray.GetObjectArrayNumMinusAvailable());
+	GrowthTracker.Record(TEXT("UsedPhysicalMB"), TEXT("Memory"), FPlatformMemory::GetStats().UsedPhysical / (1024. * 1024.), PhysicalMemoryMinGrowthMB, EGrowthKind::Noisy);
+	GameMode->SampleGrowth(GrowthTracker);
+
+	GrowthTracker.Analyse();
+	GrowthTracker.WriteCsv(OutputPath);
+}
+
+void UMatchThreeSoakRun::Finish()
+{
+	bFinished = true;
+
+	GrowthTracker.LogReport();
+	UE_LOG(LogTemp, Display, TEXT("Wrote soak samples to [%s]"), *OutputPath);
+
+	const int32 NumFlagged = GrowthTracker.GetNumFlagged();
+	if (NumFlagged != 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("[%d] series grew during the soak"), NumFlagged);
+	}
+	FPlatformMisc::RequestExitWithStatus(false, NumFlagged != 0 ? 1 : 0);
+}
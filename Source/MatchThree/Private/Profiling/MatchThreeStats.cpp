@@ -0,0 +1,37 @@
+// Copyright Peter Carsten Collins (2024)
+
+
+#include "Profiling/MatchThreeStats.h"
+
+DEFINE_STAT(STAT_MatchThree_SwapGems);
+DEFINE_STAT(STAT_MatchThree_ResolveSwap);
+DEFINE_STAT(STAT_MatchThree_MatchDetection);
+DEFINE_STAT(STAT_MatchThree_HandleMatches);
+DEFINE_STAT(STAT_MatchThree_CollapseColumn);
+DEFINE_STAT(STAT_MatchThree_AddGems);
+DEFINE_STAT(STAT_MatchThree_SpawnGem);
+DEFINE_STAT(STAT_MatchThree_DestroyGem);
+DEFINE_STAT(STAT_MatchThree_Broadcast);
+DEFINE_STAT(STAT_MatchThree_TaskPool);
+DEFINE_STAT(STAT_MatchThree_BoardTick);
+DEFINE_STAT(STAT_MatchThree_SaveSnapshot);
+DEFINE_STAT(STAT_MatchThree_RestoreSnapshot);
+DEFINE_STAT(STAT_MatchThree_SpecialClears);
+DEFINE_STAT(STAT_MatchThree_BoardWorker);
+DEFINE_STAT(STAT_MatchThree_PresentBoardEvents);
+
+DEFINE_STAT(STAT_MatchThree_LiveGems);
+DEFINE_STAT(STAT_MatchThree_PooledGems);
+DEFINE_STAT(STAT_MatchThree_LiveTasks);
+DEFINE_STAT(STAT_MatchThree_ActiveTimers);
+DEFINE_STAT(STAT_MatchThree_MatchesPerFrame);
+DEFINE_STAT(STAT_MatchThree_MatchAllocations);
+
+UE_TRACE_CHANNEL_DEFINE(MatchThreeChannel);
+
+TRACE_DECLARE_INT_COUNTER(MatchThree_LiveGems, TEXT("MatchThree/Live Gems"));
+TRACE_DECLARE_INT_COUNTER(MatchThree_PooledGems, TEXT("MatchThree/Pooled Gems"));
+TRACE_DECLARE_INT_COUNTER(MatchThree_LiveTasks, TEXT("MatchThree/Live Tasks"));
+TRACE_DECLARE_INT_COUNTER(MatchThree_ActiveTimers, TEXT("MatchThree/Active Timers"));
+TRACE_DECLARE_INT_COUNTER(MatchThree_MatchesPerFrame, TEXT("MatchThree/Matches Per Frame"));
+TRACE_DECLARE_INT_COUNTER(MatchThree_MatchAllocations, TEXT("MatchThree/Match Pipeline Allocations"));
@@ -6,6 +6,9 @@
 AScoreActor::AScoreActor()
 {
 	PrimaryActorTick.bCanEverTick = false;
+
+	// One is spawned for every match so they must clean themselves up
+	InitialLifeSpan = 3.f;
 }
 
 void AScoreActor::BeginPlay()
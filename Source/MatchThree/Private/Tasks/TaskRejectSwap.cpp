@@ -0,0 +1,69 @@
+// Copyright Peter Carsten Collins (2024)
+
+
+#include "Tasks/TaskRejectSwap.h"
+#include "GameBoard.h"
+
+void UTaskRejectSwap::Init(AGameBoard* InGameBoard, const FBoardLocation& InLocationA, const FBoardLocation& InLocationB, float InNudgeFraction)
+{
+	GameBoard = InGameBoard;
+	LocationA = InLocationA;
+	LocationB = InLocationB;
+	NudgeFraction = InNudgeFraction;
+}
+
+void UTaskRejectSwap::Execute()
+{
+	GemA = GameBoard->GetGem(LocationA);
+	GemB = GameBoard->GetGem(LocationB);
+
+	// Only settled gems can be nudged, a gem still landing already shows where it is going
+	if (!GemA || !GemB || GameBoard->GetCellState(LocationA) != ECellState::Settled || GameBoard->GetCellState(LocationB) != ECellState::Settled)
+	{
+		Complete();
+		return;
+	}
+
+	// The gems stay on their cells so they must not match while they are away from them
+	GameBoard->SetCellState(LocationA, ECellState::Swapping);
+	GameBoard->SetCellState(LocationB, ECellState::Swapping);
+
+	GemA->OnGemMoveToCompleteDelegate.AddUniqueDynamic(this, &UTaskRejectSwap::MoveToCompleteCallback);
+	GemB->OnGemMoveToCompleteDelegate.AddUniqueDynamic(this, &UTaskRejectSwap::MoveToCompleteCallback);
+
+	const FVector WorldLocationA = GameBoard->GetWorldLocation(LocationA);
+	const FVector WorldLocationB = GameBoard->GetWorldLocation(LocationB);
+	GemA->MoveTo(FMath::Lerp(WorldLocationA, WorldLocationB, NudgeFraction));
+	GemB->MoveTo(FMath::Lerp(WorldLocationB, WorldLocationA, NudgeFraction));
+}
+
+void UTaskRejectSwap::MoveToCompleteCallback(AGemBase* MovedGem)
+{
+	if (++NumArrived < 2)
+	{
+		return;
+	}
+	NumArrived = 0;
+
+	if (!bReturning)
+	{
+		// Go back to the cells the gems are on now rather than the ones they left from
+		bReturning = true;
+		GemA->MoveTo(GameBoard->GetWorldLocation(GameBoard->ContainsGem(GemA) ? GameBoard->GetBoardLocation(GemA) : LocationA));
+		GemB->MoveTo(GameBoard->GetWorldLocation(GameBoard->ContainsGem(GemB) ? GameBoard->GetBoardLocation(GemB) : LocationB));
+		return;
+	}
+
+	GemA->OnGemMoveToCompleteDelegate.RemoveDynamic(this, &UTaskRejectSwap::MoveToCompleteCallback);
+	GemB->OnGemMoveToCompleteDelegate.RemoveDynamic(this, &UTaskRejectSwap::MoveToCompleteCallback);
+
+	for (const FBoardLocation& Location : { LocationA, LocationB })
+	{
+		if (GameBoard->GetCellState(Location) == ECellState::Swapping)
+		{
+			GameBoard->SetCellState(Location, ECellState::Settled);
+		}
+	}
+
+	Complete();
+}
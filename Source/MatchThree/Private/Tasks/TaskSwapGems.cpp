@@ -14,36 +14,47 @@ void UTaskSwapGems::Init(AGameBoard* InGameBoard, const FBoardLocation& InLocati
 void UTaskSwapGems::Execute()
 {
 	bCallbackCalled = false;
-	AGemBase* GemA = GameBoard->GetGem(LocationA);
-	AGemBase* GemB = GameBoard->GetGem(LocationB);
+	GemA = GameBoard->GetGem(LocationA);
+	GemB = GameBoard->GetGem(LocationB);
 
-	if (GemA && GemB)
+	if (GemA.IsValid() && GemB.IsValid())
 	{
-		GemA->bCannotMatch = true;
-		GemB->bCannotMatch = true;
-
 		GemA->OnGemMoveToCompleteDelegate.AddUniqueDynamic(this, &UTaskSwapGems::MoveToCompleteCallback);
 		GemB->OnGemMoveToCompleteDelegate.AddUniqueDynamic(this, &UTaskSwapGems::MoveToCompleteCallback);
 
 		GemA->MoveTo(GameBoard->GetWorldLocation(LocationB));
 		GemB->MoveTo(GameBoard->GetWorldLocation(LocationA));
 
-		GameBoard->SetGem(GemA, LocationB);
-		GameBoard->SetGem(GemB, LocationA);
+		// The gems are on their new cells at once, but cannot match until they arrive
+		GameBoard->SetGem(GemA.Get(), LocationB, ECellState::Swapping);
+		GameBoard->SetGem(GemB.Get(), LocationA, ECellState::Swapping);
 	}
 }
 
 void UTaskSwapGems::MoveToCompleteCallback(AGemBase* MovedGem)
 {
-	if (!bCallbackCalled && GameBoard->IsInPosition(LocationA) && GameBoard->IsInPosition(LocationB))
+	auto HasArrived = [](const TWeakObjectPtr<AGemBase>& Gem) { return !Gem.IsValid() || !Gem->IsMoving(); };
+	if (!bCallbackCalled && HasArrived(GemA) && HasArrived(GemB))
 	{
 		bCallbackCalled = true;
 
-		AGemBase* GemA = GameBoard->GetGem(LocationA);
-		AGemBase* GemB = GameBoard->GetGem(LocationB);
-
-		GemA->bCannotMatch = false;
-		GemB->bCannotMatch = false;
+		// Gems live much longer than the swap so they must not keep calling back into it
+		for (const TWeakObjectPtr<AGemBase>& Gem : { GemA, GemB })
+		{
+			if (Gem.IsValid())
+			{
+				Gem->OnGemMoveToCompleteDelegate.RemoveDynamic(this, &UTaskSwapGems::MoveToCompleteCallback);
+			}
+		}
+
+		// A cascade in a neighbouring region may have moved the gems on
+		for (const FBoardLocation& Location : { LocationA, LocationB })
+		{
+			if (GameBoard->GetCellState(Location) == ECellState::Swapping)
+			{
+				GameBoard->SetCellState(Location, ECellState::Settled);
+			}
+		}
 
 		Complete();
 	}
@@ -0,0 +1,122 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include <atomic>
+
+class FEvent;
+class FRunnableThread;
+class IFileHandle;
+class IPlatformFile;
+struct FMatch;
+
+/* The shape of a single match */
+enum class EMatchShape : uint8
+{
+	Line3,
+	Line4,
+	Line5,
+	// A match spanning both rows and columns, an L, T or cross
+	Cross,
+};
+
+/* Analytics for a single player move, from input until the board settles */
+struct FMoveRecord
+{
+	static constexpr int32 MaxShapes = 15;
+
+	// Seconds since the session started
+	double Time = 0.;
+
+	uint32 MoveId = 0;
+
+	// The swapped locations
+	int16 LocationAX = 0;
+	int16 LocationAY = 0;
+	int16 LocationBX = 0;
+	int16 LocationBY = 0;
+
+	int32 ScoreDelta = 0;
+
+	// Milliseconds from input until the board settled
+	float SettleMilliseconds = 0.f;
+
+	bool bMatched = false;
+
+	// The number of match resolutions in the move, the swap's own included
+	uint8 CascadeDepth = 0;
+
+	// The shapes of the matches in the order they were resolved. Shapes beyond the limit are dropped
+	uint8 NumShapes = 0;
+	EMatchShape Shapes[MaxShapes];
+
+	void AddShape(EMatchShape Shape);
+
+	// Classify a match by the rows and columns it covers
+	static EMatchShape GetShape(const FMatch& Match);
+};
+
+/**
+ * Collects move records from the game thread into a fixed lock-free single producer ring and writes them from a background
+ * thread to rotating length-prefixed binary files in Saved/Analytics. Emitting a record never allocates or touches the disk
+ */
+class MATCHTHREE_API FMoveAnalyticsWriter : public FRunnable
+{
+public:
+	FMoveAnalyticsWriter();
+	virtual ~FMoveAnalyticsWriter() override;
+
+	// Start the writer thread. Analytics files from every session are kept up to MaxTotalBytes, deleting the oldest first
+	void Start(int64 InMaxTotalBytes);
+
+	// Write the remaining records and stop the writer thread
+	void Shutdown();
+
+	// Queue a record for writing. Game thread only. The record is dropped if the ring is full
+	void Emit(const FMoveRecord& Record);
+
+	uint32 GetNumDropped() const { return NumDropped.load(std::memory_order_relaxed); }
+
+	//~ Begin FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+	//~ End FRunnable interface
+
+private:
+	// Write every record queued so far to the current file
+	void Flush();
+
+	// Close the current file and start a new one
+	void Rotate();
+
+	// Delete the oldest analytics files, from this session or earlier ones, until the rest fit in MaxTotalBytes
+	void Prune(IPlatformFile& PlatformFile, const FString& Directory);
+
+	static constexpr uint32 Capacity = 1024;
+	static constexpr uint32 Mask = Capacity - 1;
+	static_assert((Capacity & Mask) == 0, "The ring capacity must be a power of two");
+
+	FMoveRecord Slots[Capacity];
+
+	// Written by the game thread only
+	std::atomic<uint32> WriteIndex{ 0 };
+
+	// Written by the writer thread only
+	std::atomic<uint32> ReadIndex{ 0 };
+
+	std::atomic<uint32> NumDropped{ 0 };
+	std::atomic<bool> bStopping{ false };
+
+	FRunnableThread* Thread = nullptr;
+	FEvent* WakeEvent = nullptr;
+
+	int64 MaxTotalBytes = 0;
+
+	// Writer thread state
+	TUniquePtr<IFileHandle> File;
+	FString FileName;
+	int64 BytesInFile = 0;
+	TArray<uint8> Scratch;
+};
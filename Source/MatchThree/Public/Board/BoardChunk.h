@@ -0,0 +1,49 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Board/Match.h"
+#include "BoardChunk.generated.h"
+
+/**
+ * A fixed size block of cells that is simulated only while something in it is happening
+ */
+USTRUCT()
+struct FBoardChunk
+{
+	GENERATED_BODY()
+
+	// The lowest cell in the chunk
+	FBoardLocation Min;
+
+	// One past the highest cell in the chunk
+	FBoardLocation Max;
+
+	// True if the gems in the chunk are ticking
+	bool bIsAwake = true;
+
+	// Time the chunk last had a moving gem, a pending match or an edit
+	double LastActiveTime = 0.;
+
+	// Cycles spent checking the chunk for activity on the last board tick
+	uint32 LastTickCycles = 0;
+
+	// Number of gems in the chunk that are moving, matched or selected
+	int32 NumActiveGems = 0;
+};
+
+/**
+ * A summary of the chunk activity on the board
+ */
+struct FBoardChunkStats
+{
+	int32 NumAwake = 0;
+	int32 NumSleeping = 0;
+
+	// Average time to check an awake chunk for activity on the last board tick
+	double AverageAwakeChunkMicroseconds = 0.;
+
+	// Highest number of active gems in a single chunk
+	int32 MaxActiveGemsInChunk = 0;
+};
@@ -32,8 +32,14 @@ public:
 
 	int32 GetIndex(const AGemBase* Gem) const;
 
-	void QueueGemToSpawn(EGemType GemType);
-	EGemType DequeueGemToSpawn();
+	void QueueGemToSpawn(uint8 TypeId);
+	uint8 DequeueGemToSpawn();
+
+	// Put a dequeued gem type back at the front of the queue
+	void RequeueGemToSpawn(uint8 TypeId);
+
+	// Get a queued gem type without dequeuing it, oldest first
+	uint8 GetGemToSpawn(int32 Index) const;
 
 	int32 GetEmptySpaceUnder(int32 Index) const;
 
@@ -46,5 +52,6 @@ public:
 private:
 	TArray<AGemBase*> Gems;
 
-	TArray<EGemType> GemsToSpawn;
+	// Type ids of the gems waiting to spawn
+	TArray<uint8> GemsToSpawn;
 };
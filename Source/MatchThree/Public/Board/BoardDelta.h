@@ -0,0 +1,45 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * The change one move made to the board: the cells it changed, the queued gems it consumed and the random stream around it.
+ * Undoing or redoing the move touches only these, so the cost follows the size of the move rather than the board
+ */
+struct FBoardDelta
+{
+	// A cell with no gem
+	static constexpr uint8 EmptyCell = 0xFF;
+
+	struct FCellChange
+	{
+		// Index = X * Height + Y
+		int32 Index = 0;
+		uint8 Before = EmptyCell;
+		uint8 After = EmptyCell;
+	};
+
+	struct FConsumedSpawn
+	{
+		uint16 Column = 0;
+		uint8 TypeId = 0;
+	};
+
+	TArray<FCellChange> Cells;
+
+	// Gems taken from the spawn queues that were already queued before the move, in the order they were taken
+	TArray<FConsumedSpawn> ConsumedSpawns;
+
+	// The seed of the board's random stream before and after the move
+	int32 SeedBefore = 0;
+	int32 SeedAfter = 0;
+
+	int32 ScoreDelta = 0;
+
+	// Returns true if the move left the board as it found it, such as a swap that was undone for lack of a match
+	bool IsEmpty() const { return Cells.IsEmpty(); }
+
+	SIZE_T GetAllocatedSize() const { return Cells.GetAllocatedSize() + ConsumedSpawns.GetAllocatedSize(); }
+};
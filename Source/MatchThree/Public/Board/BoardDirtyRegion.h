@@ -0,0 +1,44 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Board/Match.h"
+
+/**
+ * The columns and rows of the board changed since the region was last cleared. Every change to a cell marks its column and
+ * row, so work that follows changes can skip the clean parts of the board entirely
+ */
+class MATCHTHREE_API FBoardDirtyRegion
+{
+public:
+	// Size the region to the board with every column and row clean
+	void Init(int32 Width, int32 Height);
+
+	// Mark every column and row clean, keeping the size
+	void Reset();
+
+	void MarkCell(const FBoardLocation& Location);
+
+	// Mark the whole board dirty
+	void MarkAll();
+
+	bool IsClean() const { return NumDirtyColumns == 0; }
+
+	bool IsColumnDirty(int32 X) const { return DirtyColumns[X]; }
+	bool IsRowDirty(int32 Y) const { return DirtyRows[Y]; }
+
+	// A line through a cell can have changed only if the cell's column or row is dirty
+	bool IsCellDirty(const FBoardLocation& Location) const { return DirtyColumns[Location.X] || DirtyRows[Location.Y]; }
+
+	int32 GetNumDirtyColumns() const { return NumDirtyColumns; }
+
+	const TBitArray<>& GetDirtyColumns() const { return DirtyColumns; }
+	const TBitArray<>& GetDirtyRows() const { return DirtyRows; }
+
+private:
+	TBitArray<> DirtyColumns;
+	TBitArray<> DirtyRows;
+
+	int32 NumDirtyColumns = 0;
+};
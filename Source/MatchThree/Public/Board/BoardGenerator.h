@@ -0,0 +1,63 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Fills and reshuffles boards of gem type indices so that no gems start in a match and at least a minimum number of legal
+ * moves are available. Cells are stored column by column, Index = X * Height + Y, matching the board's columns
+ */
+class MATCHTHREE_API FBoardGenerator
+{
+public:
+	// A cell with no gem. It never matches and is never moved by a reshuffle
+	static constexpr uint8 EmptyCell = 0xFF;
+
+	FBoardGenerator(int32 InWidth, int32 InHeight, int32 InNumTypes);
+
+	// Fill a board with no matches and at least MinMoves legal moves. Returns false if no such board was found
+	bool Generate(FRandomStream& Random, int32 MinMoves, TArray<uint8>& OutTypes) const;
+
+	// Rearrange the given types into a board with no matches and at least MinMoves legal moves, keeping the number of gems of
+	// each type. OutSources holds the cell each cell's gem comes from. Returns false if no such arrangement was found
+	bool Reshuffle(FRandomStream& Random, int32 MinMoves, const TArray<uint8>& Types, TArray<int32>& OutSources) const;
+
+	// Count the swaps of neighbouring gems that would form a match, stopping early at MaxMoves
+	int32 CountMoves(const TArray<uint8>& Types, int32 MaxMoves = MAX_int32) const;
+
+	// Returns true if any gems are already in a match
+	bool HasMatch(const TArray<uint8>& Types) const;
+
+	int32 GetIndex(int32 X, int32 Y) const { return X * Height + Y; }
+
+	// The most types a board can use. Every other type index is a gem
+	static constexpr int32 MaxTypes = EmptyCell;
+
+private:
+	/* The types that would complete a run of three at a cell. There are at most two, one from each direction */
+	struct FForbiddenTypes
+	{
+		uint8 Types[2] = { EmptyCell, EmptyCell };
+
+		bool Contains(int32 Type) const { return Types[0] == Type || Types[1] == Type; }
+
+		int32 Num() const { return (Types[0] != EmptyCell) + (Types[1] != EmptyCell); }
+	};
+
+	// Get the types that would complete a run of three with the two cells to the left or the two cells below
+	FForbiddenTypes GetForbiddenTypes(const TArray<uint8>& Types, int32 X, int32 Y) const;
+
+	// Returns true if the cell is part of a run of three or more in either direction
+	bool FormsMatchAt(const TArray<uint8>& Types, int32 X, int32 Y) const;
+
+	// Place a pair and a third gem one swap away from joining it, undoing the change if it forms a match
+	bool PlantMove(FRandomStream& Random, TArray<uint8>& Types) const;
+
+	int32 Width;
+	int32 Height;
+	int32 NumTypes;
+
+	// Attempts made before giving up on a fill or a reshuffle
+	static constexpr int32 MaxAttempts = 32;
+};
@@ -0,0 +1,123 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Board/BoardMask.h"
+#include "Board/Match.h"
+#include "Gem/GemArchetypeRegistry.h"
+
+struct FBoardSnapshot;
+
+/* What the game thread has to show for a change to the logical board */
+enum class EBoardEventType : uint8
+{
+	// The swap matched. The gems trade places
+	SwapAccepted,
+	// The swap did not match. The gems are nudged and stay put
+	SwapRejected,
+	// The gem at Location is cleared
+	Destroy,
+	// The gem at Location falls to Target
+	Move,
+	// A gem of TypeId drops in to Location, taken from the front of the column's spawn queue if bFromSpawnQueue
+	Spawn,
+	// NumGems gems were cleared, the first of them at Location
+	Score,
+	// The events of one step of the cascade are complete. The next step waits for its gems to land
+	StepEnd,
+	// The move has no more matches to resolve. RandomSeed is where the worker's random stream was left
+	Settled,
+	// The board was left with no legal moves
+	DeadBoard,
+};
+
+/* A change to the logical board, in the order the game thread should show it */
+struct FBoardEvent
+{
+	EBoardEventType Type = EBoardEventType::StepEnd;
+
+	// The gem type of a spawn
+	uint8 TypeId = FGemArchetypeRegistry::InvalidTypeId;
+
+	// The order of a fall within its column, for staggering the falls
+	int16 Order = 0;
+
+	FBoardLocation Location;
+
+	// Where a gem falls to, or the other cell of a swap
+	FBoardLocation Target;
+
+	int32 NumGems = 0;
+
+	// The seed of the worker's random stream after a spawn or once a move settles, so the game board's stream keeps up with it
+	int32 RandomSeed = 0;
+
+	// Whether a spawn used up the next gem queued for its column
+	bool bFromSpawnQueue = false;
+
+	// The latency span of the move the event belongs to
+	uint32 SpanId = 0;
+};
+
+/**
+ * The rules of the board on type ids alone, with no actors, so it can run away from the game thread. Matching, clearing,
+ * collapsing and refilling are resolved at once and reported as a stream of events for the game board to show
+ */
+class MATCHTHREE_API FBoardLogic
+{
+public:
+	// Copy the cells, spawn queues and random stream of a settled board. Empty cells are filled at random
+	void Init(const FBoardSnapshot& Snapshot, const FGemArchetypeRegistry& InRegistry);
+
+	int32 GetWidth() const { return Width; }
+	int32 GetHeight() const { return Height; }
+
+	uint8 GetTypeId(const FBoardLocation& Location) const { return Cells[GetIndex(Location)]; }
+
+	bool IsValidLocation(const FBoardLocation& Location) const;
+
+	// Return true if the cells are neighbours and swapping them would form a match. The cells are swapped and put back
+	bool WouldSwapMatch(const FBoardLocation& LocationA, const FBoardLocation& LocationB);
+
+	// Exchange the gems of two cells
+	void Swap(const FBoardLocation& LocationA, const FBoardLocation& LocationB);
+
+	// Clear every match on the board, collapse the columns and refill them, emitting the events to show it followed by a
+	// StepEnd. Returns the number of gems cleared, zero once the board is stable
+	int32 ResolveStep(uint32 SpanId, TFunctionRef<void(const FBoardEvent&)> Emit);
+
+	// Count the swaps that would form a match, stopping early at MaxMoves
+	int32 CountLegalMoves(int32 MaxMoves = MAX_int32);
+
+	int32 GetRandomSeed() const { return Random.GetCurrentSeed(); }
+
+private:
+	int32 GetIndex(const FBoardLocation& Location) const { return Location.X * Height + Location.Y; }
+
+	// Return true if the gem at the location is in a line of three or more
+	bool IsMatched(const FBoardLocation& Location) const;
+
+	// Set the cells of every line of three or more. Returns false if there are none
+	bool FindMatches(FBoardMask& OutMask) const;
+
+	// Pick the next gem for the column, from its spawn queue while it lasts and at random after that
+	uint8 NextSpawn(int32 Column);
+
+	int32 Width = 0;
+	int32 Height = 0;
+
+	// The type id of every cell, column by column
+	TArray<uint8> Cells;
+
+	// The gems queued to spawn in each column and how many of them have spawned
+	TArray<TArray<uint8>> SpawnQueues;
+	TArray<int32> NumSpawned;
+
+	FRandomStream Random;
+
+	FGemArchetypeRegistry Registry;
+
+	// Reused by every step
+	FBoardMask ClearMask;
+};
@@ -0,0 +1,96 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Board/Match.h"
+
+/**
+ * One bit per board cell, column by column, Index = X * Height + Y. Whole columns are contiguous runs of bits, so clearing
+ * areas can be built and combined a word at a time
+ */
+class MATCHTHREE_API FBoardMask
+{
+public:
+	FBoardMask() = default;
+	FBoardMask(int32 InWidth, int32 InHeight) { Init(InWidth, InHeight); }
+
+	// Size the mask to the board and clear every bit
+	void Init(int32 InWidth, int32 InHeight);
+
+	// Clear every bit, keeping the size
+	void Reset();
+
+	int32 GetIndex(const FBoardLocation& Location) const { return Location.X * Height + Location.Y; }
+	FBoardLocation GetLocation(int32 Index) const { return FBoardLocation(Index / Height, Index % Height); }
+
+	bool Get(int32 Index) const { return (Words[Index >> 6] & (uint64(1) << (Index & 63))) != 0; }
+	void Set(int32 Index) { Words[Index >> 6] |= uint64(1) << (Index & 63); }
+	void Clear(int32 Index) { Words[Index >> 6] &= ~(uint64(1) << (Index & 63)); }
+
+	bool Get(const FBoardLocation& Location) const { return Get(GetIndex(Location)); }
+	void Set(const FBoardLocation& Location) { Set(GetIndex(Location)); }
+	void Clear(const FBoardLocation& Location) { Clear(GetIndex(Location)); }
+
+	// Set every cell of a column
+	void SetColumn(int32 X);
+
+	// Set every cell of a row
+	void SetRow(int32 Y);
+
+	// Set the square of cells within Radius of the location, clipped to the board
+	void SetArea(const FBoardLocation& Center, int32 Radius);
+
+	FBoardMask& operator|=(const FBoardMask& Other);
+
+	bool IsEmpty() const;
+
+	int32 CountBits() const;
+
+	// Count the set cells in a column
+	int32 CountBitsInColumn(int32 X) const;
+
+	// Get the lowest set cell in a column, or INDEX_NONE if the column is clear
+	int32 FindFirstInColumn(int32 X) const;
+
+	// Call Func with the index of every set bit, in index order
+	template <typename FuncType>
+	void ForEachSetBit(FuncType&& Func) const
+	{
+		for (int32 WordIndex = 0; WordIndex < Words.Num(); WordIndex++)
+		{
+			uint64 Word = Words[WordIndex];
+			while (Word != 0)
+			{
+				const int32 Bit = static_cast<int32>(FMath::CountTrailingZeros64(Word));
+				Func(WordIndex * 64 + Bit);
+				Word &= Word - 1;
+			}
+		}
+	}
+
+private:
+	// Set the run of bits [Start, Start + Num)
+	void SetRange(int32 Start, int32 Num);
+
+	// Call Func with each word touched by the run of bits [Start, Start + Num), the bits of the run in that word and the
+	// index of the word's first bit
+	template <typename FuncType>
+	void ForEachWordInRange(int32 Start, int32 Num, FuncType&& Func) const
+	{
+		int32 Index = Start;
+		const int32 End = Start + Num;
+		while (Index < End)
+		{
+			const int32 Bit = Index & 63;
+			const int32 BitsInWord = FMath::Min(64 - Bit, End - Index);
+			const uint64 Bits = BitsInWord == 64 ? MAX_uint64 : ((uint64(1) << BitsInWord) - 1) << Bit;
+			Func(Index >> 6, Bits);
+			Index += BitsInWord;
+		}
+	}
+
+	int32 Width = 0;
+	int32 Height = 0;
+	TArray<uint64, TInlineAllocator<16>> Words;
+};
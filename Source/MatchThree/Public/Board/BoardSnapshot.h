@@ -0,0 +1,58 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/* A swap that had not resolved when the snapshot was taken. It is queued again on restore */
+struct FSnapshotSwap
+{
+	int16 LocationAX = 0;
+	int16 LocationAY = 0;
+	int16 LocationBX = 0;
+	int16 LocationBY = 0;
+};
+
+/**
+ * A compact binary image of a game in progress. Gems are stored as type ids rather than actors, so a snapshot can be written
+ * off the game thread and restored by placing the whole board in one pass. Cells are stored column by column, Index = X * Height + Y
+ */
+struct MATCHTHREE_API FBoardSnapshot
+{
+	// A cell with no gem, such as a cell a cascade had not refilled yet
+	static constexpr uint8 EmptyCell = 0xFF;
+
+	static constexpr uint32 FileMagic = 0x4D33534E; // 'M3SN'
+	static constexpr uint16 FileVersion = 1;
+
+	int32 Width = 0;
+	int32 Height = 0;
+
+	// The number of gem types the type ids index into
+	int32 NumTypes = 0;
+
+	// The type id of every cell
+	TArray<uint8> Cells;
+
+	// The type ids waiting to spawn in each column, oldest first
+	TArray<TArray<uint8>> SpawnQueues;
+
+	// The current seed of the board's random stream
+	int32 RandomSeed = 0;
+
+	int32 Score = 0;
+
+	// Swaps that were queued or moving, in the order they were requested
+	TArray<FSnapshotSwap> Swaps;
+
+	int32 GetIndex(int32 X, int32 Y) const { return X * Height + Y; }
+
+	// Returns true if the dimensions, cells and queues are consistent with each other
+	bool IsValid() const;
+
+	// Write the snapshot with cells packed two to a byte where the type ids allow it, followed by a checksum
+	void Write(TArray<uint8>& OutBytes) const;
+
+	// Read a snapshot written by Write. Returns false if the data is truncated, corrupt or from another version
+	bool Read(const TArray<uint8>& Bytes);
+};
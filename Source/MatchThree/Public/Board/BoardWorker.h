@@ -0,0 +1,71 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "Board/BoardLogic.h"
+#include "Board/SpscRing.h"
+#include <atomic>
+
+class FEvent;
+class FRunnableThread;
+struct FBoardSnapshot;
+
+/* A swap requested by the game thread */
+struct FBoardCommand
+{
+	FBoardLocation LocationA;
+	FBoardLocation LocationB;
+
+	// The latency span of the player action
+	uint32 SpanId = 0;
+};
+
+/**
+ * Runs the logical board on its own thread. The game thread sends swaps over one lock-free single producer ring and reads
+ * back the events that show their outcome over another, so validating a swap and resolving its cascade never take game
+ * thread time. The logical board belongs to the worker between Start and Shutdown
+ */
+class MATCHTHREE_API FBoardWorker : public FRunnable
+{
+public:
+	FBoardWorker();
+	virtual ~FBoardWorker() override;
+
+	// Copy a settled board and start the worker thread
+	void Start(const FBoardSnapshot& Snapshot, const FGemArchetypeRegistry& Registry);
+
+	// Stop the worker thread. Commands not yet run and events not yet read are dropped
+	void Shutdown();
+
+	// Queue a swap. Game thread only. Returns false if the command ring is full
+	bool PushCommand(const FBoardCommand& Command);
+
+	// Take the oldest event the worker has produced. Game thread only. Returns false if there is none yet
+	bool PopEvent(FBoardEvent& OutEvent) { return Events.Pop(OutEvent); }
+
+	//~ Begin FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+	//~ End FRunnable interface
+
+private:
+	// Validate the swap and resolve its whole cascade
+	void RunCommand(const FBoardCommand& Command);
+
+	// Queue an event for the game thread. Waits while the ring is full so no event is lost, unless the worker is stopping
+	void Emit(const FBoardEvent& Event);
+
+	FBoardLogic Logic;
+
+	TSpscRing<FBoardCommand, 16> Commands;
+
+	// Large enough for a few cascade steps of a big board. A longer cascade waits for the game thread to catch up
+	TSpscRing<FBoardEvent, 4096> Events;
+
+	std::atomic<bool> bStopping{ false };
+
+	FRunnableThread* Thread = nullptr;
+	FEvent* WakeEvent = nullptr;
+};
@@ -0,0 +1,179 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * A linear arena for the scratch memory of a cascade. Allocating bumps an offset and nothing is freed until the arena is
+ * rewound by the FCascadeArenaScope of the cascade step, or reset as a whole. The chunks are kept across resets, so after the
+ * first few cascades the arena never touches the heap. Each thread has its own arena
+ */
+class MATCHTHREE_API FCascadeArena
+{
+public:
+	static constexpr SIZE_T ChunkSize = 64 * 1024;
+
+	// Get the arena of the calling thread
+	static FCascadeArena& Get();
+
+	FCascadeArena() = default;
+	~FCascadeArena();
+
+	FCascadeArena(const FCascadeArena&) = delete;
+	FCascadeArena& operator=(const FCascadeArena&) = delete;
+
+	// Take Size bytes from the arena. A new chunk is only allocated when the chunks held are full
+	void* Allocate(SIZE_T Size, uint32 Alignment);
+
+	// Release every allocation at once. Nothing allocated from the arena may be used after this
+	void Reset();
+
+	// A point in the arena to rewind to
+	struct FMark
+	{
+		int32 ChunkIndex = 0;
+		SIZE_T Offset = 0;
+		SIZE_T BytesUsed = 0;
+	};
+
+	FMark GetMark() const { return { ChunkIndex, Offset, BytesUsed }; }
+
+	// Release every allocation made since the mark was taken. Marks must be rewound in the reverse order they were taken
+	void Rewind(const FMark& Mark);
+
+	SIZE_T GetBytesUsed() const { return BytesUsed; }
+
+	// The most bytes used between any two resets
+	SIZE_T GetPeakBytesUsed() const { return PeakBytesUsed; }
+
+	int32 GetNumChunks() const { return Chunks.Num(); }
+
+private:
+	struct FChunk
+	{
+		uint8* Data = nullptr;
+		SIZE_T Size = 0;
+	};
+
+	TArray<FChunk, TInlineAllocator<8>> Chunks;
+
+	// The chunk being allocated from and the offset of its first free byte
+	int32 ChunkIndex = 0;
+	SIZE_T Offset = 0;
+
+	SIZE_T BytesUsed = 0;
+	SIZE_T PeakBytesUsed = 0;
+};
+
+/**
+ * Rewinds the calling thread's cascade arena to where it was when the scope opened, so each cascade step releases its scratch
+ * memory wherever it runs, on the game thread, the board worker or in a benchmark. Containers made inside the scope must not
+ * outlive it, and containers made before it must not grow inside it
+ */
+class FCascadeArenaScope
+{
+public:
+	FCascadeArenaScope()
+		: Arena(FCascadeArena::Get())
+		, Mark(Arena.GetMark())
+	{
+	}
+
+	~FCascadeArenaScope()
+	{
+		Arena.Rewind(Mark);
+	}
+
+	FCascadeArenaScope(const FCascadeArenaScope&) = delete;
+	FCascadeArenaScope& operator=(const FCascadeArenaScope&) = delete;
+
+private:
+	FCascadeArena& Arena;
+	FCascadeArena::FMark Mark;
+};
+
+/**
+ * Container allocator that takes its memory from the calling thread's cascade arena, in the manner of TMemStackAllocator.
+ * Growing copies the elements into a new block and leaves the old one to the arena, so containers using it must not outlive
+ * the arena scope they were made in
+ */
+template <uint32 Alignment = DEFAULT_ALIGNMENT>
+class TCascadeArenaAllocator
+{
+public:
+	using SizeType = int32;
+
+	enum { NeedsElementType = true };
+	enum { RequireRangeCheck = true };
+
+	template <typename ElementType>
+	class ForElementType
+	{
+	public:
+		ForElementType() = default;
+
+		void MoveToEmpty(ForElementType& Other)
+		{
+			checkSlow(this != &Other);
+			Data = Other.Data;
+			Other.Data = nullptr;
+		}
+
+		ElementType* GetAllocation() const { return Data; }
+
+		void ResizeAllocation(SizeType CurrentNum, SizeType NewMax, SIZE_T NumBytesPerElement)
+		{
+			ElementType* OldData = Data;
+			if (NewMax <= 0)
+			{
+				// An inline allocator checks for a secondary allocation, so an emptied one must read as none
+				Data = nullptr;
+				return;
+			}
+
+			Data = static_cast<ElementType*>(FCascadeArena::Get().Allocate(NewMax * NumBytesPerElement, FMath::Max<uint32>(Alignment, alignof(ElementType))));
+			if (OldData && CurrentNum)
+			{
+				FMemory::Memcpy(Data, OldData, FMath::Min(NewMax, CurrentNum) * NumBytesPerElement);
+			}
+		}
+
+		SizeType CalculateSlackReserve(SizeType NewMax, SIZE_T NumBytesPerElement) const
+		{
+			return DefaultCalculateSlackReserve(NewMax, NumBytesPerElement, false, Alignment);
+		}
+
+		SizeType CalculateSlackShrink(SizeType NewMax, SizeType CurrentMax, SIZE_T NumBytesPerElement) const
+		{
+			return DefaultCalculateSlackShrink(NewMax, CurrentMax, NumBytesPerElement, false, Alignment);
+		}
+
+		SizeType CalculateSlackGrow(SizeType NewMax, SizeType CurrentMax, SIZE_T NumBytesPerElement) const
+		{
+			return DefaultCalculateSlackGrow(NewMax, CurrentMax, NumBytesPerElement, false, Alignment);
+		}
+
+		SIZE_T GetAllocatedSize(SizeType CurrentMax, SIZE_T NumBytesPerElement) const { return CurrentMax * NumBytesPerElement; }
+
+		bool HasAllocation() const { return Data != nullptr; }
+
+		SizeType GetInitialCapacity() const { return 0; }
+
+	private:
+		ElementType* Data = nullptr;
+	};
+
+	typedef ForElementType<FScriptContainerElement> ForAnyElementType;
+};
+
+template <uint32 Alignment>
+struct TAllocatorTraits<TCascadeArenaAllocator<Alignment>> : TAllocatorTraitsBase<TCascadeArenaAllocator<Alignment>>
+{
+	enum { SupportsMove = true };
+	enum { IsZeroConstruct = true };
+};
+
+// An array whose elements live in the cascade arena
+template <typename ElementType>
+using TCascadeArray = TArray<ElementType, TCascadeArenaAllocator<>>;
@@ -0,0 +1,30 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CellState.generated.h"
+
+/* What the gem in a board cell is doing. Only settled gems can be matched, swapped or cleared */
+UENUM()
+enum class ECellState : uint8
+{
+	// No gem
+	Empty,
+	// A gem at rest on its cell
+	Settled,
+	// A gem falling onto its cell from higher in the column
+	Falling,
+	// A gem being swapped onto its cell, or nudged away and back by a rejected swap
+	Swapping,
+	// A gem in a match, waiting to be removed
+	Matched,
+	// A new gem dropping onto its cell from above the board
+	Spawning,
+};
+
+namespace CellState
+{
+	// Returns true if a cell may go from one state to the other. Staying in the same state is always allowed
+	MATCHTHREE_API bool IsLegalTransition(ECellState From, ECellState To);
+}
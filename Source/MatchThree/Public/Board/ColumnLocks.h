@@ -0,0 +1,36 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ColumnLocks.generated.h"
+
+/**
+ * Reference counted locks on the columns of the board. Actions that change a column hold a lock on it
+ * so that actions on disjoint columns can run at the same time
+ */
+USTRUCT()
+struct FColumnLocks
+{
+	GENERATED_BODY()
+
+public:
+	void Init(int32 NumColumns);
+
+	void Lock(int32 Column);
+	void Unlock(int32 Column);
+
+	// Returns true if any action holds the column
+	bool IsLocked(int32 Column) const;
+
+	// Get the number of locks held on the column
+	int32 GetLockCount(int32 Column) const { return LockCounts[Column]; }
+
+	// Returns true if no column is locked
+	bool IsEmpty() const;
+
+private:
+	TArray<int32> LockCounts;
+
+	int32 NumLocked = 0;
+};
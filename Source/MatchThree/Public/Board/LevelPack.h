@@ -0,0 +1,212 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/* What a level asks the player to achieve */
+enum class ELevelGoalType : uint8
+{
+	// Reach a score
+	Score,
+	// Clear a number of gems of one type
+	ClearGems,
+};
+
+/* A goal as it is stored in the pack */
+struct FLevelGoal
+{
+	ELevelGoalType Type = ELevelGoalType::Score;
+
+	// The gem type id to clear, for ClearGems goals
+	uint8 TypeId = 0;
+
+	uint16 Padding = 0;
+
+	int32 Target = 0;
+};
+static_assert(sizeof(FLevelGoal) == 8, "FLevelGoal is read straight from the pack");
+
+/**
+ * The file layout of a level pack. Every structure is read in place from the mapped file, so they are plain, little endian
+ * and 4 byte aligned. A pack is a header, the levels, then an index with one entry per level:
+ *
+ *   Level = FLevelRecord, FLevelGoal[NumGoals], uint32 SpawnOffsets[Width + 1], uint8 Mask[(Width * Height + 7) / 8],
+ *           uint8 Cells[Width * Height], uint8 SpawnTypes[SpawnOffsets[Width]]
+ *
+ * Cells are stored column by column, Index = X * Height + Y, matching the board's columns
+ */
+namespace LevelPack
+{
+	static constexpr uint32 FileMagic = 0x4D334C50; // 'M3LP'
+
+	// Bump whenever the layout changes. Packs of another version are rejected rather than misread
+	static constexpr uint16 FileVersion = 1;
+
+	// A cell with no fixed gem. It is filled from the column's spawn sequence when the level is opened
+	static constexpr uint8 RandomCell = 0xFF;
+
+	struct FHeader
+	{
+		uint32 Magic = FileMagic;
+		uint16 Version = FileVersion;
+		uint16 Flags = 0;
+		uint32 NumLevels = 0;
+		uint32 IndexOffset = 0;
+	};
+	static_assert(sizeof(FHeader) == 16, "FHeader is read straight from the pack");
+
+	struct FIndexEntry
+	{
+		// Hash of the level's name, see LevelPack::HashName
+		uint32 NameHash = 0;
+		uint32 Offset = 0;
+		uint32 Size = 0;
+		uint32 Padding = 0;
+	};
+	static_assert(sizeof(FIndexEntry) == 16, "FIndexEntry is read straight from the pack");
+
+	struct FLevelRecord
+	{
+		uint16 Width = 0;
+		uint16 Height = 0;
+
+		// The number of gem types the type ids index into
+		uint8 NumTypes = 0;
+		uint8 NumGoals = 0;
+
+		// Zero for no limit
+		uint16 MoveLimit = 0;
+	};
+	static_assert(sizeof(FLevelRecord) == 8, "FLevelRecord is read straight from the pack");
+
+	MATCHTHREE_API uint32 HashName(const FString& Name);
+}
+
+/**
+ * A level inside a level pack. Points straight into the pack's memory so opening a level copies nothing, and stays valid for
+ * as long as the pack is open
+ */
+class MATCHTHREE_API FLevelView
+{
+public:
+	FLevelView() = default;
+
+	bool IsValid() const { return Record != nullptr; }
+
+	int32 GetWidth() const { return Record->Width; }
+	int32 GetHeight() const { return Record->Height; }
+	int32 GetNumTypes() const { return Record->NumTypes; }
+	int32 GetMoveLimit() const { return Record->MoveLimit; }
+
+	TConstArrayView<FLevelGoal> GetGoals() const { return Goals; }
+
+	// Returns false for cells masked out of the board
+	bool IsPlayable(int32 X, int32 Y) const;
+
+	// Returns true if any cell is masked out
+	bool HasMask() const;
+
+	// Get the fixed type id of a cell, or LevelPack::RandomCell
+	uint8 GetCell(int32 X, int32 Y) const { return Cells[X * Record->Height + Y]; }
+
+	// Get the type ids that spawn in the column, oldest first
+	TConstArrayView<uint8> GetSpawnSequence(int32 Column) const;
+
+	// Point the view at a level record. Returns false if the record does not fit in its Size bytes or holds bad type ids
+	bool Init(const uint8* Data, uint32 Size);
+
+private:
+	const LevelPack::FLevelRecord* Record = nullptr;
+	TConstArrayView<FLevelGoal> Goals;
+	const uint32* SpawnOffsets = nullptr;
+	const uint8* Mask = nullptr;
+	const uint8* Cells = nullptr;
+	const uint8* SpawnTypes = nullptr;
+};
+
+/**
+ * A read only pack of puzzle levels. The file is memory mapped when the platform allows it, and read into memory otherwise,
+ * so opening the pack costs one index check however many levels it holds
+ */
+class MATCHTHREE_API FLevelPack
+{
+public:
+	FLevelPack();
+	~FLevelPack();
+
+	FLevelPack(const FLevelPack&) = delete;
+	FLevelPack& operator=(const FLevelPack&) = delete;
+
+	// Open the pack at the given path. Returns false if it is missing, of another version or its index is out of bounds
+	bool Open(const FString& FileName);
+
+	void Close();
+
+	bool IsOpen() const { return Data != nullptr; }
+
+	int32 GetNumLevels() const { return Index.Num(); }
+
+	// Find a level by name. Returns INDEX_NONE if there is no such level
+	int32 FindLevel(const FString& Name) const;
+
+	// Get a view of the level. The view is invalid if the level record is corrupt
+	FLevelView GetLevel(int32 LevelIndex) const;
+
+private:
+	// Check the header and the index against the size of the pack
+	bool ReadIndex();
+
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+
+	// The pack's bytes when it could not be mapped
+	TArray<uint8> LoadedBytes;
+
+	const uint8* Data = nullptr;
+	int64 Size = 0;
+
+	TConstArrayView<LevelPack::FIndexEntry> Index;
+};
+
+/* A level as authored, before it is packed */
+struct FLevelDescription
+{
+	FString Name;
+	int32 Width = 0;
+	int32 Height = 0;
+	int32 NumTypes = 0;
+	int32 MoveLimit = 0;
+	TArray<FLevelGoal> Goals;
+
+	// One entry per cell, column by column. False cells are masked out of the board
+	TArray<bool> Mask;
+
+	// One type id per cell, column by column, or LevelPack::RandomCell
+	TArray<uint8> Cells;
+
+	// The type ids that spawn in each column, oldest first
+	TArray<TArray<uint8>> SpawnSequences;
+};
+
+/**
+ * Writes levels into the level pack format. Used at cook time by the MatchThreeLevelPack commandlet
+ */
+class MATCHTHREE_API FLevelPackBuilder
+{
+public:
+	// Add a level to the pack. Returns false and sets the error if the level is inconsistent
+	bool AddLevel(const FLevelDescription& Level, FString& OutError);
+
+	int32 GetNumLevels() const { return Index.Num(); }
+
+	// Write the header, the levels and the index
+	void Write(TArray<uint8>& OutBytes) const;
+
+private:
+	TArray<uint8> LevelBytes;
+	TArray<LevelPack::FIndexEntry> Index;
+};
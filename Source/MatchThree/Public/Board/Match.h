@@ -41,20 +41,22 @@ struct FMatch
 {
 	GENERATED_BODY()
 
+	// The most gems a match holds without allocating. Lines of five crossing at a gem need nine
+	static constexpr int32 NumInlineLocations = 16;
+
 	// Add a board location to the match
 	void AddLocation(const FBoardLocation& BoardLocation);
-	void AddLocations(const TArray<FBoardLocation>& BoardLocations);
+	void AddLocations(TConstArrayView<FBoardLocation> BoardLocations);
+
+	// Remove every location, keeping the storage
+	void Reset() { GemLocations.Reset(); }
 
 	// Check if the match contains no gems
 	bool IsEmpty() const { return GemLocations.IsEmpty(); }
 
 	// Get the locations of this match
-	const TArray<FBoardLocation>& GetLocations() const { return GemLocations; }
-
-	// Get all of the board locations with this column number
-	TArray<FBoardLocation> GetLocationsInColumn(int32 Column) const;
+	TConstArrayView<FBoardLocation> GetLocations() const { return GemLocations; }
 
 private:
-	TArray<FBoardLocation> GemLocations;
-	
+	TArray<FBoardLocation, TInlineAllocator<NumInlineLocations>> GemLocations;
 };
@@ -0,0 +1,39 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "MatchThreeLevelPackCommandlet.generated.h"
+
+struct FLevelDescription;
+
+/**
+ * Build the level pack from authored JSON levels. Run before cooking so the pack is staged with the game
+ *
+ * Usage: UnrealEditor-Cmd MatchThree.uproject -run=MatchThreeLevelPack [-Source=Levels/Source] [-Output=Content/Levels/Levels.m3lp]
+ *
+ * Each level is a JSON file named after the level:
+ *
+ *   { "types": 7, "moveLimit": 20, "goals": [ { "score": 1000 }, { "clear": 2, "target": 30 } ],
+ *     "rows": [ "01..", "#10.", ... ], "spawn": [ [0, 1, 2], [], ... ] }
+ *
+ * Rows are listed from the top of the board down. A digit is a fixed gem type id, '.' a random cell and '#' a masked cell.
+ * Returns a non-zero exit code if any level is malformed
+ */
+UCLASS()
+class MATCHTHREE_API UMatchThreeLevelPackCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UMatchThreeLevelPackCommandlet();
+
+	//~ Begin UCommandlet interface
+	virtual int32 Main(const FString& Params) override;
+	//~ End UCommandlet interface
+
+private:
+	// Parse an authored level. Returns false and sets the error if the JSON is malformed
+	bool ParseLevel(const FString& Json, FLevelDescription& OutLevel, FString& OutError) const;
+};
@@ -0,0 +1,63 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+
+/**
+ * A fixed lock-free ring between exactly one producer thread and one consumer thread. Pushing and popping copy the element
+ * into or out of a preallocated slot, so neither side ever allocates or waits on the other
+ */
+template <typename ElementType, uint32 Capacity>
+class TSpscRing
+{
+public:
+	// Producer only. Returns false if the ring is full
+	bool Push(const ElementType& Element)
+	{
+		const uint32 Write = WriteIndex.load(std::memory_order_relaxed);
+		const uint32 Read = ReadIndex.load(std::memory_order_acquire);
+		if (Write - Read >= Capacity)
+		{
+			return false;
+		}
+
+		Slots[Write & Mask] = Element;
+		WriteIndex.store(Write + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only. Returns false if the ring is empty
+	bool Pop(ElementType& OutElement)
+	{
+		const uint32 Read = ReadIndex.load(std::memory_order_relaxed);
+		const uint32 Write = WriteIndex.load(std::memory_order_acquire);
+		if (Read == Write)
+		{
+			return false;
+		}
+
+		OutElement = Slots[Read & Mask];
+		ReadIndex.store(Read + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Only exact on the consumer side. The producer may have pushed more since
+	bool IsEmpty() const
+	{
+		return ReadIndex.load(std::memory_order_relaxed) == WriteIndex.load(std::memory_order_acquire);
+	}
+
+private:
+	static constexpr uint32 Mask = Capacity - 1;
+	static_assert(Capacity > 0 && (Capacity & Mask) == 0, "The ring capacity must be a power of two");
+
+	ElementType Slots[Capacity];
+
+	// Written by the producer only. Kept on its own cache line so the two sides do not share one
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint32> WriteIndex{ 0 };
+
+	// Written by the consumer only
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint32> ReadIndex{ 0 };
+};
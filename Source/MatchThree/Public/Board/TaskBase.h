@@ -3,6 +3,7 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "TimerManager.h"
 #include "UObject/NoExportTypes.h"
 #include "TaskBase.generated.h"
 
@@ -27,6 +28,26 @@ public:
 	UFUNCTION()
 	void Complete();
 
+	// Get the number of task timers running across every task
+	static int32 GetNumActiveTimers() { return NumActiveTimers; }
+
+	//~ Begin UObject interface
+	virtual void PostInitProperties() override;
+	virtual void BeginDestroy() override;
+	//~ End UObject interface
+
 protected:
 	bool bIsComplete = false;
+
+	// Start a looping timer that fires immediately, tracking it in the active timer count
+	void SetTaskTimer(FTimerHandle& TimerHandle, FTimerDelegate const& Delegate, float Rate);
+
+	// Clear a timer started with SetTaskTimer
+	void ClearTaskTimer(FTimerHandle& TimerHandle);
+
+private:
+	// Timers started by this task that have not been cleared
+	TArray<FTimerHandle> TaskTimers;
+
+	static int32 NumActiveTimers;
 };
@@ -24,9 +24,8 @@ public:
 	//~ End UTaskBase interface
 
 public:
-	void Init(AGameBoard* InGameBoard, int32 InColumn, int32 InNumberToAdd, float InTimerRate);
-
-	FOnTaskCompleteSignature OnTaskComplete;
+	// Gems below FirstRow are known not to move
+	void Init(AGameBoard* InGameBoard, int32 InColumn, int32 InFirstRow, int32 InNumberToAdd, float InTimerRate);
 
 private:
 	UPROPERTY()
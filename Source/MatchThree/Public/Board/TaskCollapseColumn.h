@@ -24,7 +24,8 @@ public:
 	//~ End UTaskBase interface
 
 public:
-	void Init(AGameBoard* InGameBoard, int32 InColumn, float InTimerRate);
+	// Gems below FirstRow, the lowest cell that was emptied, do not move
+	void Init(AGameBoard* InGameBoard, int32 InColumn, int32 InFirstRow);
 
 private:
 	UPROPERTY()
@@ -32,11 +33,5 @@ private:
 
 	int32 Column;
 
-	int32 CurrentRow;
-
-	FTimerHandle TimerHandle;
-	float TimerRate;
-
-	UFUNCTION()
-	void TimerCallback();
+	int32 FirstRow;
 };
@@ -6,6 +6,7 @@
 #include "UObject/NoExportTypes.h"
 #include "TaskPool.generated.h"
 
+class FGrowthTracker;
 class UTaskBase;
 
 /**
@@ -19,6 +20,12 @@ class MATCHTHREE_API UTaskPool : public UObject
 public:
 	void AddTask(UTaskBase* InTask);
 
+	// Get the number of tasks in the pool that have not completed
+	int32 GetNumActiveTasks() const;
+
+	// Record the size of the pool for soak testing
+	void SampleGrowth(FGrowthTracker& Tracker) const;
+
 private:
 	UPROPERTY()
 	TArray<UTaskBase*> Tasks;
@@ -22,12 +22,15 @@ protected:
 	//~ End UMovementComponent interface
 
 public:
-	// Move towards the new location with constant acceleration
-	void MoveTo(const FVector& NewLocation);
+	// Move towards the new location with constant acceleration, after waiting for the delay. The gem counts as moving while it waits
+	void MoveTo(const FVector& NewLocation, float Delay = 0.f);
 
 	// Returns true if the gem is moving
 	bool IsMoving() const { return bIsMoving; }
 
+	// Stop where the gem is without completing the move
+	void Stop();
+
 	// Delegate to broadcast on MoveTo complete
 	FOnMoveToCompleteSignature OnMoveToCompleteDelegate;
 
@@ -40,6 +43,9 @@ protected:
 
 	bool bIsMoving = false;
 
+	// Seconds left before the current move starts
+	float StartDelay = 0.f;
+
 	FVector TargetLocation;
 
 	void FinishMoveTo();
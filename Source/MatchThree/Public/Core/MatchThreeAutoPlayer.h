@@ -0,0 +1,50 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "Board/Match.h"
+#include "MatchThreeAutoPlayer.generated.h"
+
+class AGameBoard;
+class AMatchThreeGameMode;
+
+/**
+ * Plays the game without input by requesting swaps through the game mode at a fixed rate. The swaps are picked from a seeded
+ * random stream so a run can be repeated
+ */
+UCLASS()
+class MATCHTHREE_API UMatchThreeAutoPlayer : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	void Init(AMatchThreeGameMode* InGameMode, int32 Seed);
+
+	void Tick(float DeltaSeconds);
+
+	// Time between swap requests
+	float SwapInterval = .25f;
+
+	// Fraction of swaps that are picked without checking for a match, so undone swaps are exercised too
+	float InvalidSwapFraction = .1f;
+
+	int32 GetNumSwaps() const { return NumSwaps; }
+
+private:
+	// Find a pair of settled neighbours to swap, starting the search at a random cell
+	bool FindSwap(bool bMustMatch, FBoardLocation& OutLocationA, FBoardLocation& OutLocationB);
+
+	UPROPERTY()
+	TObjectPtr<AMatchThreeGameMode> GameMode;
+
+	UPROPERTY()
+	TObjectPtr<AGameBoard> GameBoard;
+
+	FRandomStream Random;
+
+	float TimeUntilSwap = 0.f;
+
+	int32 NumSwaps = 0;
+};
@@ -4,12 +4,23 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/GameModeBase.h"
+#include "Async/Future.h"
 #include "GameBoard.h"
+#include "Analytics/MoveAnalytics.h"
+#include "Board/BoardWorker.h"
+#include "Board/ColumnLocks.h"
+#include "Board/LevelPack.h"
+#include "Profiling/ActionLatencyTracker.h"
 #include "MatchThreeGameMode.generated.h"
 
 class AGameBoard;
 class AGemBase;
 class AScoreActor;
+class FGrowthTracker;
+struct FBoardSnapshot;
+class UMatchThreePerfRun;
+class UMatchThreeSoakRun;
+class UTaskBase;
 class UTaskPool;
 
 /* The locations involved in a swap action */
@@ -20,8 +31,75 @@ struct FSwapPair
 
 	FBoardLocation LocationA;
 	FBoardLocation LocationB;
+
+	// The gems that were at the locations when the swap was requested
+	TWeakObjectPtr<AGemBase> GemA;
+	TWeakObjectPtr<AGemBase> GemB;
+
+	// The task currently moving the gems
+	TWeakObjectPtr<UTaskBase> Task;
+
+	// True while the gems are being swapped back after a swap without a match
+	bool bUndoing = false;
+
+	// True if the swap was predicted to form no match. It is nudged instead of swapped if the board has not changed since
+	bool bPredictedNoMatch = false;
+	uint32 PredictedRevision = 0;
+
+	// True while the gems are nudged to show that the swap is rejected
+	bool bRejecting = false;
+
+	// The latency span of the player action that requested the swap
+	uint32 SpanId = 0;
+};
+
+/* The outcome of the swaps available to a selected gem, evaluated before the second gem is picked */
+struct FSwapPrediction
+{
+	FBoardLocation Location;
+
+	// The board revision the prediction was made against
+	uint32 BoardRevision = 0;
+
+	// Whether the swap with each neighbour would form a match. Indexed left, right, down, up
+	bool bWouldMatch[4] = { false, false, false, false };
+
+	bool bIsSet = false;
+};
+
+/* A batch of gems to clear that waits for the columns it touches to be released */
+struct FPendingClear
+{
+	FBoardMask ClearMask;
+
+	// The latency span of the action that caused the clear
+	uint32 SpanId = 0;
 };
 
+/* A column held by a running cascade task */
+struct FColumnTask
+{
+	TWeakObjectPtr<UTaskBase> Task;
+	int32 Column;
+
+	// The latency span of the action that caused the cascade
+	uint32 SpanId = 0;
+};
+
+/* Reasons a queued swap can be dropped before it starts */
+UENUM(BlueprintType)
+enum class ESwapDropReason : uint8
+{
+	// The input queue was already full
+	QueueFull,
+	// One of the gems was removed from the board
+	GemRemoved,
+	// One of the gems was moved off its location by a cascade
+	GemMoved,
+};
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnSwapDroppedSignature, ESwapDropReason, Reason);
+
 /**
  * 
  */
@@ -34,13 +112,90 @@ class MATCHTHREE_API AMatchThreeGameMode : public AGameModeBase
 protected:
 	virtual void BeginPlay() override;
 	virtual void StartPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+public:
+	virtual void Tick(float DeltaSeconds) override;
 	//~ End AGameModeBase interface
 
 public:
-	void SwapGems(AGemBase* GemA, AGemBase* GemB);
+	AMatchThreeGameMode();
+
+	// Queue a swap of the given gems. The swap runs as soon as both gems are settled and their columns are unlocked
+	void SwapGems(AGemBase* GemA, AGemBase* GemB, uint32 SpanId = 0);
 
 	bool CanSwapGems(AGemBase* GemA, AGemBase* GemB);
 
+	// Evaluate the swaps available to the gem so the outcome is known before the second gem is picked
+	void PredictSwaps(AGemBase* Gem);
+
+	// Get the tracker that times player actions from input to settle
+	FActionLatencyTracker& GetLatencyTracker() { return LatencyTracker; }
+
+	int32 GetScore() const { return Score; }
+
+	AGameBoard* GetGameBoard() const { return GameBoard; }
+
+	// Returns true if no swaps are queued or running and no column is collapsing or filling
+	bool IsBoardSettled() const;
+
+	// Rebuild a settled board at a new size and fill it, from the given seed unless it is zero. Returns false if the board is
+	// not settled
+	bool RestartBoard(int32 Width, int32 Height, int32 Seed = 0);
+
+	int32 GetNumActiveTasks() const;
+
+	// Record the size of the game mode's containers, and those of the board and task pool, for soak testing
+	void SampleGrowth(FGrowthTracker& Tracker) const;
+
+	// Log the input latency percentiles for this session
+	UFUNCTION(Exec)
+	void LatencyReport();
+
+	// Record the board, score and unresolved swaps
+	void CaptureSnapshot(FBoardSnapshot& OutSnapshot) const;
+
+	// Rebuild the game from a snapshot in one pass. Returns false if the board is not settled or the snapshot does not fit it
+	bool RestoreSnapshot(const FBoardSnapshot& Snapshot);
+
+	// Write a snapshot of the game to the save file in the background
+	UFUNCTION(Exec)
+	void SaveBoard();
+
+	// Restore the game from the save file
+	UFUNCTION(Exec)
+	void LoadBoard();
+
+	// Put the board back as it was before the last move, including its cascade and score
+	UFUNCTION(Exec)
+	void UndoMove();
+
+	// Play the last undone move forward again
+	UFUNCTION(Exec)
+	void RedoMove();
+
+	// Returns true if there is a move to undo and the board is settled
+	bool CanUndo() const;
+	bool CanRedo() const;
+
+	// Start the authored level with the given name from the level pack
+	UFUNCTION(Exec)
+	void PlayLevel(const FString& Name);
+
+	// Start an authored level from the level pack. Returns false if the board is not settled or the level does not fit it
+	bool StartLevel(int32 LevelIndex);
+
+	const FLevelPack& GetLevelPack() const { return LevelPack; }
+
+	// The goals of the level being played. Empty for an endless board
+	TConstArrayView<FLevelGoal> GetLevelGoals() const { return LevelGoals; }
+
+	// The moves allowed in the level being played. Zero for no limit
+	int32 GetLevelMoveLimit() const { return LevelMoveLimit; }
+
+	// Delegate that broadcasts when a queued swap is dropped without running
+	UPROPERTY(BlueprintAssignable)
+	FOnSwapDroppedSignature OnSwapDroppedDelegate;
+
 protected:
 	UPROPERTY()
 	TObjectPtr<AGameBoard> GameBoard;
@@ -49,10 +204,188 @@ protected:
 	UPROPERTY(EditAnywhere)
 	TSubclassOf<AScoreActor> ScoreActorClass;
 
+	// Fill every column of the empty board
+	void FillBoard();
+
+	// The level pack to open at startup, relative to the content directory. It must be staged outside the pak to be mapped
+	UPROPERTY(EditDefaultsOnly, Category = "Levels")
+	FString LevelPackPath = TEXT("Levels/Levels.m3lp");
+
+	FLevelPack LevelPack;
+
+	// Copied out of the pack so they outlive it
+	TArray<FLevelGoal> LevelGoals;
+
+	int32 LevelMoveLimit = 0;
+
+	// Continue from the save file instead of starting a new board
+	UPROPERTY(EditDefaultsOnly, Category = "Save")
+	bool bContinueSavedGame = true;
+
+	// Save the game when the application is suspended or play ends
+	UPROPERTY(EditDefaultsOnly, Category = "Save")
+	bool bSaveOnSuspend = true;
+
+	FString GetSaveFilePath() const;
+
+	// Restore the game from the save file. Returns false if there is no usable save
+	bool LoadSaveFile();
+
+	// The save being written in the background
+	TFuture<void> PendingSave;
+
+	// Save before the application is suspended
+	void HandleEnterBackground();
+
+	FDelegateHandle EnterBackgroundHandle;
+
+	// Place the whole initial board in one frame instead of filling the columns one gem at a time
+	UPROPERTY(EditDefaultsOnly, Category = "Board")
+	bool bWarmStart = true;
+
+	// Drop the warm started gems in from above. Input is live while they fall
+	UPROPERTY(EditDefaultsOnly, Category = "Board", meta = (EditCondition = "bWarmStart"))
+	bool bPlayIntroDrop = true;
+
+	// Validate swaps and resolve their cascades on a worker thread once the board first settles. The game board then only shows
+	// the worker's events. Special gems match as plain gems and moves are not recorded for undo while the worker runs
+	UPROPERTY(EditDefaultsOnly, Category = "Board")
+	bool bRunBoardOnWorker = false;
+
+	TUniquePtr<FBoardWorker> BoardWorker;
+
+	// Swaps sent to the worker whose events have not all been shown. Swaps wait while one is in flight, since the worker's board
+	// is ahead of the one on screen
+	int32 NumWorkerMoves = 0;
+
+	// True while the events of a cascade step are being shown. A new step waits for the gems of the last one to land
+	bool bBoardStepOpen = false;
+
+	// Hand a settled board with nothing left to resolve over to the worker
+	void StartBoardWorker();
+
+	// Take the board back from the worker, for when it is rebuilt or reshuffled
+	void StopBoardWorker();
+
+	// Show the events the worker has produced, a step at a time
+	void PresentBoardEvents();
+
+	// The most moves that can be undone. Older moves are forgotten
+	UPROPERTY(EditDefaultsOnly, Category = "Undo", meta = (ClampMin = 0))
+	int32 MaxUndoMoves = 64;
+
+	TArray<FBoardDelta> UndoStack;
+	TArray<FBoardDelta> RedoStack;
+
+	// The score when the board started recording the move in progress
+	int32 DeltaStartScore = 0;
+
+	// Returns true if nothing is moving and no move is being recorded, so a delta can be applied
+	bool CanApplyDelta() const;
+
+	// Store the recorded move once it and its cascade have settled
+	void TryEndDelta();
+
+	// Forget every move, for when the board is changed by something other than a move
+	void ClearUndoHistory();
+
+	// Once the board settles, resolve any match left in the columns and rows changed since the board was last searched
+	void ResolveDirtyMatches();
+
+	// Reshuffle the board if it has settled with no legal moves left
+	void CheckForDeadBoard();
+
+	// The board revision last checked for legal moves
+	uint32 DeadBoardCheckRevision = 0;
+
+	// Release the frame's cascade scratch memory, and report any heap allocation a cascade made once the board has settled
+	void ResetCascadeArena();
+
+	// The game thread's allocation count when the current cascade started
+	uint64 CascadeStartAllocations = 0;
+
+	// Drives the board through the scripted performance run when started with -MatchThreePerfRun
+	UPROPERTY()
+	TObjectPtr<UMatchThreePerfRun> PerfRun;
+
+	// Plays for hours watching for leaks when started with -MatchThreeSoak
+	UPROPERTY()
+	TObjectPtr<UMatchThreeSoakRun> SoakRun;
+
 	// Method to execute after matches are found
 	UFUNCTION()
 	void HandleMatchesFound(TArray<FMatch>& Matches);
 
+	// Remove the matched gems, with everything the special gems among them clear, and collapse and fill their columns on behalf
+	// of the given action. Matches of four or more and L or T shapes leave a special gem, at the swapped gem if it is in the match
+	void ResolveMatches(TConstArrayView<FMatch> Matches, uint32 SpanId, const FSwapPair* SwapAction = nullptr);
+
+	// Get the type id of the special gem a match makes, or FGemArchetypeRegistry::InvalidTypeId if it makes none
+	uint8 GetSpecialForMatch(const FMatch& Match, uint8 TypeId) const;
+
+	// Set off the colour bomb the swap moved, clearing the gems matching the other gem, or the whole board for two colour bombs
+	void ResolveColourBombSwap(const FSwapPair& SwapAction, bool bBothColourBombs);
+
+	// Remove the gems in the mask in one batch, collapse and fill each column with a gem removed and score them. A column
+	// collapsing through a running swap or cascade would move gems out from under it, so while any column of the mask is
+	// locked by another action, or wanted by an earlier waiting clear, the clear waits. The swap being resolved does not count
+	void ClearGems(const FBoardMask& ClearMask, uint32 SpanId, const FSwapPair* ResolvingSwap = nullptr);
+
+	// Returns true if no column of the mask is locked by an action other than the swap, or wanted by the first clears waiting
+	bool CanClear(const FBoardMask& ClearMask, const FSwapPair* ResolvingSwap, int32 NumEarlierClears) const;
+
+	// Returns true if a waiting clear wants the column
+	bool IsColumnPendingClear(int32 Column) const;
+
+	// Run the waiting clears whose columns have been released, in the order they were made
+	void ProcessPendingClears();
+
+	// Remove the gems in the mask and start their columns collapsing. The columns must be free
+	void RunClear(const FBoardMask& ClearMask, uint32 SpanId);
+
+	// Find the open action that last touched the columns of the matches, so chained cascades extend it
+	uint32 FindSpanForMatches(TConstArrayView<FMatch> Matches) const;
+
+	// Settle the action's span once none of its swaps, cascade tasks or waiting clears are running and every gem in the columns
+	// it last touched has landed. Spans still waiting on falling gems are checked again every tick
+	void TryEndSpan(uint32 SpanId);
+
+	// Try again to end the spans waiting on falling gems
+	void UpdateSettlingSpans();
+
+	// The span of the action that last swapped or collapsed each column, or zero
+	TArray<uint32> ColumnSpans;
+
+	// Spans whose tasks are done but whose gems are still falling
+	TArray<uint32> SettlingSpans;
+
+	// Forget an action that never reached the board
+	void CancelMove(uint32 SpanId);
+
+	// Close the action's latency span and emit its analytics
+	void SettleMove(uint32 SpanId);
+
+	FActionLatencyTracker LatencyTracker;
+
+	// Record per-move analytics to Saved/Analytics
+	UPROPERTY(EditDefaultsOnly, Category = "Analytics")
+	bool bRecordMoveAnalytics = true;
+
+	// The most space the analytics files of every session may take. The oldest files are deleted first, and logged
+	UPROPERTY(EditDefaultsOnly, Category = "Analytics", meta = (ClampMin = "1"))
+	int32 MaxAnalyticsMegabytes = 64;
+
+	TUniquePtr<FMoveAnalyticsWriter> AnalyticsWriter;
+
+	// Analytics for the moves still in progress, by span id
+	TMap<uint32, FMoveRecord> PendingMoves;
+
+	// Points awarded for each matched gem
+	UPROPERTY(EditDefaultsOnly, Category = "Score")
+	int32 PointsPerGem = 10;
+
+	int32 Score = 0;
+
 	// Method to execute after a swap action is completed
 	UFUNCTION()
 	void HandleCompletedSwapAction();
@@ -61,14 +394,77 @@ protected:
 	UFUNCTION()
 	void HandleUndoneSwapAction();
 
-	// Clear the current swap action
+	// Method to execute after the nudge of a rejected swap action
+	UFUNCTION()
+	void HandleRejectedSwapAction();
+
+	// Method to execute after a cascade task releases its column
 	UFUNCTION()
-	void ClearCurrentSwapAction();
+	void HandleCompletedColumnTask();
+
+	// Resolve a swap whose gems have arrived at their new locations
+	void ResolveSwapAction(const TSharedPtr<FSwapPair>& SwapAction);
+
+	// Release the columns held by the swap action and forget it
+	void FinishSwapAction(const TSharedPtr<FSwapPair>& SwapAction);
+
+	// Hold the column until the task completes
+	void LockColumnForTask(UTaskBase* Task, int32 Column, uint32 SpanId = 0);
 
 	// Task pool for overseeing ongoing tasks
 	UPROPERTY()
 	UTaskPool* TaskPool;
 
-	// The currently swapping locations
-	TSharedPtr<FSwapPair> CurrentSwapAction;
+	// The swaps currently in progress
+	TArray<TSharedPtr<FSwapPair>> ActiveSwaps;
+
+	// Columns held by swaps and cascades
+	FColumnLocks ColumnLocks;
+
+	// Cascade tasks currently holding a column
+	TArray<FColumnTask> ColumnTasks;
+
+	// Clears waiting for their columns, in the order they were made
+	TArray<FPendingClear> PendingClears;
+
+	// The maximum number of swaps that can wait in the input queue
+	UPROPERTY(EditDefaultsOnly, Category = "Input")
+	int32 MaxQueuedSwaps = 4;
+
+	// Swaps predicted to have no match are rejected with a short nudge instead of swapping there and back
+	UPROPERTY(EditDefaultsOnly, Category = "Input")
+	bool bRejectInvalidSwaps = true;
+
+	// Fraction of the distance between the gems to nudge a rejected swap
+	UPROPERTY(EditDefaultsOnly, Category = "Input")
+	float RejectNudgeFraction = .25f;
+
+	// The swaps available to the most recently selected gem
+	FSwapPrediction SwapPrediction;
+
+	// Look up the cached outcome of a swap. Returns false if no prediction covers the swap on the current board
+	bool GetPredictedSwap(const FBoardLocation& LocationA, const FBoardLocation& LocationB, bool& bOutWouldMatch) const;
+
+	// Nudge the gems to show that their swap is not allowed
+	void RejectSwap(const FBoardLocation& LocationA, const FBoardLocation& LocationB);
+
+	// Nudge the gems of a swap predicted to have no match, holding their columns like a swap until the nudge is over
+	void StartRejectAction(const TSharedPtr<FSwapPair>& SwapAction);
+
+	// Swaps waiting to start, in the order they were requested
+	TArray<TSharedPtr<FSwapPair>> SwapQueue;
+
+	// Start queued swaps in order, dropping any that went stale
+	void ProcessSwapQueue();
+
+	// Start the given swap action
+	void StartSwapAction(const TSharedPtr<FSwapPair>& SwapAction);
+
+	// Returns true if the queued swap no longer matches the board. Sets the reason if it is stale
+	bool IsStale(const FSwapPair& SwapAction, ESwapDropReason& OutReason) const;
+
+	// Returns true if the queued swap can start this frame. Columns reserved by earlier queued swaps are unavailable
+	bool CanStart(const FSwapPair& SwapAction, const TSet<int32>& ReservedColumns) const;
+
+	void DropSwap(ESwapDropReason Reason);
 };
@@ -4,8 +4,10 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Pawn.h"
+#include "Board/Match.h"
 #include "MatchThreePawn.generated.h"
 
+class AGameBoard;
 class AGemBase;
 class AMatchThreeGameMode;
 class ASelectionIndicator;
@@ -35,11 +37,22 @@ protected:
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "EnhancedInput")
 	UInputAction* ClickAction;
 
+	// Record the cell under the cursor when the click is pressed
+	UFUNCTION()
+	void Press(const FInputActionValue& Value);
+
+	// Swap towards the neighbouring cell once the cursor is dragged off the pressed cell
+	UFUNCTION()
+	void Drag(const FInputActionValue& Value);
+
 	UFUNCTION()
 	void Click(const FInputActionValue& Value);
 
 	void HandleGemClicked(AGemBase* HitGem);
 
+	// Get the board location under the mouse cursor. Returns false if the cursor is not over the board
+	bool GetBoardLocationUnderCursor(FBoardLocation& OutLocation) const;
+
 	UPROPERTY(EditDefaultsOnly, Category = "Selection")
 	TSubclassOf<ASelectionIndicator> SelectionIndicatorClass;
 
@@ -52,6 +65,15 @@ protected:
 	UPROPERTY(VisibleInstanceOnly, Category = "GameBoard")
 	AMatchThreeGameMode* GameMode;
 
+	UPROPERTY(VisibleInstanceOnly, Category = "GameBoard")
+	AGameBoard* GameBoard;
+
+	// The cell under the cursor when the click was pressed
+	FBoardLocation PressedLocation;
+
+	// True while a press that started on the board has not yet been released or consumed by a drag
+	bool bIsPressed = false;
+
 private:
 
 	AMatchThreeGameMode* GetGameMode();
@@ -7,12 +7,25 @@
 #include "Engine/TimerHandle.h"
 #include "GemBase.h"
 #include "Board/Match.h"
+#include "Board/BoardChunk.h"
 #include "Board/BoardColumn.h"
+#include "Board/BoardDelta.h"
+#include "Board/BoardDirtyRegion.h"
+#include "Board/BoardMask.h"
+#include "Board/CascadeArena.h"
+#include "Board/CellState.h"
+#include "Gem/GemArchetypeRegistry.h"
 #include "GameBoard.generated.h"
 
 class AGemBase;
+class FGrowthTracker;
+struct FBoardEvent;
+struct FBoardSnapshot;
+class FLevelView;
 class UGemDataAsset;
 class UInternalBoard;
+class UCurveFloat;
+class UMaterialInterface;
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnMatchFoundSignature, TArray<FMatch>&, Matches);
 
@@ -27,20 +40,29 @@ class MATCHTHREE_API AGameBoard : public AActor
 	//~ Begin AActor interface
 protected:
 	virtual void BeginPlay() override;
+public:
+	virtual void Tick(float DeltaSeconds) override;
 	//~ End AActor interface
 
 public:
 	AGameBoard();
 
+	// Spawn a gem of the given type id above the column
 	UFUNCTION(BlueprintCallable, Category = "Game Board")
-	AGemBase* SpawnGem(int32 Column, EGemType GemType);
+	AGemBase* SpawnGem(int32 Column, uint8 TypeId);
 
 	// Get the gem at the given board location
 	UFUNCTION(BlueprintCallable, Category = "Game Board")
 	AGemBase* GetGem(const FBoardLocation& InLocation) const;
 
-	// Set the gem at to the given location
-	void SetGem(AGemBase* Gem, const FBoardLocation& BoardLocation);
+	// Set the gem at to the given location, in the given state. Setting no gem empties the cell
+	void SetGem(AGemBase* Gem, const FBoardLocation& BoardLocation, ECellState State = ECellState::Settled);
+
+	// Get what the gem in the cell is doing
+	ECellState GetCellState(const FBoardLocation& InLocation) const { return CellStates[GetCellIndex(InLocation)]; }
+
+	// Move the cell to a new state. Returns false and leaves the cell alone if the transition is not legal
+	bool SetCellState(const FBoardLocation& InLocation, ECellState State);
 
 	// Returns true if the gem is on the board
 	bool ContainsGem(AGemBase* InGem) const;
@@ -49,15 +71,34 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Game Board")
 	FVector GetWorldLocation(const FBoardLocation& InLocation) const;
 
+	// Get the board location where a world space ray crosses the board plane. Returns false if the ray misses the board
+	bool GetBoardLocationFromRay(const FVector& RayOrigin, const FVector& RayDirection, FBoardLocation& OutLocation) const;
+
+	// Returns true if the location lies on the board
+	bool IsValidLocation(const FBoardLocation& InLocation) const;
+
 	// Get the number of gems int the column
 	int32 NumberOfGems(int32 Column) const;
 
 	int32 GetBoardWidth() const;
 	int32 GetBoardHeight() const;
 
+	// Get the number of gems placed on the board
+	int32 GetNumGems() const { return GemLocations.Num(); }
+
+	// Destroy every gem and rebuild the board empty at the given size. A non-zero seed replaces RandomSeed, so the same seed
+	// always builds the same board
+	void ResetBoard(int32 Width, int32 Height, int32 Seed = 0);
+
 	// Return true if the given gems can be swapped
 	bool CanSwapGems(AGemBase* GemA, AGemBase* GemB) const;
 
+	// Return true if swapping the gems at the given locations would form a match. No gems are moved
+	bool WouldSwapMatch(const FBoardLocation& LocationA, const FBoardLocation& LocationB) const;
+
+	// Get a counter that changes whenever a gem is placed, removed or matched
+	uint32 GetRevision() const { return Revision; }
+
 	void MoveIntoPosition(const FBoardLocation& BoardLocation);
 
 	void MoveGemToBoardLocation(AGemBase* Gem, const FBoardLocation& NewBoardLocation);
@@ -66,18 +107,29 @@ public:
 	UPROPERTY(BlueprintAssignable)
 	FOnMatchFoundSignature OnMatchFoundDelegate;
 
-	// Return true if the gems is near its board positions and not moving
-	bool IsInPosition(AGemBase* InGem) const;
-	bool IsInPosition(const FBoardLocation& InLocation) const;
-
 	bool IsEmpty(const FBoardLocation& InLocation) const;
 
 	// Return an array of gems that form a match with the gem at the given location
 	void GetMatch(AGemBase* InGem, FMatch& OutMatch) const;
 
-	// Return true if a match is found at a location
+	// Return true if a match is found at a location. Lines crossing at a matched gem are one L, T or cross shaped match
 	bool MatchFound(const FBoardLocation& Location, FMatch& OutMatch) const;
 
+	// Change the type of the gem at the location in place, to make it a special gem
+	void SetGemType(const FBoardLocation& Location, uint8 TypeId);
+
+	// Returns true if the gem at the location can be cleared by a special gem. Only settled gems are cleared
+	bool IsClearable(const FBoardLocation& Location) const;
+
+	// Add the cells cleared by setting off a special gem of the given kind at the location. A colour bomb clears the gems of
+	// TargetGroup, or of the most common group on the board if TargetGroup is FGemArchetypeRegistry::InvalidTypeId
+	void GetSpecialClearMask(const FBoardLocation& Location, EGemSpecial Special, uint8 TargetGroup, FBoardMask& OutMask) const;
+
+	// Grow the mask by the areas of every special gem it clears, and of the special gems those clear in turn, until nothing
+	// new is set off. Only cells that can be cleared are added. The areas span rows, columns or the whole board, so the caller
+	// must not collapse columns other actions still hold
+	void ExpandSpecialClears(FBoardMask& InOutMask) const;
+
 	// Logic to execute when a gem has finished a MoveTo
 	UFUNCTION()
 	void HandleGemMoveToComplete(AGemBase* InGem);
@@ -88,10 +140,14 @@ public:
 	// Get the empty location at the top of the column
 	FBoardLocation GetTopEmptyLocation(int32 Column) const;
 
-	EGemType GetRandomGemType() const;
+	// Pick a type id by spawn weight
+	uint8 GetRandomTypeId() const;
 
 	void QueueGemToSpawn(int32 Column);
-	EGemType DequeueGemToSpawn(int32 Column);
+	uint8 DequeueGemToSpawn(int32 Column);
+
+	// Get the kinds of gem on the board by type id
+	const FGemArchetypeRegistry& GetRegistry() const { return Registry; }
 
 	// Attempt to move the gem at the given location downward
 	void MoveGemDown(const FBoardLocation& InLocation);
@@ -99,6 +155,10 @@ public:
 	// Return true if the gem at this location can move down
 	bool CanMoveDown(const FBoardLocation& InLocation) const;
 
+	// Drop every gem at or above FirstRow onto the gems below it in one stable pass. Each gem's final row is known at once and
+	// every fall starts this frame, staggered by FallStaggerCurve. Returns the number of gems that fell
+	int32 CompactColumn(int32 Column, int32 FirstRow);
+
 	// Spawn a gem into a column and move it down
 	void SpawnGemInColumn(int32 Column);
 
@@ -107,8 +167,81 @@ public:
 	// Remove the given gem from the board
 	void Remove(AGemBase* InGem);
 
+	// Destroy a gem that has been removed from the board, or return it to the pool
+	void DestroyGem(AGemBase* Gem);
+
+	// Place the whole board in one frame from the spawn queues. Dropping the gems in is cosmetic, the board is playable at once
+	void PlaceInitialGems(bool bDropIn);
+
+	// Spawn hidden gems into the pool so the first matches do not spawn actors
+	void PrewarmGemPool(int32 NumGems);
+
+	// Record the gem types, spawn queues and random stream of the board
+	void CaptureSnapshot(FBoardSnapshot& OutSnapshot) const;
+
+	// Rebuild the board from a snapshot in one pass, reusing pooled gems. Cells left empty by an unfinished cascade are
+	// collapsed and refilled at once. Returns false if the snapshot does not fit the board's gem types
+	bool RestoreSnapshot(const FBoardSnapshot& Snapshot);
+
+	// Build the board from an authored level in one pass. Random cells are filled from their column's spawn sequence, which then
+	// feeds the refills. Returns false if the level does not fit the board's gem types or masks out cells
+	bool LoadLevel(const FLevelView& Level);
+
+	// Start recording the cells changed, the queued gems consumed and the random stream for an undo delta
+	void BeginDelta();
+
+	// Stop recording and fill the delta with the changes made since BeginDelta. Cells that ended as they started are left out
+	void EndDelta(FBoardDelta& OutDelta);
+
+	// Stop recording and forget the changes
+	void CancelDelta();
+
+	bool IsRecordingDelta() const { return bRecordingDelta; }
+
+	// Put the changed cells back to their state before the move, or forward to their state after it. Gems already holding
+	// the right type are moved rather than respawned and untouched cells are not visited. The board must be settled
+	void ApplyDelta(const FBoardDelta& Delta, bool bUndo);
+
+	// Find every match in the dirty columns and rows of the board, mark its gems as matched and clear the dirty region. The
+	// matches live in the cascade arena
+	void FindMatches(TCascadeArray<FMatch>& OutMatches);
+
+	// Get the columns and rows changed since matches were last looked for
+	const FBoardDirtyRegion& GetDirtyRegion() const { return DirtyRegion; }
+
 	// Mark the given gems as matched so that they won't be matched with
-	void MarkAsMatched(const TArray<FBoardLocation>& Gems);
+	void MarkAsMatched(TConstArrayView<FBoardLocation> Gems);
+
+	// Wake the chunk containing the location so that its gems are simulated
+	void WakeChunk(const FBoardLocation& InLocation);
+
+	// Get the number of awake and sleeping chunks and their cost
+	FBoardChunkStats GetChunkStats() const;
+
+	// Count the swaps that would form a match, stopping early at MaxMoves
+	int32 CountLegalMoves(int32 MaxMoves = MAX_int32) const;
+
+	// Returns true if every gem is settled on its cell
+	bool IsSettled() const;
+
+	// Returns true if every gem in the column is settled on its cell
+	bool IsColumnSettled(int32 Column) const;
+
+	// Move the gems on a settled board into a new arrangement with no matches and at least MinLegalMoves moves. The gems
+	// keep their identity and animate to their new cells. Returns false if the board is not settled or no arrangement was found
+	bool Reshuffle();
+
+	// Record the size of the board's containers for soak testing
+	void SampleGrowth(FGrowthTracker& Tracker) const;
+
+	// While presenting, the board only shows what the board worker decides. Landing gems no longer look for matches
+	void SetPresentationOnly(bool bInPresentationOnly) { bPresentationOnly = bInPresentationOnly; }
+
+	bool IsPresentationOnly() const { return bPresentationOnly; }
+
+	// Show a gem being destroyed, falling or spawning as the board worker decided. Spawns and settled moves also use up the
+	// spawn queues and move the random stream on as the worker did, so a save or a return to the game thread carries on from there
+	void ApplyBoardEvent(const FBoardEvent& Event);
 
 protected:
 	UPROPERTY(EditDefaultsOnly, Category = "Board Properties")
@@ -133,11 +266,144 @@ protected:
 	UPROPERTY(EditAnywhere, Category = "Gem Properties")
 	TMap<EGemType, UGemDataAsset*> GemData;
 
+	// The kinds of gem on the board, in type id order. Takes over from GemData when set, and may hold more kinds than EGemType
+	UPROPERTY(EditAnywhere, Category = "Gem Properties")
+	TArray<TObjectPtr<UGemDataAsset>> GemArchetypes;
+
 	// Scale of the gems
 	UPROPERTY(EditAnywhere, Category = "Gem Properties")
 	float GemScale = 0.9f;
 
-	void DestroyGem(AGemBase* Gem);
+	// Make striped gems from lines of four, colour bombs from lines of five and bombs from L and T shapes
+	UPROPERTY(EditAnywhere, Category = "Gem Properties")
+	bool bCreateSpecialGems = true;
+
+	// Materials for the special versions of the gems. Specials without a material look like their gem
+	UPROPERTY(EditAnywhere, Category = "Gem Properties", meta = (EditCondition = "bCreateSpecialGems"))
+	TMap<EGemSpecial, TObjectPtr<UMaterialInterface>> SpecialGemMaterials;
+
+	// The look of the colour bomb. Lines of five make striped gems instead when this is not set
+	UPROPERTY(EditAnywhere, Category = "Gem Properties", meta = (EditCondition = "bCreateSpecialGems"))
+	TObjectPtr<UGemDataAsset> ColourBombData;
+
+	// Reuse the actors of removed gems instead of destroying and spawning them
+	UPROPERTY(EditDefaultsOnly, Category = "Gem Properties")
+	bool bPoolGems = true;
+
+	// Hidden gems spawned into the pool when the board is placed
+	UPROPERTY(EditDefaultsOnly, Category = "Gem Properties", meta = (EditCondition = "bPoolGems"))
+	int32 NumPrewarmedGems = 32;
+
+	// Gems removed from the board and waiting to be reused
+	UPROPERTY()
+	TArray<TObjectPtr<AGemBase>> GemPool;
+
+	// Seed for the board's random stream. Zero picks a new seed every time the board is built
+	UPROPERTY(EditAnywhere, Category = "Board Properties")
+	int32 RandomSeed = 0;
+
+	// The fewest legal moves a new or reshuffled board may have
+	UPROPERTY(EditDefaultsOnly, Category = "Board Properties", meta = (ClampMin = 1))
+	int32 MinLegalMoves = 3;
+
+	// Delay in seconds before each falling gem of a collapsing column starts to fall, by its order from the bottom of the fall.
+	// Without a curve every gem starts falling at once
+	UPROPERTY(EditDefaultsOnly, Category = "Board Properties")
+	TObjectPtr<UCurveFloat> FallStaggerCurve;
+
+	// Width and height of a chunk in cells
+	UPROPERTY(EditDefaultsOnly, Category = "Board Properties", meta = (ClampMin = 1))
+	int32 ChunkSize = 16;
+
+	// Time a chunk must be quiet before its gems stop ticking
+	UPROPERTY(EditDefaultsOnly, Category = "Board Properties")
+	float ChunkSleepDelay = 1.f;
+
+	// Create empty columns and chunks for the board dimensions and fill the spawn queues
+	void InitializeBoard();
+
+	// Build the archetype registry from GemArchetypes, or from GemData if that is empty
+	void BuildRegistry();
+
+	// Create empty columns and chunks for the board dimensions
+	void InitializeLayout();
+
+	// Return every gem on the board to the pool
+	void ReleaseGems();
+
+	// Spawn a new gem actor of the given type id, never taking one from the pool
+	AGemBase* SpawnGemActor(const FTransform& SpawnTransform, uint8 TypeId);
+
+	// Spawn a gem onto the given cell, either in place or dropping in from above
+	AGemBase* PlaceGem(uint8 TypeId, const FBoardLocation& Location, bool bDropIn);
+
+	// Get the delay before a gem starts to fall, by its order from the bottom of the fall
+	float GetFallDelay(int32 NumFallen) const;
 
 	TArray<struct FBoardColumn> Columns;
+
+	// The state and type id of every cell, column by column. Match detection reads only these and never the gems
+	TArray<ECellState> CellStates;
+	TArray<uint8> CellTypeIds;
+
+	int32 GetCellIndex(const FBoardLocation& InLocation) const { return InLocation.X * BoardHeight + InLocation.Y; }
+
+	// Location of every gem on the board so lookups do not scan the columns
+	TMap<const AGemBase*, FBoardLocation> GemLocations;
+
+	TArray<FBoardChunk> Chunks;
+	int32 NumChunksX = 0;
+
+	int32 GetChunkIndex(const FBoardLocation& InLocation) const;
+
+	// Start or stop the gems in the chunk from ticking
+	void SetChunkAwake(FBoardChunk& Chunk, bool bAwake);
+
+	// Incremented by every change to the board so cached evaluations can be invalidated
+	uint32 Revision = 0;
+
+	// Marked by every change to a cell
+	FBoardDirtyRegion DirtyRegion;
+
+	bool bPresentationOnly = false;
+
+	// The match found by a landing gem, reused so that broadcasting it does not allocate
+	TArray<FMatch> LandingMatches;
+
+	mutable FRandomStream Random;
+
+	FGemArchetypeRegistry Registry;
+
+	// Get the type id of every cell, column by column, for the board generator
+	void GetTypeIds(TArray<uint8>& OutTypeIds) const;
+
+	// Get the compact match group index of every cell, column by column, so the generator sees special gems as the gems they
+	// match and never a type past its type count
+	void GetMatchGroups(TArray<uint8>& OutGroups) const;
+
+	// Find the gems in line with the location that match its gem, and the lines crossing them
+	bool GrowMatch(const FBoardLocation& Location, FMatch& OutMatch) const;
+
+	// Remember the type of the cell before its first change in the delta being recorded
+	void RecordDeltaCell(const FBoardLocation& Location);
+
+	// Get the type id of a gem, or FGemArchetypeRegistry::InvalidTypeId for no gem
+	uint8 GetTypeId(const AGemBase* Gem) const;
+
+	bool bRecordingDelta = false;
+
+	// The cells changed while recording a delta with their type before the change. The bits mark the cells already recorded.
+	// They are sized with the layout and all clear between deltas
+	TArray<FBoardDelta::FCellChange> DeltaCells;
+	TBitArray<> DeltaTouchedCells;
+
+	TArray<FBoardDelta::FConsumedSpawn> DeltaConsumedSpawns;
+
+	int32 DeltaSeedBefore = 0;
+
+	// Scratch for setting off special gems, reused by every cascade. The masks are sized with the layout and the gem counts of
+	// a colour bomb with the registry
+	mutable FBoardMask SpecialTriggered;
+	mutable FBoardMask SpecialArea;
+	mutable TArray<int32> ColourBombCounts;
 };
@@ -0,0 +1,109 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Gem/GemDataAsset.h"
+
+class UGemDataAsset;
+class UMaterialInterface;
+class UStaticMesh;
+
+/* Everything the board needs to know about a kind of gem, copied out of its data asset. The board keeps the asset alive */
+struct FGemArchetype
+{
+	TObjectPtr<UGemDataAsset> DataAsset;
+	TObjectPtr<UStaticMesh> Mesh;
+	TObjectPtr<UMaterialInterface> Material;
+
+	float SpawnWeight = 1.f;
+
+	EGemMatchRule MatchRule = EGemMatchRule::SameType;
+	EGemSpecial Special = EGemSpecial::None;
+
+	// Gems match when their groups are the same. The special versions of a gem share its group
+	uint8 MatchGroup = 0;
+};
+
+/**
+ * The kinds of gem on the board, in a flat array indexed by a compact type id. Built once when the board is initialized, so
+ * spawning, random picks and match tests are array reads with no hashing or allocation. Type ids are independent of EGemType,
+ * so a board can use more kinds of gem than the enum names
+ */
+class MATCHTHREE_API FGemArchetypeRegistry
+{
+public:
+	// The type id of no gem. Shared with the empty cells of the board generator, snapshots and undo deltas
+	static constexpr uint8 InvalidTypeId = 0xFF;
+
+	// The most archetypes a registry can hold
+	static constexpr int32 MaxArchetypes = InvalidTypeId;
+
+	// Rebuild the registry from the data assets. The type id of each archetype is its index in the array
+	void Build(TConstArrayView<UGemDataAsset*> DataAssets);
+
+	// Add a striped and a bomb version of every gem that spawns at random, after the gems themselves so their type ids do not
+	// change, and a colour bomb if its data is given. The versions look like their gem unless a material is given
+	void AddSpecialVariants(const TMap<EGemSpecial, TObjectPtr<UMaterialInterface>>& Materials, UGemDataAsset* ColourBombData);
+
+	// Get the type id of the special version of a gem, or InvalidTypeId if it has none
+	uint8 GetSpecialVariant(uint8 TypeId, EGemSpecial Special) const;
+
+	// Get the type id of the colour bomb, or InvalidTypeId if there is none
+	uint8 GetColourBombTypeId() const { return ColourBombTypeId; }
+
+	int32 Num() const { return Archetypes.Num(); }
+
+	bool IsValidTypeId(uint8 TypeId) const { return TypeId < Archetypes.Num(); }
+
+	const FGemArchetype& Get(uint8 TypeId) const { return Archetypes[TypeId]; }
+
+	// Get the type id of the data asset's archetype, or InvalidTypeId
+	uint8 FindTypeId(const UGemDataAsset* DataAsset) const;
+
+	// Pick a type id by spawn weight in constant time
+	uint8 PickRandom(FRandomStream& Random) const;
+
+	// The type ids that spawn at random, in type id order
+	TConstArrayView<uint8> GetSpawnableTypeIds() const { return SpawnableTypeIds; }
+
+	// Get the number of distinct match groups. Their indices run from zero, so they can size per group tables
+	int32 GetNumMatchGroups() const { return NumMatchGroups; }
+
+	// Get the compact index of the match group of a type
+	uint8 GetMatchGroupIndex(uint8 TypeId) const { return MatchGroupIndices[TypeId]; }
+
+	// Returns true if gems of the two types match each other
+	bool CanMatch(uint8 TypeIdA, uint8 TypeIdB) const
+	{
+		const EGemMatchRule RuleA = Archetypes[TypeIdA].MatchRule;
+		const EGemMatchRule RuleB = Archetypes[TypeIdB].MatchRule;
+		if (RuleA == EGemMatchRule::Never || RuleB == EGemMatchRule::Never)
+		{
+			return false;
+		}
+		return Archetypes[TypeIdA].MatchGroup == Archetypes[TypeIdB].MatchGroup || RuleA == EGemMatchRule::AnyType || RuleB == EGemMatchRule::AnyType;
+	}
+
+private:
+	// Number the match groups in the order they first appear
+	void IndexMatchGroups();
+
+	TArray<FGemArchetype> Archetypes;
+
+	// The compact index of each type's match group. Groups are type ids, so the colour bomb's group can be past every gem's
+	TArray<uint8> MatchGroupIndices;
+	int32 NumMatchGroups = 0;
+
+	TArray<uint8> SpawnableTypeIds;
+
+	// The special versions of each gem, NumSpecials to a type id
+	static constexpr int32 NumSpecials = static_cast<int32>(EGemSpecial::ColourBomb) + 1;
+	TArray<uint8> SpecialVariants;
+
+	uint8 ColourBombTypeId = InvalidTypeId;
+
+	// Alias table over the spawnable types. A pick takes a column at random, then keeps it or takes its alias
+	TArray<float> AliasProbabilities;
+	TArray<uint8> Aliases;
+};
@@ -4,9 +4,36 @@
 
 #include "CoreMinimal.h"
 #include "Engine/DataAsset.h"
-#include "GameBoard.h"
+#include "GemBase.h"
 #include "GemDataAsset.generated.h"
 
+/* Which gems a gem can form a match with */
+UENUM(BlueprintType)
+enum class EGemMatchRule : uint8
+{
+	// Matches gems of the same type
+	SameType,
+	// Matches gems of any type that can match
+	AnyType,
+	// Never part of a match, such as a gem that is only triggered by swapping it
+	Never,
+};
+
+/* What a gem does when it is cleared from the board */
+UENUM(BlueprintType)
+enum class EGemSpecial : uint8
+{
+	None,
+	// Clears its row
+	StripedRow,
+	// Clears its column
+	StripedColumn,
+	// Clears the cells around it
+	Bomb,
+	// Clears every gem of one type
+	ColourBomb,
+};
+
 /**
  * Data for the each gem
  */
@@ -24,4 +51,14 @@ public:
 
 	UPROPERTY(EditAnywhere, Category = "Gem Data")
 	EGemType Type;
+
+	// Relative chance of the gem being picked for a random spawn. Zero never spawns it at random
+	UPROPERTY(EditAnywhere, Category = "Gem Data", meta = (ClampMin = 0))
+	float SpawnWeight = 1.f;
+
+	UPROPERTY(EditAnywhere, Category = "Gem Data")
+	EGemMatchRule MatchRule = EGemMatchRule::SameType;
+
+	UPROPERTY(EditAnywhere, Category = "Gem Data")
+	EGemSpecial Special = EGemSpecial::None;
 };
@@ -21,7 +21,7 @@ enum class EGemType : uint8
 	MAX
 };
 
-class UGemDataAsset;
+struct FGemArchetype;
 class UGemMovementComponent;
 class USpinnerComponent;
 
@@ -38,16 +38,17 @@ class MATCHTHREE_API AGemBase : public AActor
 	//~ Begin AActor interface
 protected:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	//~ End AActor interface
 
 public:	
 	AGemBase();
 
-	// Set the data of this gem actor
-	void SetData(UGemDataAsset* GemData);
+	// Show the gem as the given archetype
+	void SetData(const FGemArchetype& Archetype, uint8 InTypeId);
 
-	// Move the gem to the given world location
-	void MoveTo(const FVector& NewLocation);
+	// Move the gem to the given world location, starting after the delay
+	void MoveTo(const FVector& NewLocation, float Delay = 0.f);
 
 	// Returns true if the gem is moving
 	bool IsMoving() const { return MovementComponent->IsMoving(); }
@@ -58,11 +59,19 @@ public:
 	// Set this gem as selected
 	void SetSelected(bool bInSelected);
 
-	// Get the gem type
-	EGemType GetType() const { return Type; }
+	// Returns true if the gem is selected
+	bool IsSelected() const { return bIsSelected; }
 
-	// True if this gem is part of a match
-	bool bCannotMatch = false;
+	// Stop or restart ticking the gem and its components
+	void SetSleeping(bool bInSleeping);
+
+	// Hide a gem that has left the board so it can be reused, or show it again when it is reused
+	void SetPooled(bool bInPooled);
+
+	bool IsPooled() const { return bIsPooled; }
+
+	// Get the gem's type id in the board's archetype registry
+	uint8 GetTypeId() const { return TypeId; }
 
 protected:
 	UPROPERTY(EditDefaultsOnly, Category = "Gem Properties")
@@ -75,10 +84,14 @@ protected:
 	TObjectPtr<UGemMovementComponent> MovementComponent;
 
 	UPROPERTY(VisibleInstanceOnly, Category = "Gem Properties")
-	EGemType Type;
+	uint8 TypeId = 0;
 
 	bool bIsSelected;
 
+	bool bIsSleeping = false;
+
+	bool bIsPooled = false;
+
 	UFUNCTION()
 	void HandleMoveToComplete();
 };
@@ -0,0 +1,89 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/* The phases a player action passes through, in order */
+enum class EActionPhase : uint8
+{
+	// The player clicked or dragged
+	Input,
+	// The gems started to move or were nudged to reject the swap
+	Feedback,
+	// The swapped gems arrived at their new locations
+	SwapCompleted,
+	// The swap was matched and its gems removed, or it was undone
+	Resolved,
+	// Every column affected by the action has finished collapsing and filling
+	Settled,
+
+	MAX
+};
+
+/**
+ * A latency histogram with logarithmic buckets so that percentiles have a fixed relative error and long sessions use constant memory
+ */
+struct FLatencyHistogram
+{
+	FLatencyHistogram();
+
+	void Add(double Milliseconds);
+
+	// Get the latency below which the given fraction of the samples fall
+	double GetPercentile(double Fraction) const;
+
+	int64 Num() const { return NumSamples; }
+
+private:
+	// Buckets grow by 2% from 10us, covering a little over a minute
+	static constexpr int32 NumBuckets = 800;
+	static constexpr double MinMilliseconds = .01;
+	static constexpr double BucketGrowth = 1.02;
+
+	TArray<uint32> Buckets;
+	int64 NumSamples = 0;
+};
+
+/**
+ * Tracks each player action from input to the moment the board settles. Every action carries a span id through the swap,
+ * its resolution and the cascade it causes
+ */
+class MATCHTHREE_API FActionLatencyTracker
+{
+public:
+	// Start a span for a player input and return its id
+	uint32 BeginSpan();
+
+	// Record the time the span reached a phase. Only the first time each phase is reached counts
+	void MarkPhase(uint32 SpanId, EActionPhase Phase);
+
+	// Settle the span and record its timings. Returns the milliseconds from input to settle, or a negative value if the span is not open
+	double EndSpan(uint32 SpanId);
+
+	// Forget a span whose input never became an action
+	void CancelSpan(uint32 SpanId);
+
+	bool IsOpen(uint32 SpanId) const { return OpenSpans.Contains(SpanId); }
+
+	int32 GetNumOpenSpans() const { return OpenSpans.Num(); }
+
+	// Get a latency percentile in milliseconds from input to the given phase
+	double GetPercentile(EActionPhase Phase, double Fraction) const;
+
+	// Log the p50, p95 and p99 latencies from input to every phase
+	void LogReport() const;
+
+private:
+	struct FSpan
+	{
+		double PhaseTimes[static_cast<int32>(EActionPhase::MAX)];
+	};
+
+	TMap<uint32, FSpan> OpenSpans;
+
+	uint32 NextSpanId = 1;
+
+	// Time from input to each phase
+	FLatencyHistogram PhaseHistograms[static_cast<int32>(EActionPhase::MAX)];
+};
@@ -0,0 +1,38 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Counts the heap allocations made inside FScopedAllocationCount scopes, to prove that a code path does not allocate. Wraps
+ * GMalloc in a counting proxy, so it is only installed when asked for with -MatchThreeCountAllocations or by a soak run
+ */
+class MATCHTHREE_API FAllocationCounter
+{
+public:
+	// Wrap GMalloc in the counting proxy. Does nothing if it is already installed
+	static void Install();
+
+	static bool IsInstalled();
+
+	// Get the allocations counted on the calling thread since it started
+	static uint64 GetThreadCount();
+};
+
+/* Counts the heap allocations made on the calling thread while in scope, into the Match Pipeline Allocations stat */
+class MATCHTHREE_API FScopedAllocationCount
+{
+public:
+	FScopedAllocationCount();
+	~FScopedAllocationCount();
+
+	FScopedAllocationCount(const FScopedAllocationCount&) = delete;
+	FScopedAllocationCount& operator=(const FScopedAllocationCount&) = delete;
+
+private:
+	uint64 StartCount = 0;
+};
+
+// Count the heap allocations made in the enclosing scope. Nested scopes count once
+#define MATCHTHREE_COUNT_ALLOCATIONS() FScopedAllocationCount ANONYMOUS_VARIABLE(AllocationCount)
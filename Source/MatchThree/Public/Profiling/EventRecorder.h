@@ -0,0 +1,90 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "Containers/Ticker.h"
+
+/* Events kept in the rolling hitch trace */
+enum class EMatchThreeEvent : uint8
+{
+	SwapRequested,
+	SwapStarted,
+	SwapResolved,
+	MatchFound,
+	TaskStarted,
+	TaskCompleted,
+	GemSpawned,
+	GemDestroyed,
+	GarbageCollected,
+	Hitch,
+};
+
+/* A single recorded event. Kept to 16 bytes so the ring buffer stays small enough to leave on */
+struct FRecordedEvent
+{
+	// Platform time in seconds
+	double Time;
+
+	// Event specific payload, a packed board location, an object id or a count
+	int32 Data;
+
+	// Low bits of the frame number, enough to group the events of a frame
+	uint16 Frame;
+
+	EMatchThreeEvent Type;
+};
+static_assert(sizeof(FRecordedEvent) == 16, "Recorded events should stay compact");
+
+/**
+ * Keeps a ring buffer of recent MatchThree events. When a frame goes over the hitch budget the last few seconds of events
+ * are written to Saved/Hitches on a background thread
+ */
+class MATCHTHREE_API FMatchThreeEventRecorder
+{
+public:
+	static FMatchThreeEventRecorder& Get();
+
+	// Allocate the ring buffer and start watching frame times
+	void Start();
+
+	// Stop watching frame times and wait for pending dumps to finish
+	void Stop();
+
+	bool IsRecording() const { return bIsRecording; }
+
+	// Add an event to the ring buffer. Game thread only
+	void Record(EMatchThreeEvent Type, int32 Data = 0);
+
+	// Write the recent events to disk on a background thread
+	void Dump(double FrameMilliseconds);
+
+	// Pack a board location into an event payload
+	static int32 PackLocation(int32 X, int32 Y) { return (X << 16) | (Y & 0xFFFF); }
+
+private:
+	bool Tick(float DeltaTime);
+
+	void HandlePostGarbageCollect();
+
+	TArray<FRecordedEvent> Events;
+
+	// The slot the next event is written to
+	int32 Head = 0;
+	int32 NumEvents = 0;
+
+	bool bIsRecording = false;
+
+	// Time of the last dump so a run of slow frames writes one file
+	double LastDumpTime = 0.;
+
+	FTSTicker::FDelegateHandle TickerHandle;
+	FDelegateHandle GarbageCollectHandle;
+
+	TArray<TFuture<void>> PendingDumps;
+};
+
+// Record an event if the recorder is running
+#define MATCHTHREE_RECORD_EVENT(Type, ...) \
+	FMatchThreeEventRecorder::Get().Record(EMatchThreeEvent::Type, ##__VA_ARGS__)
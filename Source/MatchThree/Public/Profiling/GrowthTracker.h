@@ -0,0 +1,57 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/* How a series is judged for growth */
+enum class EGrowthKind : uint8
+{
+	// Counts of objects hold still while play is steady, so a leak rises on most samples and never falls
+	Count,
+	// Values such as process memory wander from sample to sample, so only a sustained trend counts
+	Noisy,
+};
+
+/**
+ * Records periodic samples of counts and sizes and flags any that keep growing. Each series is tagged with the subsystem
+ * that owns it so a flagged series points at the code holding on to it
+ */
+class MATCHTHREE_API FGrowthTracker
+{
+public:
+	// The number of samples a series is judged over
+	explicit FGrowthTracker(int32 InWindow = 6);
+
+	// Record the value of a series for the current sample. The series is only flagged once it has grown by at least MinGrowth
+	// across the window, both from end to end and along its least squares trend. The growth settings are taken from the
+	// first sample of the series
+	void Record(const TCHAR* Name, const TCHAR* Subsystem, double Value, double MinGrowth = 1., EGrowthKind Kind = EGrowthKind::Count);
+
+	// Check every series for growth across the window, logging any that are newly flagged. Call after each sample
+	void Analyse();
+
+	int32 GetNumFlagged() const;
+
+	// Write every sample of every series as CSV, one row per sample
+	bool WriteCsv(const FString& Path) const;
+
+	// Log the first and last value of every series, marking the flagged ones
+	void LogReport() const;
+
+private:
+	struct FSeries
+	{
+		FString Name;
+		FString Subsystem;
+		TArray<double> Samples;
+		double MinGrowth = 1.;
+		EGrowthKind Kind = EGrowthKind::Count;
+		bool bFlagged = false;
+	};
+
+	TArray<FSeries> Series;
+	TMap<FString, int32> SeriesIndices;
+
+	int32 Window;
+};
@@ -0,0 +1,90 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "GameBoard.h"
+#include "MatchThreeBenchmarkCommandlet.generated.h"
+
+class UGemDataAsset;
+
+/**
+ * A game board that the benchmark can size and fill without a running game
+ */
+UCLASS(NotPlaceable, Transient)
+class MATCHTHREE_API ABenchmarkGameBoard : public AGameBoard
+{
+	GENERATED_BODY()
+
+public:
+	// Size the board and fill every cell with a settled gem of a random type
+	void Fill(int32 Width, int32 Height, const TMap<EGemType, UGemDataAsset*>& InGemData);
+
+	// Remove and destroy the gems in the given rows of a column
+	int32 ClearRows(int32 Column, int32 FirstRow, int32 NumRows);
+};
+
+/**
+ * Measure the board kernels at a range of board sizes and write the results as JSON
+ *
+ * Usage: UnrealEditor-Cmd MatchThree.uproject -run=MatchThreeBenchmark [-Sizes=8,16,32] [-MinTime=0.2]
+ *            [-Output=Results.json] [-Baseline=Baseline.json] [-Tolerance=0.1]
+ *
+ * Returns 1 if any kernel is slower than the baseline by more than the tolerance, 2 if the baseline cannot be read and 3 if the
+ * results cannot be written, so a broken baseline is not mistaken for a slowdown
+ */
+UCLASS()
+class MATCHTHREE_API UMatchThreeBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	// The exit codes of the commandlet
+	static constexpr int32 ExitRegressed = 1;
+	static constexpr int32 ExitBadBaseline = 2;
+	static constexpr int32 ExitWriteFailed = 3;
+
+	UMatchThreeBenchmarkCommandlet();
+
+	//~ Begin UCommandlet interface
+	virtual int32 Main(const FString& Params) override;
+	//~ End UCommandlet interface
+
+private:
+	struct FKernelResult
+	{
+		FString Kernel;
+		int32 Width = 0;
+		int32 Height = 0;
+		int64 NumRuns = 0;
+		double BestNanosecondsPerOp = 0.;
+		double MeanNanosecondsPerOp = 0.;
+
+		// Heap allocations per run once warmed up, or -1 when allocations are not counted
+		double AllocationsPerRun = -1.;
+	};
+
+	TArray<FKernelResult> Results;
+
+	// Minimum time to spend repeating each kernel
+	double MinTime = .2;
+
+	// Written by the kernels so their work is not optimized away
+	int64 Sink = 0;
+
+	UPROPERTY()
+	TArray<TObjectPtr<UGemDataAsset>> GemDataAssets;
+
+	// Time the body until MinTime has passed. OpsPerRun is the number of kernel calls made by one run of the body
+	void RunKernel(const TCHAR* Kernel, int32 Width, int32 Height, int64 OpsPerRun, TFunctionRef<void()> Body);
+
+	// Run every kernel on a square board of the given size
+	void BenchmarkBoardSize(int32 Size, const TMap<EGemType, UGemDataAsset*>& GemData);
+
+	bool WriteResults(const FString& Path) const;
+
+	// Returns the number of kernels slower than the baseline by more than the tolerance, or INDEX_NONE if the baseline is
+	// missing or malformed
+	int32 CompareWithBaseline(const FString& Path, double Tolerance) const;
+};
@@ -0,0 +1,17 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/LowLevelMemTracker.h"
+
+// Low level memory tags, reported under MatchThree in stat LLMFULL and memreport
+LLM_DECLARE_TAG_API(MatchThree, MATCHTHREE_API);
+LLM_DECLARE_TAG_API(MatchThree_Gems, MATCHTHREE_API);
+LLM_DECLARE_TAG_API(MatchThree_Tasks, MATCHTHREE_API);
+LLM_DECLARE_TAG_API(MatchThree_Board, MATCHTHREE_API);
+LLM_DECLARE_TAG_API(MatchThree_Matches, MATCHTHREE_API);
+LLM_DECLARE_TAG_API(MatchThree_FX, MATCHTHREE_API);
+
+// Charge allocations in the enclosing scope to a MatchThree memory tag
+#define MATCHTHREE_LLM_SCOPE(Tag) LLM_SCOPE_BYTAG(MatchThree_##Tag)
@@ -0,0 +1,103 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "MatchThreePerfRun.generated.h"
+
+class AMatchThreeGameMode;
+class UMatchThreeAutoPlayer;
+
+/**
+ * Plays a scripted sequence of swaps at a range of board sizes, records frame metrics for each size and compares them with
+ * a stored baseline. The game exits when the run is over, with a non-zero code if any metric regressed
+ *
+ * Usage: UnrealEditor MatchThree.uproject /Game/Maps/MainMap -game -nullrhi -unattended -nosound -MatchThreePerfRun
+ *            [-PerfSizes=8x8,16x16,32x32] [-PerfWarmup=3] [-PerfDuration=20] [-PerfSeed=1]
+ *            [-PerfOutput=Results.json] [-PerfBaseline=Baseline.json] [-PerfTolerance=0.15]
+ */
+UCLASS()
+class MATCHTHREE_API UMatchThreePerfRun : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	void Init(AMatchThreeGameMode* InGameMode, const TCHAR* Params);
+
+	void Tick(float DeltaSeconds);
+
+	//~ Begin UObject interface
+	virtual void BeginDestroy() override;
+	//~ End UObject interface
+
+private:
+	enum class EStage : uint8
+	{
+		// Waiting for the board to settle so it can be resized
+		Resizing,
+		// Playing without recording while the new board fills
+		Warmup,
+		Measure,
+		Finished,
+	};
+
+	struct FSizeResult
+	{
+		int32 Width = 0;
+		int32 Height = 0;
+		int32 NumFrames = 0;
+		int32 NumSwaps = 0;
+
+		// Every metric compared against the baseline, by name
+		TArray<TPair<FString, double>> Metrics;
+	};
+
+	void StartSize();
+	void RecordFrame(float DeltaSeconds);
+	void FinishSize();
+	void Finish();
+
+	bool WriteResults(const FString& Path) const;
+
+	// Returns the number of metrics worse than the baseline by more than the tolerance, counting each size the baseline does
+	// not cover as one
+	int32 CompareWithBaseline(const FString& Path) const;
+
+	void HandlePreGarbageCollect();
+	void HandlePostGarbageCollect();
+
+	UPROPERTY()
+	TObjectPtr<AMatchThreeGameMode> GameMode;
+
+	UPROPERTY()
+	TObjectPtr<UMatchThreeAutoPlayer> AutoPlayer;
+
+	TArray<FIntPoint> Sizes;
+	int32 SizeIndex = 0;
+
+	EStage Stage = EStage::Resizing;
+	float StageTime = 0.f;
+
+	float WarmupTime = 3.f;
+	float MeasureTime = 20.f;
+	int32 Seed = 1;
+	double Tolerance = .15;
+	FString OutputPath;
+	FString BaselinePath;
+
+	// Samples for the current size
+	TArray<float> FrameTimes;
+	TArray<float> GameThreadTimes;
+	double GarbageCollectStartTime = 0.;
+	double MaxGarbageCollectMilliseconds = 0.;
+	int32 MaxActors = 0;
+	int32 MaxTasks = 0;
+	int32 MaxGems = 0;
+	bool bForcedGarbageCollect = false;
+
+	TArray<FSizeResult> Results;
+
+	FDelegateHandle PreGarbageCollectHandle;
+	FDelegateHandle PostGarbageCollectHandle;
+};
@@ -0,0 +1,57 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "Profiling/GrowthTracker.h"
+#include "MatchThreeSoakRun.generated.h"
+
+class AMatchThreeGameMode;
+class UMatchThreeAutoPlayer;
+
+/**
+ * Lets the auto player play for a long time while object counts, delegate bindings, timers, container sizes and memory are
+ * sampled at intervals. Anything that keeps growing is flagged with the subsystem that owns it. The game exits when the run
+ * is over, with a non-zero code if anything grew
+ *
+ * Usage: UnrealEditor MatchThree.uproject /Game/Maps/MainMap -game -nullrhi -unattended -nosound -MatchThreeSoak
+ *            [-SoakHours=4] [-SoakInterval=60] [-SoakWindow=6] [-SoakMemoryGrowthMB=64] [-SoakSeed=1]
+ *            [-SoakOutput=Soak.csv]
+ */
+UCLASS()
+class MATCHTHREE_API UMatchThreeSoakRun : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	void Init(AMatchThreeGameMode* InGameMode, const TCHAR* Params);
+
+	void Tick(float DeltaSeconds);
+
+private:
+	// Collect garbage and record every series
+	void Sample();
+
+	void Finish();
+
+	UPROPERTY()
+	TObjectPtr<AMatchThreeGameMode> GameMode;
+
+	UPROPERTY()
+	TObjectPtr<UMatchThreeAutoPlayer> AutoPlayer;
+
+	FGrowthTracker GrowthTracker;
+
+	double Duration = 4. * 60. * 60.;
+	double SampleInterval = 60.;
+
+	// How far physical memory must trend up across the window before it is flagged
+	double PhysicalMemoryMinGrowthMB = 64.;
+
+	FString OutputPath;
+
+	double RunTime = 0.;
+	double TimeUntilSample = 0.;
+	bool bFinished = false;
+};
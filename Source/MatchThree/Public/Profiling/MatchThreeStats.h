@@ -0,0 +1,68 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProfilingDebugging/CountersTrace.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Stats/Stats.h"
+#include "Trace/Trace.h"
+
+DECLARE_STATS_GROUP(TEXT("MatchThree"), STATGROUP_MatchThree, STATCAT_Advanced);
+
+// Scoped timings
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Swap Gems"), STAT_MatchThree_SwapGems, STATGROUP_MatchThree, MATCHTHREE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Resolve Swap"), STAT_MatchThree_ResolveSwap, STATGROUP_MatchThree, MATCHTHREE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Match Detection"), STAT_MatchThree_MatchDetection, STATGROUP_MatchThree, MATCHTHREE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Handle Matches"), STAT_MatchThree_HandleMatches, STATGROUP_MatchThree, MATCHTHREE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Collapse Column"), STAT_MatchThree_CollapseColumn, STATGROUP_MatchThree, MATCHTHREE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Add Gems To Column"), STAT_MatchThree_AddGems, STATGROUP_MatchThree, MATCHTHREE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Spawn Gem"), STAT_MatchThree_SpawnGem, STATGROUP_MatchThree, MATCHTHREE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Destroy Gem"), STAT_MatchThree_DestroyGem, STATGROUP_MatchThree, MATCHTHREE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Delegate Broadcast"), STAT_MatchThree_Broadcast, STATGROUP_MatchThree, MATCHTHREE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Task Pool"), STAT_MatchThree_TaskPool, STATGROUP_MatchThree, MATCHTHREE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Board Tick"), STAT_MatchThree_BoardTick, STATGROUP_MatchThree, MATCHTHREE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Save Snapshot"), STAT_MatchThree_SaveSnapshot, STATGROUP_MatchThree, MATCHTHREE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Restore Snapshot"), STAT_MatchThree_RestoreSnapshot, STATGROUP_MatchThree, MATCHTHREE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Special Clears"), STAT_MatchThree_SpecialClears, STATGROUP_MatchThree, MATCHTHREE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Board Worker"), STAT_MatchThree_BoardWorker, STATGROUP_MatchThree, MATCHTHREE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Present Board Events"), STAT_MatchThree_PresentBoardEvents, STATGROUP_MatchThree, MATCHTHREE_API);
+
+// Counters
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Live Gems"), STAT_MatchThree_LiveGems, STATGROUP_MatchThree, MATCHTHREE_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Pooled Gems"), STAT_MatchThree_PooledGems, STATGROUP_MatchThree, MATCHTHREE_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Live Tasks"), STAT_MatchThree_LiveTasks, STATGROUP_MatchThree, MATCHTHREE_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Active Timers"), STAT_MatchThree_ActiveTimers, STATGROUP_MatchThree, MATCHTHREE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Matches Per Frame"), STAT_MatchThree_MatchesPerFrame, STATGROUP_MatchThree, MATCHTHREE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Match Pipeline Allocations"), STAT_MatchThree_MatchAllocations, STATGROUP_MatchThree, MATCHTHREE_API);
+
+UE_TRACE_CHANNEL_EXTERN(MatchThreeChannel, MATCHTHREE_API);
+
+TRACE_DECLARE_INT_COUNTER_EXTERN(MatchThree_LiveGems);
+TRACE_DECLARE_INT_COUNTER_EXTERN(MatchThree_PooledGems);
+TRACE_DECLARE_INT_COUNTER_EXTERN(MatchThree_LiveTasks);
+TRACE_DECLARE_INT_COUNTER_EXTERN(MatchThree_ActiveTimers);
+TRACE_DECLARE_INT_COUNTER_EXTERN(MatchThree_MatchesPerFrame);
+TRACE_DECLARE_INT_COUNTER_EXTERN(MatchThree_MatchAllocations);
+
+// Time the enclosing scope in stat MatchThree and as a CPU event on the MatchThree trace channel
+#define MATCHTHREE_SCOPE_CYCLE_COUNTER(Stat) \
+	SCOPE_CYCLE_COUNTER(Stat); \
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(Stat, MatchThreeChannel)
+
+// Update a MatchThree counter in both stat MatchThree and Insights
+#define MATCHTHREE_COUNTER_INC(Name) \
+	INC_DWORD_STAT(STAT_MatchThree_##Name); \
+	TRACE_COUNTER_INCREMENT(MatchThree_##Name)
+
+#define MATCHTHREE_COUNTER_DEC(Name) \
+	DEC_DWORD_STAT(STAT_MatchThree_##Name); \
+	TRACE_COUNTER_DECREMENT(MatchThree_##Name)
+
+#define MATCHTHREE_COUNTER_ADD(Name, Amount) \
+	INC_DWORD_STAT_BY(STAT_MatchThree_##Name, Amount); \
+	TRACE_COUNTER_ADD(MatchThree_##Name, Amount)
+
+#define MATCHTHREE_COUNTER_SUB(Name, Amount) \
+	DEC_DWORD_STAT_BY(STAT_MatchThree_##Name, Amount); \
+	TRACE_COUNTER_SUBTRACT(MatchThree_##Name, Amount)
@@ -0,0 +1,53 @@
+// Copyright Peter Carsten Collins (2024)
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Board/TaskBase.h"
+#include "Board/Match.h"
+#include "TaskRejectSwap.generated.h"
+
+class AGameBoard;
+class AGemBase;
+
+/**
+ * Nudge two gems towards each other and back to show that their swap is not allowed
+ */
+UCLASS()
+class MATCHTHREE_API UTaskRejectSwap : public UTaskBase
+{
+	GENERATED_BODY()
+
+	//~ Begin UTaskBase interface
+public:
+	virtual void Execute() override;
+	//~ End UTaskBase interface
+
+public:
+	void Init(AGameBoard* InGameBoard, const FBoardLocation& InLocationA, const FBoardLocation& InLocationB, float InNudgeFraction);
+
+protected:
+	UFUNCTION()
+	void MoveToCompleteCallback(AGemBase* MovedGem);
+
+private:
+	UPROPERTY()
+	AGameBoard* GameBoard;
+
+	UPROPERTY()
+	AGemBase* GemA;
+
+	UPROPERTY()
+	AGemBase* GemB;
+
+	FBoardLocation LocationA;
+	FBoardLocation LocationB;
+
+	// Fraction of the distance between the gems to move before returning
+	float NudgeFraction;
+
+	// Number of gems that finished the current move
+	int32 NumArrived = 0;
+
+	bool bReturning = false;
+};
@@ -8,6 +8,7 @@
 #include "TaskSwapGems.generated.h"
 
 class AGameBoard;
+class AGemBase;
 
 /**
  * 
@@ -34,5 +35,9 @@ private:
 	FBoardLocation LocationA;
 	FBoardLocation LocationB;
 
+	// The gems bound to by the task, so the bindings can be removed when the swap completes
+	TWeakObjectPtr<AGemBase> GemA;
+	TWeakObjectPtr<AGemBase> GemB;
+
 	bool bCallbackCalled = false;
 };